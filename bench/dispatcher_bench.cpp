@@ -0,0 +1,302 @@
+#include "CallSite.h"
+#include "Dispatcher.h"
+#include "TensorImpl.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dispatcher;
+
+// === Dispatcher基准测试 ===
+// 测量dispatch路径本身的开销：内核不做计算，直接返回第一个参数
+// 默认以JSON输出到stdout（--benchmark_format=console可改回表格），
+// 可以用 --benchmark_out=result.json 保存后与基线比较，例如Google Benchmark自带的tools/compare.py
+// 测量时应使用Release构建
+
+namespace {
+
+using BinarySig = Tensor(const Tensor&, const Tensor&);
+
+// 空内核 - unboxed入口，同时由KernelFunction自动生成boxed入口
+Tensor bench_cpu_kernel(const Tensor& a, const Tensor&) {
+    return a;
+}
+
+// 空内核 - 只有boxed入口，参数在栈上原地替换为结果
+void bench_cpu_boxed_kernel(const OperatorHandle&, DispatchKeySet, Stack* stack) {
+    IValue result = std::move((*stack)[0]);
+    stack->clear();
+    stack->push_back(std::move(result));
+}
+
+// 功能性key的直通包装器：不做任何事，直接redispatch到下一层
+template<DispatchKey Key>
+Tensor bench_passthrough_kernel(const OperatorHandle& op, DispatchKeySet ks, const Tensor& a, const Tensor& b) {
+    return op.typed<BinarySig>().redispatch(Key, ks, a, b);
+}
+
+template<DispatchKey Key>
+void bench_passthrough_boxed_kernel(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+    op.redispatchBoxed(Key, ks, stack);
+}
+
+// 按优先级从高到低依次加入的功能性key
+constexpr std::array<DispatchKey, 3> kFunctionalityKeys = {
+    DispatchKey::Autograd, DispatchKey::Tracing, DispatchKey::Profiling};
+
+DispatchKeySet functionalityKeys(int64_t count) {
+    DispatchKeySet keys;
+    for (int64_t i = 0; i < count; ++i) {
+        keys.add(kFunctionalityKeys[static_cast<size_t>(i)]);
+    }
+    return keys;
+}
+
+const OperatorHandle* g_bench_op = nullptr;        // bench_add：unboxed内核
+const OperatorHandle* g_bench_boxed_op = nullptr;  // bench_add_boxed：只有boxed内核
+
+void registerBenchOperators() {
+    OperatorHandle& op = registerOp("bench_add");
+    op.updateKernels()
+        .setKernel(DispatchKey::CPU, KernelFunction(bench_cpu_kernel))
+        .setKernel(DispatchKey::Autograd, KernelFunction(bench_passthrough_kernel<DispatchKey::Autograd>))
+        .setKernel(DispatchKey::Tracing, KernelFunction(bench_passthrough_kernel<DispatchKey::Tracing>))
+        .setKernel(DispatchKey::Profiling, KernelFunction(bench_passthrough_kernel<DispatchKey::Profiling>))
+        .publish();
+    g_bench_op = &op;
+
+    OperatorHandle& boxed_op = registerOp("bench_add_boxed");
+    boxed_op.updateKernels()
+        .setKernel(DispatchKey::CPU, KernelFunction(bench_cpu_boxed_kernel))
+        .setKernel(DispatchKey::Autograd, KernelFunction(bench_passthrough_boxed_kernel<DispatchKey::Autograd>))
+        .setKernel(DispatchKey::Tracing, KernelFunction(bench_passthrough_boxed_kernel<DispatchKey::Tracing>))
+        .setKernel(DispatchKey::Profiling, KernelFunction(bench_passthrough_boxed_kernel<DispatchKey::Profiling>))
+        .publish();
+    g_bench_boxed_op = &boxed_op;
+}
+
+// === boxed与unboxed调用 ===
+// 参数 range(0)：经过的功能性key数（0-3），通过线程局部的included集合加入
+
+void BM_CallOpByName(benchmark::State& state) {
+    IncludeDispatchKeyGuard keys(functionalityKeys(state.range(0)));
+    IValueList args = {IValue(make_tensor_cpu({2, 2})), IValue(make_tensor_cpu({2, 2}))};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(callOp("bench_add", args));
+    }
+}
+BENCHMARK(BM_CallOpByName)->DenseRange(0, 3);
+
+void BM_CallOpBoxed(benchmark::State& state) {
+    IncludeDispatchKeyGuard keys(functionalityKeys(state.range(0)));
+    IValueList args = {IValue(make_tensor_cpu({2, 2})), IValue(make_tensor_cpu({2, 2}))};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(callOp(*g_bench_op, args));
+    }
+}
+BENCHMARK(BM_CallOpBoxed)->DenseRange(0, 3);
+
+// 与BM_CallOpByName相同的调用，经过调用点缓存
+void BM_CallOpCached(benchmark::State& state) {
+    IncludeDispatchKeyGuard keys(functionalityKeys(state.range(0)));
+    IValueList args = {IValue(make_tensor_cpu({2, 2})), IValue(make_tensor_cpu({2, 2}))};
+    OperatorCallSite site(OperatorName("bench_add"));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(site.call(args));
+    }
+}
+BENCHMARK(BM_CallOpCached)->DenseRange(0, 3);
+
+// 原生boxed内核，直接在栈上调用：每次迭代重新压入参数
+void BM_CallBoxedStack(benchmark::State& state) {
+    IncludeDispatchKeyGuard keys(functionalityKeys(state.range(0)));
+    IValue a(make_tensor_cpu({2, 2}));
+    IValue b(make_tensor_cpu({2, 2}));
+    Stack stack;
+    stack.reserve(2);
+    for (auto _ : state) {
+        stack.push_back(a);
+        stack.push_back(b);
+        g_bench_boxed_op->callBoxed(&stack);
+        benchmark::DoNotOptimize(stack.data());
+        stack.clear();
+    }
+}
+BENCHMARK(BM_CallBoxedStack)->DenseRange(0, 3);
+
+void BM_CallOpUnboxed(benchmark::State& state) {
+    IncludeDispatchKeyGuard keys(functionalityKeys(state.range(0)));
+    auto op = g_bench_op->typed<BinarySig>();
+    Tensor a = make_tensor_cpu({2, 2});
+    Tensor b = make_tensor_cpu({2, 2});
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(op.call(a, b));
+    }
+}
+BENCHMARK(BM_CallOpUnboxed)->DenseRange(0, 3);
+
+// === DispatchKeySet ===
+
+void BM_HighestPriorityKey(benchmark::State& state) {
+    // 覆盖空集合、单个backend以及各种功能性key组合
+    std::vector<DispatchKeySet> sets;
+    for (uint64_t raw = 0; raw < (uint64_t(1) << static_cast<size_t>(DispatchKey::NumDispatchKeys)); ++raw) {
+        sets.push_back(DispatchKeySet::fromRaw(raw));
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        DispatchKeySet ks = sets[i];
+        benchmark::DoNotOptimize(ks);
+        benchmark::DoNotOptimize(ks.highestPriorityKey());
+        i = (i + 1) % sets.size();
+    }
+}
+BENCHMARK(BM_HighestPriorityKey);
+
+// === IValue ===
+// 每种tag分别测量构造、拷贝和移动；String/IntList分别测量内联和堆上两种存储
+
+template<typename Make>
+void BM_IValueConstruct(benchmark::State& state, Make make) {
+    for (auto _ : state) {
+        IValue value = make();
+        benchmark::DoNotOptimize(value);
+    }
+}
+
+template<typename Make>
+void BM_IValueCopy(benchmark::State& state, Make make) {
+    IValue source = make();
+    for (auto _ : state) {
+        IValue copy(source);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+
+template<typename Make>
+void BM_IValueMove(benchmark::State& state, Make make) {
+    IValue a = make();
+    IValue b;
+    for (auto _ : state) {
+        b = std::move(a);
+        benchmark::DoNotOptimize(b);
+        a = std::move(b);
+        benchmark::DoNotOptimize(a);
+    }
+}
+
+Tensor& benchTensor() {
+    static Tensor tensor = make_tensor_cpu({2, 2});
+    return tensor;
+}
+
+auto makeNone = [] { return IValue(); };
+auto makeTensor = [] { return IValue(benchTensor()); };
+auto makeDouble = [] { return IValue(1.0); };
+auto makeInt = [] { return IValue(int64_t(1)); };
+auto makeBool = [] { return IValue(true); };
+auto makeInlineString = [] { return IValue("short"); };
+auto makeHeapString = [] { return IValue(std::string(IValue::kInlineStringCapacity + 1, 'x')); };
+auto makeInlineIntList = [] { return IValue(std::vector<int64_t>{1, 2}); };
+auto makeHeapIntList = [] { return IValue(std::vector<int64_t>(IValue::kInlineIntListCapacity + 1, 1)); };
+auto makeDoubleList = [] { return IValue(std::vector<double>{1.0, 2.0}); };
+auto makeTensorList = [] { return IValue(std::vector<Tensor>{benchTensor(), benchTensor()}); };
+
+#define DISPATCHER_BENCH_IVALUE(tag, make)                 \
+    BENCHMARK_CAPTURE(BM_IValueConstruct, tag, make);      \
+    BENCHMARK_CAPTURE(BM_IValueCopy, tag, make);           \
+    BENCHMARK_CAPTURE(BM_IValueMove, tag, make)
+
+DISPATCHER_BENCH_IVALUE(None, makeNone);
+DISPATCHER_BENCH_IVALUE(Tensor, makeTensor);
+DISPATCHER_BENCH_IVALUE(Double, makeDouble);
+DISPATCHER_BENCH_IVALUE(Int, makeInt);
+DISPATCHER_BENCH_IVALUE(Bool, makeBool);
+DISPATCHER_BENCH_IVALUE(InlineString, makeInlineString);
+DISPATCHER_BENCH_IVALUE(HeapString, makeHeapString);
+DISPATCHER_BENCH_IVALUE(InlineIntList, makeInlineIntList);
+DISPATCHER_BENCH_IVALUE(HeapIntList, makeHeapIntList);
+DISPATCHER_BENCH_IVALUE(DoubleList, makeDoubleList);
+DISPATCHER_BENCH_IVALUE(TensorList, makeTensorList);
+
+// === 多线程扩展性 ===
+// 所有线程调用同一个操作符，每个线程使用自己的tensor；理想情况下每次调用的耗时不随线程数增长
+
+int maxBenchThreads() {
+    return static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+void BM_CallOpBoxedThreads(benchmark::State& state) {
+    IValueList args = {IValue(make_tensor_cpu({2, 2})), IValue(make_tensor_cpu({2, 2}))};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(callOp(*g_bench_op, args));
+    }
+}
+BENCHMARK(BM_CallOpBoxedThreads)->ThreadRange(1, maxBenchThreads())->UseRealTime();
+
+void BM_CallOpUnboxedThreads(benchmark::State& state) {
+    auto op = g_bench_op->typed<BinarySig>();
+    Tensor a = make_tensor_cpu({2, 2});
+    Tensor b = make_tensor_cpu({2, 2});
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(op.call(a, b));
+    }
+}
+BENCHMARK(BM_CallOpUnboxedThreads)->ThreadRange(1, maxBenchThreads())->UseRealTime();
+
+// === 注册 ===
+
+// 注册一个新操作符并设置内核，再注销它；名称循环使用，注册表的大小保持不变
+void BM_RegisterOperator(benchmark::State& state) {
+    constexpr size_t kNames = 64;
+    std::vector<OperatorName> names;
+    for (size_t i = 0; i < kNames; ++i) {
+        names.emplace_back("bench_register_" + std::to_string(i));
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        OperatorHandle& op = Dispatcher::instance().registerOperator(names[i]);
+        op.setKernel(DispatchKey::CPU, KernelFunction(bench_cpu_kernel));
+        Dispatcher::instance().deregisterOperator(names[i]);
+        i = (i + 1) % kNames;
+    }
+}
+BENCHMARK(BM_RegisterOperator);
+
+// 替换已有操作符的内核：每次都会重建并发布该操作符的dispatch table
+void BM_SetKernel(benchmark::State& state) {
+    OperatorHandle& op = registerOp("bench_set_kernel");
+    for (auto _ : state) {
+        op.setKernel(DispatchKey::CPU, KernelFunction(bench_cpu_kernel));
+    }
+    Dispatcher::instance().deregisterOperator(OperatorName("bench_set_kernel"));
+}
+BENCHMARK(BM_SetKernel);
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // 没有指定输出格式时默认输出JSON
+    std::vector<char*> args(argv, argv + argc);
+    char json_format[] = "--benchmark_format=json";
+    bool has_format = std::any_of(args.begin() + 1, args.end(), [](const char* arg) {
+        return std::strncmp(arg, "--benchmark_format", std::strlen("--benchmark_format")) == 0;
+    });
+    if (!has_format) {
+        args.insert(args.begin() + 1, json_format);
+    }
+    int new_argc = static_cast<int>(args.size());
+
+    benchmark::Initialize(&new_argc, args.data());
+    if (benchmark::ReportUnrecognizedArguments(new_argc, args.data())) {
+        return 1;
+    }
+    registerBenchOperators();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
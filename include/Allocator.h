@@ -0,0 +1,93 @@
+#pragma once
+
+#include "DispatchKey.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dispatcher {
+
+// 所有内置分配器返回的内存块都按该值对齐，向量化内核可以据此使用对齐的load/store
+constexpr size_t kAllocatorAlignment = 64;
+
+// AllocatorStats - 分配器的内存统计，用于容量规划
+struct AllocatorStats {
+    size_t allocated_bytes = 0;  // 当前被Storage使用的字节数（按实际分配的块大小计）
+    size_t peak_bytes = 0;       // allocated_bytes的历史峰值
+    size_t cached_bytes = 0;     // 已释放但缓存起来等待复用的字节数
+    size_t num_allocs = 0;       // allocate()调用次数
+    size_t num_cache_hits = 0;   // 其中直接复用缓存块的次数
+};
+
+// Allocator - 每个backend可替换的内存分配接口
+// deallocate收到与allocate相同的nbytes，分配器不需要自行记录块大小
+class Allocator {
+public:
+    virtual ~Allocator() = default;
+
+    // 分配至少nbytes字节，nbytes为0时返回nullptr
+    virtual void* allocate(size_t nbytes) = 0;
+    virtual void deallocate(void* ptr, size_t nbytes) = 0;
+
+    virtual AllocatorStats stats() const = 0;
+
+    // 把峰值重置为当前使用量
+    virtual void resetPeakStats() {}
+
+    // 把缓存的空闲块归还给系统
+    virtual void emptyCache() {}
+
+    virtual std::string name() const = 0;
+};
+
+// CachingAllocator - 按大小分级缓存的分配器，CPU和（模拟的）CUDA backend的默认分配器
+// 请求大小向上取整到2的幂（最小64字节），释放时把块放回对应级别的空闲链表，下次同级别的分配直接复用；
+// 超过kMaxCachedSize的大块不缓存，直接向系统申请和归还
+class CachingAllocator : public Allocator {
+public:
+    static constexpr size_t kMinBlockSize = kAllocatorAlignment;
+    static constexpr size_t kMaxCachedSize = size_t(64) << 20;  // 64MB
+
+    explicit CachingAllocator(std::string name);
+    ~CachingAllocator() override;
+
+    CachingAllocator(const CachingAllocator&) = delete;
+    CachingAllocator& operator=(const CachingAllocator&) = delete;
+
+    void* allocate(size_t nbytes) override;
+    void deallocate(void* ptr, size_t nbytes) override;
+
+    AllocatorStats stats() const override;
+    void resetPeakStats() override;
+    void emptyCache() override;
+
+    std::string name() const override { return name_; }
+
+    // 请求大小对应的块大小（2的幂）；超过kMaxCachedSize时按对齐值取整
+    static size_t roundSize(size_t nbytes);
+
+private:
+    static size_t sizeClassOf(size_t block_size);
+    static void* systemAllocate(size_t block_size);
+    static void systemFree(void* ptr);
+
+    static constexpr size_t kNumSizeClasses = 21;  // 64B, 128B, ..., 64MB
+
+    std::string name_;
+    mutable std::mutex mutex_;
+    std::array<std::vector<void*>, kNumSizeClasses> free_blocks_;  // 仅在持有mutex_时访问
+    AllocatorStats stats_;
+};
+
+// === 每个backend的分配器注册表 ===
+
+// 获取backend当前使用的分配器；没有设置过的backend使用对应的默认CachingAllocator
+Allocator* getAllocator(DispatchKey backend);
+
+// 替换backend的分配器，只影响之后创建的Storage；allocator必须比使用它的所有Storage活得更久
+void setAllocator(DispatchKey backend, Allocator* allocator);
+
+} // namespace dispatcher
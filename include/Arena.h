@@ -0,0 +1,120 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dispatcher {
+
+// Arena - 只增不减的bump分配器
+// 从大块内存中顺序切分小对象，释放时整体归还；适合生命周期相同的大量小对象（计算图节点、梯度记录等）
+// 只能存放可平凡析构的类型，Arena不会调用析构函数
+class Arena {
+public:
+    static constexpr size_t kDefaultBlockSize = 4096;
+
+    explicit Arena(size_t block_size = kDefaultBlockSize) : block_size_(block_size) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    // 移动后原Arena为空：cursor_/limit_指向的块随blocks_一起转移，不能留在原对象中
+    Arena(Arena&& other) noexcept
+        : block_size_(other.block_size_),
+          blocks_(std::move(other.blocks_)),
+          cursor_(std::exchange(other.cursor_, nullptr)),
+          limit_(std::exchange(other.limit_, nullptr)),
+          bytes_used_(std::exchange(other.bytes_used_, 0)) {
+        other.blocks_.clear();
+    }
+    Arena& operator=(Arena&& other) noexcept {
+        if (this != &other) {
+            block_size_ = other.block_size_;
+            blocks_ = std::move(other.blocks_);
+            other.blocks_.clear();
+            cursor_ = std::exchange(other.cursor_, nullptr);
+            limit_ = std::exchange(other.limit_, nullptr);
+            bytes_used_ = std::exchange(other.bytes_used_, 0);
+        }
+        return *this;
+    }
+
+    // 分配nbytes字节，按alignment对齐（alignment必须是2的幂）
+    void* allocate(size_t nbytes, size_t alignment = alignof(std::max_align_t)) {
+        uintptr_t current = reinterpret_cast<uintptr_t>(cursor_);
+        uintptr_t aligned = (current + alignment - 1) & ~(uintptr_t(alignment) - 1);
+        if (!cursor_ || aligned + nbytes > reinterpret_cast<uintptr_t>(limit_)) {
+            return allocateSlow(nbytes, alignment);
+        }
+        cursor_ = reinterpret_cast<char*>(aligned + nbytes);
+        bytes_used_ += nbytes;
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    // 分配count个默认初始化的T
+    template<typename T>
+    T* allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena只能存放可平凡析构的类型");
+        if (count == 0) {
+            return nullptr;
+        }
+        void* memory = allocate(sizeof(T) * count, alignof(T));
+        return new (memory) T[count];
+    }
+
+    // 在Arena中构造一个T
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena只能存放可平凡析构的类型");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // 释放除第一块以外的所有内存块，之后的分配从头复用第一块
+    void reset() {
+        if (blocks_.size() > 1) {
+            blocks_.resize(1);
+        }
+        if (!blocks_.empty()) {
+            cursor_ = blocks_.front().data.get();
+            limit_ = cursor_ + blocks_.front().size;
+        }
+        bytes_used_ = 0;
+    }
+
+    // 已分配给对象的字节数（不含对齐填充）与向系统申请的总字节数
+    size_t bytesUsed() const { return bytes_used_; }
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (const auto& block : blocks_) {
+            total += block.size;
+        }
+        return total;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void* allocateSlow(size_t nbytes, size_t alignment) {
+        // 超过块大小的对象单独占用一块
+        size_t size = std::max(block_size_, nbytes + alignment);
+        blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+        cursor_ = blocks_.back().data.get();
+        limit_ = cursor_ + size;
+        return allocate(nbytes, alignment);
+    }
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    char* cursor_ = nullptr;
+    char* limit_ = nullptr;
+    size_t bytes_used_ = 0;
+};
+
+} // namespace dispatcher
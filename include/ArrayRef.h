@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+namespace dispatcher {
+
+// ArrayRef - 不拥有数据的连续数组视图
+// 用于在不拷贝、不分配内存的情况下读取IValue中的列表
+template<typename T>
+class ArrayRef {
+public:
+    using value_type = T;
+    using iterator = const T*;
+    using const_iterator = const T*;
+    
+    constexpr ArrayRef() = default;
+    constexpr ArrayRef(const T* data, size_t size) : data_(data), size_(size) {}
+    ArrayRef(const std::vector<T>& vec) : data_(vec.data()), size_(vec.size()) {}
+    template<size_t N>
+    constexpr ArrayRef(const T (&array)[N]) : data_(array), size_(N) {}
+    constexpr ArrayRef(std::initializer_list<T> list) : data_(list.begin()), size_(list.size()) {}
+    
+    constexpr const T* data() const { return data_; }
+    constexpr size_t size() const { return size_; }
+    constexpr bool empty() const { return size_ == 0; }
+    
+    constexpr const T* begin() const { return data_; }
+    constexpr const T* end() const { return data_ + size_; }
+    
+    constexpr const T& operator[](size_t index) const { return data_[index]; }
+    
+    const T& at(size_t index) const {
+        if (index >= size_) {
+            throw std::out_of_range("ArrayRef index out of range");
+        }
+        return data_[index];
+    }
+    
+    // 拷贝为拥有数据的vector
+    std::vector<T> vec() const { return std::vector<T>(data_, data_ + size_); }
+
+private:
+    const T* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+using IntArrayRef = ArrayRef<int64_t>;
+
+} // namespace dispatcher
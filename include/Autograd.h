@@ -0,0 +1,124 @@
+#pragma once
+
+#include "Arena.h"
+#include "ArrayRef.h"
+#include "DispatchKey.h"
+#include "TensorImpl.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dispatcher {
+
+// === Autograd ===
+// Autograd key上的内核执行完前向计算后，用AutogradTape::record()记录反向节点，
+// 并通过输出tensor的grad_fn与之关联；requires_grad的叶子tensor没有grad_fn，反向时梯度累加到它的grad()
+// backward()从根tensor的grad_fn出发，按依赖计数调度：一个节点的所有下游节点都把梯度交给它之后才执行，
+// 互不依赖的分支并行执行——CPU（以及Meta）节点提交到CPU线程池，CUDA节点提交到CUDA的串行队列
+// 相互连接的节点属于同一个AutogradGraph，分配在该图的Arena中；图由它的输出tensor共同持有，
+// 最后一个输出释放时整个图一次性释放，不逐个释放节点
+
+struct AutogradNode;
+
+// 反向函数：由输出的梯度计算各输入的梯度，grad_inputs[i]对应node.inputs[i]
+// 不需要梯度的输入也会传入位置，可以留空；saved是记录时保存的tensor
+using BackwardFunction = void (*)(const AutogradNode& node, ArrayRef<Tensor> saved, const Tensor& grad_output,
+                                  Tensor* grad_inputs);
+
+// 反向图中的一条边：指向生成该输入的节点，或者需要累加梯度的叶子tensor；两者都为空表示该输入不需要梯度
+struct AutogradEdge {
+    AutogradNode* node = nullptr;
+    TensorImpl* leaf = nullptr;  // 所在的图保存了该叶子的引用，图释放之前一直有效
+};
+
+// 反向节点，分配在图的Arena中，只包含可平凡析构的成员
+struct AutogradNode {
+    const char* name;            // 操作符名，用于调试输出
+    BackwardFunction backward;
+    AutogradEdge* inputs;        // num_inputs条边，同样分配在Arena中
+    uint32_t num_inputs;
+    uint32_t num_saved;
+    const Tensor* saved;         // 保存的tensor，由所在的图持有
+    const int64_t* args;         // 记录时保存的整数参数（维度、大小等），同样分配在Arena中
+    uint32_t num_args;
+    DispatchKey device;          // 输出所在的backend，决定反向函数在哪个执行器上运行
+};
+
+// AutogradGraph - 一组相互连接的反向节点，以及它们引用的叶子和保存的tensor
+// 一个节点的输入来自不同的图时，其余的图被合并进第一个图：节点和引用整体移交，
+// 被合并的图只保留指向合并目标的引用，仍然持有它的输出因此继续有效
+// 保存的tensor不带grad_fn（与原tensor共享Storage），图与它的输出之间不会形成引用环
+class AutogradGraph {
+public:
+    AutogradGraph();
+    ~AutogradGraph();
+
+    AutogradGraph(const AutogradGraph&) = delete;
+    AutogradGraph& operator=(const AutogradGraph&) = delete;
+
+private:
+    friend class AutogradTape;
+
+    std::vector<Arena> arenas_;                     // arenas_[0]分配新节点，其余来自合并进来的图
+    std::vector<std::unique_ptr<Tensor[]>> saved_;  // 每个节点一组，地址在图的生命周期内不变
+    std::vector<Tensor> leaves_;                    // 边上引用的叶子
+    size_t num_nodes_ = 0;
+    std::shared_ptr<AutogradGraph> merged_into_;    // 已被合并时指向合并目标
+};
+
+// AutogradTape - 记录反向节点的全局入口
+// 记录由一个短暂持有的互斥锁串行化，可以在任意线程（包括异步执行器的工作线程）上记录；
+// 反向执行不持有这个锁，执行中的backward()不会阻塞其他线程上的记录
+class AutogradTape {
+public:
+    // 全局单例，程序退出时不析构
+    static AutogradTape& instance();
+
+    AutogradTape(const AutogradTape&) = delete;
+    AutogradTape& operator=(const AutogradTape&) = delete;
+
+    // 为output记录一个反向节点，output由inputs计算得到
+    // 任一输入需要梯度时才记录：设置output的grad_fn和requires_grad，并返回节点；否则返回nullptr
+    // saved和args复制到节点中，反向函数通过node.saved/node.args读取
+    AutogradNode* record(const char* name, BackwardFunction backward, ArrayRef<Tensor> inputs, const Tensor& output,
+                         ArrayRef<Tensor> saved = {}, IntArrayRef args = {});
+
+    // 所有仍存活的图中的节点数
+    size_t numNodes() const { return live_nodes_.load(std::memory_order_relaxed); }
+    
+    // 把grad累加到叶子的grad()；所有backward()共用grad_mutex_，不同线程上的反向经过同一个叶子时不会竞争
+    // 反向执行期间在锁外直接读写该叶子的grad()仍然不安全
+    void accumulateLeafGrad(TensorImpl& leaf, const Tensor& grad);
+
+private:
+    AutogradTape() = default;
+
+    friend class AutogradGraph;
+    friend void backward(const Tensor& root, Tensor grad_output);
+
+    // 以下函数需要持有mutex_
+    // tensor的grad_fn所在的图（跟随合并）
+    static std::shared_ptr<AutogradGraph> graphOfLocked(const Tensor& tensor);
+    // 把source的节点和引用移交给target
+    static void mergeLocked(const std::shared_ptr<AutogradGraph>& target, AutogradGraph& source);
+
+    mutable std::mutex mutex_;
+    std::mutex grad_mutex_;  // 保护所有叶子tensor的grad，与记录锁分开，累加梯度不阻塞记录
+    std::atomic<size_t> live_nodes_{0};
+};
+
+// 从root反向传播：grad_output为空时使用与root同形状、全为1的梯度
+// 叶子tensor的梯度累加到grad()；结束后root与它的图断开，再次对root调用backward不会传播梯度，
+// 图中的其他输出不受影响，图在最后一个输出释放时释放
+// 反向函数抛出的第一个异常在所有已调度的节点结束后重新抛出
+// 不同线程可以同时对共享叶子的不同图调用backward，叶子上的梯度累加相互串行
+// 不能在CPU线程池的任务中调用（会阻塞等待同一线程池上的任务）
+void backward(const Tensor& root, Tensor grad_output = Tensor());
+
+// 常用的反向函数
+// 逐元素加法：两个输入的梯度都等于输出的梯度
+void add_backward(const AutogradNode& node, ArrayRef<Tensor> saved, const Tensor& grad_output, Tensor* grad_inputs);
+
+} // namespace dispatcher
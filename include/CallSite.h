@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Dispatcher.h"
+#include "OperatorHandle.h"
+#include "Stack.h"
+#include <cstdint>
+
+namespace dispatcher {
+
+// === 调用点缓存 ===
+// 热循环中同一处代码反复以相同的key set调用同一个操作符，每次都按名称查找操作符、解析内核是重复劳动
+// OperatorCallSite缓存操作符句柄、上一次的dispatch key set以及解析出的内核，并记下Dispatcher::dispatchVersion()；
+// 版本号不变且key set相同时直接调用缓存的内核，只剩两次比较和一次间接调用
+// 任何注册、注销、setKernel或fallback变化都会递增版本号，所有调用点在下一次调用时自动重新解析
+// 与Dispatcher::call的行为相同：同样校验schema、记录事件、延迟采样和调用次数
+
+// OperatorCallSite - 一处调用点的缓存
+// 不是线程安全的：每个线程使用自己的对象（CALL_OP_CACHED使用thread_local）
+class OperatorCallSite {
+public:
+    explicit OperatorCallSite(OperatorName name) : name_(std::move(name)) {}
+
+    OperatorCallSite(const OperatorCallSite&) = delete;
+    OperatorCallSite& operator=(const OperatorCallSite&) = delete;
+
+    // 参数在栈上被原地替换为结果
+    void callBoxed(Stack* stack);
+
+    IValueList call(const IValueList& args) {
+        Stack stack(args);
+        callBoxed(&stack);
+        return stack;
+    }
+
+    const OperatorName& operatorName() const { return name_; }
+
+    // 命中与未命中（重新解析）的次数，用于观察缓存效果
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+private:
+    // 版本号变化后按名称重新查找操作符，调用方需处于ReadGuard内
+    void resolveOperator(uint64_t version);
+
+    OperatorName name_;
+
+    // 以下缓存只在version_等于当前分发版本号时有效
+    uint64_t version_ = UINT64_MAX;
+    const OperatorHandle* handle_ = nullptr;
+    const FunctionSchema* schema_ = nullptr;
+    DispatchKeySet ks_;
+    const KernelFunction* kernel_ = nullptr;  // 为nullptr表示ks_对应的内核还没有解析
+    DispatchKey kernel_key_ = DispatchKey::Undefined;
+
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
+} // namespace dispatcher
+
+// 在调用点缓存操作符和内核，例如 CALL_OP_CACHED("add", {IValue(a), IValue(b)})
+// 每处宏展开各自拥有一个线程局部的OperatorCallSite，因此op_name在同一处必须始终相同
+#define CALL_OP_CACHED(op_name, ...)                                                         \
+    ([&]() -> dispatcher::IValueList {                                                       \
+        static thread_local dispatcher::OperatorCallSite call_site{dispatcher::OperatorName(op_name)}; \
+        return call_site.call(__VA_ARGS__);                                                  \
+    }())
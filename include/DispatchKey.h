@@ -10,18 +10,19 @@ enum class DispatchKey : uint8_t {
     // Backend keys - 后端特定的dispatch key
     CPU = 0,
     CUDA = 1,
+    Meta = 2,  // 只有形状没有数据的tensor，内核只推断输出的sizes
     
     // Functionality keys - 功能性的dispatch key
-    Autograd = 2,
-    Tracing = 3,
-    Profiling = 4,
+    Autograd = 3,
+    Tracing = 4,
+    Profiling = 5,
     
     // Special keys - 特殊的dispatch key
-    Undefined = 5,
-    CatchAll = 6,
+    Undefined = 6,
+    CatchAll = 7,
     
     // 总数量，用于数组大小
-    NumDispatchKeys = 7
+    NumDispatchKeys = 8
 };
 
 // 将DispatchKey转换为字符串，用于调试
@@ -36,4 +37,36 @@ bool isBackendKey(DispatchKey key);
 // 检查是否是Functionality dispatch key  
 bool isFunctionalityKey(DispatchKey key);
 
+// DispatchKey在DispatchKeySet中的位索引
+// 位按优先级排列：优先级越高位索引越大，与dispatchKeyPriority的顺序一致，
+// 这样集合中最高优先级的key就是最高的置位，可用一次count-leading-zeros求出
+constexpr uint8_t dispatchKeyBit(DispatchKey key) {
+    switch (key) {
+        case DispatchKey::Autograd: return 7;
+        case DispatchKey::Tracing: return 6;
+        case DispatchKey::Profiling: return 5;
+        case DispatchKey::CPU: return 4;
+        case DispatchKey::CUDA: return 3;
+        case DispatchKey::Meta: return 2;
+        case DispatchKey::CatchAll: return 1;
+        case DispatchKey::Undefined: return 0;  // 空集合的最高位落在这里
+        default: return 0;
+    }
+}
+
+// dispatchKeyBit的逆映射
+constexpr DispatchKey dispatchKeyFromBit(uint8_t bit) {
+    constexpr DispatchKey kKeysByBit[] = {
+        DispatchKey::Undefined,
+        DispatchKey::CatchAll,
+        DispatchKey::Meta,
+        DispatchKey::CUDA,
+        DispatchKey::CPU,
+        DispatchKey::Profiling,
+        DispatchKey::Tracing,
+        DispatchKey::Autograd,
+    };
+    return bit < static_cast<uint8_t>(DispatchKey::NumDispatchKeys) ? kKeysByBit[bit] : DispatchKey::Undefined;
+}
+
 } // namespace dispatcher 
\ No newline at end of file
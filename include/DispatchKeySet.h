@@ -1,73 +1,155 @@
 #pragma once
 
 #include "DispatchKey.h"
-#include <bitset>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <string>
 #include <vector>
 
 namespace dispatcher {
 
 // DispatchKeySet - 管理dispatch key的集合
-// 使用bitset来高效存储和操作dispatch key集合
+// 使用一个uint64_t位掩码存储，位布局按优先级排列（见dispatchKeyBit），
+// 所有集合运算都是constexpr的，key set的组合可以在编译期折叠
 class DispatchKeySet {
 public:
+    // 按优先级从高到低遍历集合中key的迭代器，不分配内存
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = DispatchKey;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const DispatchKey*;
+        using reference = DispatchKey;
+        
+        constexpr explicit iterator(uint64_t remaining) : remaining_(remaining) {}
+        
+        constexpr DispatchKey operator*() const {
+            return dispatchKeyFromBit(highestBit(remaining_));
+        }
+        
+        constexpr iterator& operator++() {
+            remaining_ &= ~(uint64_t(1) << highestBit(remaining_));
+            return *this;
+        }
+        
+        constexpr iterator operator++(int) {
+            iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+        
+        constexpr bool operator==(const iterator& other) const { return remaining_ == other.remaining_; }
+        constexpr bool operator!=(const iterator& other) const { return remaining_ != other.remaining_; }
+        
+    private:
+        uint64_t remaining_;
+    };
+    
     // 构造函数 - 创建空的dispatch key集合
-    DispatchKeySet() = default;
+    constexpr DispatchKeySet() = default;
     
     // 构造函数 - 从单个dispatch key创建集合
-    explicit DispatchKeySet(DispatchKey key);
+    constexpr explicit DispatchKeySet(DispatchKey key) : raw_repr_(keyMask(key)) {}
     
     // 构造函数 - 从多个dispatch key创建集合
-    DispatchKeySet(std::initializer_list<DispatchKey> keys);
+    constexpr DispatchKeySet(std::initializer_list<DispatchKey> keys) {
+        for (auto key : keys) {
+            raw_repr_ |= keyMask(key);
+        }
+    }
+    
+    // 优先级低于指定key的所有key组成的集合
+    // 位布局按优先级排列，因此就是该key所在位以下的所有位，用于重新分发时屏蔽当前及更高优先级的key
+    static constexpr DispatchKeySet keysBelow(DispatchKey key) {
+        return fromRaw(keyMask(key) - 1);
+    }
+    
+    // 从原始位表示构造集合，配合raw()用于查表
+    static constexpr DispatchKeySet fromRaw(uint64_t raw) {
+        DispatchKeySet result;
+        result.raw_repr_ = raw;
+        return result;
+    }
     
     // 添加dispatch key到集合中
-    DispatchKeySet& add(DispatchKey key);
+    constexpr DispatchKeySet& add(DispatchKey key) {
+        raw_repr_ |= keyMask(key);
+        return *this;
+    }
     
     // 从集合中移除dispatch key
-    DispatchKeySet& remove(DispatchKey key);
+    constexpr DispatchKeySet& remove(DispatchKey key) {
+        raw_repr_ &= ~keyMask(key);
+        return *this;
+    }
     
     // 检查集合中是否包含指定的dispatch key
-    bool has(DispatchKey key) const;
+    constexpr bool has(DispatchKey key) const { return (raw_repr_ & keyMask(key)) != 0; }
     
     // 检查集合是否为空
-    bool empty() const;
+    constexpr bool empty() const { return raw_repr_ == 0; }
     
     // 清空集合
-    void clear();
+    constexpr void clear() { raw_repr_ = 0; }
     
     // 获取最高优先级的dispatch key
-    // 按照dispatch key的优先级顺序返回第一个存在的key
-    DispatchKey highestPriorityKey() const;
+    // 最高置位即最高优先级；空集合时或上Undefined所在的第0位，因此无需分支
+    constexpr DispatchKey highestPriorityKey() const {
+        return dispatchKeyFromBit(highestBit(raw_repr_ | keyMask(DispatchKey::Undefined)));
+    }
     
     // 集合运算 - 并集
-    DispatchKeySet operator|(const DispatchKeySet& other) const;
-    DispatchKeySet& operator|=(const DispatchKeySet& other);
+    constexpr DispatchKeySet operator|(const DispatchKeySet& other) const { return fromRaw(raw_repr_ | other.raw_repr_); }
+    constexpr DispatchKeySet& operator|=(const DispatchKeySet& other) {
+        raw_repr_ |= other.raw_repr_;
+        return *this;
+    }
     
     // 集合运算 - 交集
-    DispatchKeySet operator&(const DispatchKeySet& other) const;
-    DispatchKeySet& operator&=(const DispatchKeySet& other);
+    constexpr DispatchKeySet operator&(const DispatchKeySet& other) const { return fromRaw(raw_repr_ & other.raw_repr_); }
+    constexpr DispatchKeySet& operator&=(const DispatchKeySet& other) {
+        raw_repr_ &= other.raw_repr_;
+        return *this;
+    }
     
     // 集合运算 - 差集
-    DispatchKeySet operator-(const DispatchKeySet& other) const;
-    DispatchKeySet& operator-=(const DispatchKeySet& other);
+    constexpr DispatchKeySet operator-(const DispatchKeySet& other) const { return fromRaw(raw_repr_ & ~other.raw_repr_); }
+    constexpr DispatchKeySet& operator-=(const DispatchKeySet& other) {
+        raw_repr_ &= ~other.raw_repr_;
+        return *this;
+    }
     
     // 比较运算符
-    bool operator==(const DispatchKeySet& other) const;
-    bool operator!=(const DispatchKeySet& other) const;
+    constexpr bool operator==(const DispatchKeySet& other) const { return raw_repr_ == other.raw_repr_; }
+    constexpr bool operator!=(const DispatchKeySet& other) const { return raw_repr_ != other.raw_repr_; }
+    
+    // 按优先级从高到低遍历
+    constexpr iterator begin() const { return iterator(raw_repr_); }
+    constexpr iterator end() const { return iterator(0); }
     
     // 转换为vector，按优先级排序
     std::vector<DispatchKey> toVector() const;
     
+    // 获取原始位表示，可直接作为按key set索引的表下标
+    constexpr uint64_t raw() const { return raw_repr_; }
+    
     // 调试用字符串表示
     std::string toString() const;
 
 private:
-    // 使用bitset存储dispatch key集合
-    std::bitset<static_cast<size_t>(DispatchKey::NumDispatchKeys)> raw_repr_;
+    uint64_t raw_repr_ = 0;
+    
+    // 内部辅助函数 - 获取dispatch key对应的位掩码
+    static constexpr uint64_t keyMask(DispatchKey key) {
+        return uint64_t(1) << dispatchKeyBit(key);
+    }
     
-    // 内部辅助函数 - 获取dispatch key的索引
-    static size_t keyIndex(DispatchKey key) {
-        return static_cast<size_t>(key);
+    // 内部辅助函数 - 最高置位的索引，调用方保证bits非零
+    static constexpr uint8_t highestBit(uint64_t bits) {
+        return static_cast<uint8_t>(63 - __builtin_clzll(bits));
     }
 };
 
-} // namespace dispatcher 
\ No newline at end of file
+} // namespace dispatcher
@@ -1,9 +1,16 @@
 #pragma once
 
 #include "OperatorHandle.h"
+#include "StaticRegistration.h"
 #include "DispatchKey.h"
 #include "DispatchKeySet.h"
 #include "IValue.h"
+#include "Stack.h"
+#include "LatencyHistogram.h"
+#include "Executor.h"
+#include "Future.h"
+#include <array>
+#include <atomic>
 #include <unordered_map>
 #include <string>
 #include <memory>
@@ -58,14 +65,19 @@ public:
     static Dispatcher& instance();
     
     // 析构函数
-    ~Dispatcher() = default;
+    ~Dispatcher();
     
     // 注册新的操作符 - 返回操作符句柄用于后续内核注册
     OperatorHandle& registerOperator(const OperatorName& name);
     
-    // 查找已注册的操作符
+    // 查找已注册的操作符 - 在EpochManager::ReadGuard内无锁读取注册表快照
+    // 返回的句柄在deregisterOperator之后被退休，等所有在注销前进入的读侧临界区结束后释放：
+    // 可能与注销并发时，调用方应在调用前自行进入ReadGuard，并且只在该guard的作用域内使用句柄；
+    // 没有持有guard时，句柄只在该操作符不会被注销期间有效（例如注册后常驻的操作符）
     OperatorHandle* findOperator(const OperatorName& name);
     const OperatorHandle* findOperator(const OperatorName& name) const;
+    OperatorHandle* findOperator(OperatorId id);
+    const OperatorHandle* findOperator(OperatorId id) const;
     
     // 注销操作符
     void deregisterOperator(const OperatorName& name);
@@ -83,6 +95,49 @@ public:
     // 便捷调用接口 - 直接使用字符串名称
     IValueList call(const std::string& name, const IValueList& args) const;
     
+    // 快速调用接口 - 使用缓存的句柄或ID，跳过名称哈希
+    IValueList call(OperatorId id, const IValueList& args) const;
+    IValueList call(const OperatorHandle& handle, const IValueList& args) const;
+    
+    // 基于栈的调用接口 - 栈上的参数被原地替换为结果，配合PooledStack可以做到调用链上零分配
+    void callBoxed(const OperatorHandle& handle, Stack* stack) const;
+    void callBoxed(OperatorId id, Stack* stack) const;
+    
+    // 批量调用接口 - 见OperatorHandle::callBatch，开启统计时每个调用都会被计数
+    std::vector<IValueList> callBatch(const OperatorHandle& handle, ArrayRef<IValueList> batch,
+                                      DispatchKeySet hint = DispatchKeySet()) const;
+    
+    // 异步调用接口 - 在调用方线程上计算dispatch key set后，把调用提交到其backend对应的执行器并立即返回
+    // 同一backend上的调用由同一个执行器执行：CUDA的执行器是按顺序执行的队列（类似stream），
+    // CPU的执行器是工作窃取线程池；调用方线程的局部包含/排除key集合在任务执行期间同样生效
+    // 调用方需要保证操作符在异步调用完成前不被注销
+    DispatchFuture callAsync(const OperatorName& name, IValueList args) const;
+    DispatchFuture callAsync(OperatorId id, IValueList args) const;
+    DispatchFuture callAsync(const OperatorHandle& handle, IValueList args) const;
+    
+    // 执行器管理 - 每个backend key一个执行器，第一次使用时创建默认执行器
+    // setExecutor替换之后提交的调用使用的执行器，已经提交的任务仍由原执行器完成
+    std::shared_ptr<Executor> getExecutor(DispatchKey backend) const;
+    void setExecutor(DispatchKey backend, std::shared_ptr<Executor> executor);
+    
+    // 等待指定backend（或所有backend）上此前提交的异步调用全部完成
+    void synchronize(DispatchKey backend) const;
+    void synchronize() const;
+    
+    // 全局fallback - 某个dispatch key上所有没有自己内核的操作符共用的boxed实现
+    // fallback收到操作符句柄、key set和参数栈，通常处理完后通过redispatchBoxed跳到下一层；
+    // 注册/注销时重新发布所有操作符的dispatch table，因此调用时与直接注册的内核一样只需一次查表
+    // 与内核注册一样接受任意boxed形式（基于栈或返回IValueList）的函数
+    template<typename Func>
+    void registerFallback(DispatchKey key, Func&& fallback) {
+        setFallback(key, KernelFunction(std::forward<Func>(fallback)));
+    }
+    void deregisterFallback(DispatchKey key);
+    bool hasFallback(DispatchKey key) const;
+    
+    // 当前所有fallback的副本，供OperatorHandle发布新表时使用
+    KernelFunctionTable getFallbacks() const;
+    
     // 调试功能 - 打印所有注册的操作符和内核
     std::string debugString() const;
     void printDebugInfo() const;
@@ -92,41 +147,128 @@ public:
     void addRegistrationCallback(OperatorRegistrationCallback callback);
     
     // 性能监控 - 统计每个操作符的调用次数
+    // 计数写入每个线程私有的分片（按OperatorId和DispatchKey索引的平坦数组，relaxed原子操作），
+    // 只有读取统计时才合并各分片，因此调用路径上没有锁
     struct CallStats {
         size_t call_count = 0;
         std::unordered_map<DispatchKey, size_t> key_counts;
     };
     
-    void enableProfiling(bool enabled) { profiling_enabled_ = enabled; }
-    bool isProfilingEnabled() const { return profiling_enabled_; }
-    const std::unordered_map<OperatorName, CallStats>& getCallStats() const { return call_stats_; }
+    void enableProfiling(bool enabled) { profiling_enabled_.store(enabled, std::memory_order_relaxed); }
+    bool isProfilingEnabled() const { return profiling_enabled_.load(std::memory_order_relaxed); }
+    
+    // 获取合并后的统计快照，返回的副本之后不会再被其他线程修改
+    std::unordered_map<OperatorName, CallStats> getCallStats() const;
+    
+    // 清零所有分片；与并发调用同时进行时，正在进行的计数可能被保留或丢弃
     void resetCallStats();
+    
+    // 延迟统计 - 按操作符和实际执行的DispatchKey记录内核耗时的直方图
+    // 每层包装器（Autograd/Tracing/...）的耗时包含其下层的耗时
+    // sample_period为N时每个线程每N次内核调用采样一次，0表示关闭
+    void setLatencySamplingPeriod(uint32_t sample_period) {
+        latency_sample_period_.store(sample_period, std::memory_order_relaxed);
+    }
+    uint32_t latencySamplingPeriod() const { return latency_sample_period_.load(std::memory_order_relaxed); }
+    
+    struct LatencyStats {
+        std::unordered_map<DispatchKey, LatencyHistogram> per_key;
+    };
+    
+    // 获取合并后的延迟快照，与getCallStats()一样在读取时合并各线程分片
+    std::unordered_map<OperatorName, LatencyStats> getLatencyStats() const;
+    
+    // 调用路径使用 - 判断本次内核调用是否需要计时（关闭时只有一次relaxed load）
+    static bool shouldSampleLatency() {
+        uint32_t period = latency_sample_period_.load(std::memory_order_relaxed);
+        if (period == 0) {
+            return false;
+        }
+        static thread_local uint32_t countdown = 0;
+        if (countdown == 0) {
+            countdown = period;
+        }
+        return --countdown == 0;
+    }
+    
+    // 调用路径使用 - 记录一次采样到当前线程的分片
+    void recordLatency(OperatorId id, DispatchKey key, uint64_t nanos) const;
+
+    // 绕过Dispatcher::call直接调用内核的执行器（如GraphExecutor）使用 - 计入调用次数，调用方自行检查isProfilingEnabled()
+    void recordCall(OperatorId id, DispatchKey key, size_t count = 1) const { updateCallStats(id, key, count); }
+    
+    // 分发版本号 - 注册表快照或任一操作符的dispatch table每发布一次新版本就递增
+    // 调用点缓存（见CallSite.h）在ReadGuard内读到的版本号不变时，缓存的句柄和内核指针仍然有效
+    static uint64_t dispatchVersion() { return dispatch_version_.load(std::memory_order_acquire); }
+    // 发布新版本之后、retire旧版本之前调用
+    static void bumpDispatchVersion() { dispatch_version_.fetch_add(1, std::memory_order_acq_rel); }
 
 private:
     // 私有构造函数 - 单例模式
-    Dispatcher() = default;
+    Dispatcher();
     
     // 禁用拷贝和赋值
     Dispatcher(const Dispatcher&) = delete;
     Dispatcher& operator=(const Dispatcher&) = delete;
     
-    // 操作符注册表 - 操作符名称到句柄的映射
+    // 由静态注册表（见StaticRegistration.h）一次性建立初始注册表，只在构造时调用
+    void loadStaticRegistrations();
+    
+    // 注册表快照 - 发布后不可修改，读路径无锁访问
+    // 任何修改都复制出新快照再原子替换，旧快照通过EpochManager延迟回收
+    struct RegistrySnapshot {
+        std::unordered_map<OperatorName, OperatorHandle*> by_name;
+        std::vector<OperatorHandle*> by_id;  // 按OperatorId索引，已注销的为nullptr
+        std::vector<OperatorName> names;     // 按OperatorId索引的intern名称，只增不减
+    };
+    
+    // 按（操作符名、重载名、dispatch key）排序的静态条目副本，同一操作符的条目连续存放，
+    // 静态注册的句柄直接引用其中的一段；构造后不再修改
+    std::vector<StaticKernelEntry> static_kernels_;
+    
+    // 操作符注册表 - 操作符名称到句柄的映射，拥有所有句柄（仅在持有锁时访问）
     std::unordered_map<OperatorName, std::unique_ptr<OperatorHandle>> operators_;
     
-    // 线程安全 - 保护注册表的并发访问
+    // 名称到ID的intern表，只增不减（仅在持有锁时访问）
+    std::unordered_map<OperatorName, OperatorId> interned_ids_;
+    
+    // 当前发布的注册表快照
+    std::atomic<const RegistrySnapshot*> snapshot_;
+    
+    // 线程安全 - 串行化注册/注销等慢路径修改
     mutable std::mutex registry_mutex_;
     
     // 回调函数列表
     std::vector<OperatorRegistrationCallback> registration_callbacks_;
     
+    // 全局fallback，按DispatchKey索引（仅在持有fallback_mutex_时访问）
+    // fallback_mutex_不与其他锁嵌套获取，OperatorHandle在持有写锁时可以安全读取
+    KernelFunctionTable fallbacks_;
+    mutable std::mutex fallback_mutex_;
+    
+    // 每个backend key的异步执行器，按DispatchKey索引，惰性创建（仅在持有executor_mutex_时访问）
+    mutable std::array<std::shared_ptr<Executor>, static_cast<size_t>(DispatchKey::NumDispatchKeys)> executors_;
+    mutable std::mutex executor_mutex_;
+    
     // 性能统计
-    bool profiling_enabled_ = false;
-    mutable std::unordered_map<OperatorName, CallStats> call_stats_;
+    std::atomic<bool> profiling_enabled_{false};
+    static std::atomic<uint32_t> latency_sample_period_;
+    
+    static std::atomic<uint64_t> dispatch_version_;
+    
+    // 所有线程的统计分片，分片只在线程第一次记录时加入链表，线程退出后可被复用
+    struct CallStatsShard;
+    mutable std::vector<std::unique_ptr<CallStatsShard>> stats_shards_;
     mutable std::mutex stats_mutex_;
     
     // 内部辅助函数
+    const RegistrySnapshot* currentSnapshot() const { return snapshot_.load(std::memory_order_acquire); }
+    void publishSnapshot(const RegistrySnapshot* snapshot);
+    OperatorId internOperatorName(const OperatorName& name);
     void notifyRegistrationCallbacks(const OperatorName& name, bool registered);
-    void updateCallStats(const OperatorName& name, DispatchKey key) const;
+    void setFallback(DispatchKey key, KernelFunction fallback);
+    void updateCallStats(OperatorId id, DispatchKey key, size_t count = 1) const;
+    CallStatsShard& localStatsShard() const;
 };
 
 // 全局便捷函数 - 直接访问默认dispatcher
@@ -137,6 +279,13 @@ OperatorHandle& registerOp(const std::string& name, const std::string& overload)
 IValueList callOp(const OperatorName& name, const IValueList& args);
 IValueList callOp(const OperatorName& name, const DispatchKeySet& ks, const IValueList& args);
 IValueList callOp(const std::string& name, const IValueList& args);
+IValueList callOp(OperatorId id, const IValueList& args);
+IValueList callOp(const OperatorHandle& handle, const IValueList& args);
+
+DispatchFuture callOpAsync(const OperatorName& name, IValueList args);
+DispatchFuture callOpAsync(const std::string& name, IValueList args);
+DispatchFuture callOpAsync(OperatorId id, IValueList args);
+DispatchFuture callOpAsync(const OperatorHandle& handle, IValueList args);
 
 // 便捷宏 - 简化操作符注册
 #define REGISTER_OP(name) \
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "TensorImpl.h"
+#include "Vectorized.h"
+#include <string>
+#include <vector>
+
+namespace dispatcher {
+
+// === Tensor级别的逐元素运算 ===
+// 输出与a同形状、同backend；按parallel_for切分，每块从向量宽度对齐的位置开始，
+// 输入来自64字节对齐的缓存分配器时内核使用对齐的load/store
+
+// out = op(a, b)，a和b的元素数必须相同
+Tensor binary_op(BinaryOp op, const Tensor& a, const Tensor& b);
+
+// out = op(a, scalar)
+Tensor binary_op(BinaryOp op, const Tensor& a, float scalar);
+
+// out = op(a)
+Tensor unary_op(UnaryOp op, const Tensor& a);
+
+// === 融合的逐元素表达式 ===
+// 由多个逐元素运算组成的表达式，按后序排列成指令序列，一次遍历数据完成全部计算
+// 寄存器0..num_inputs-1是输入，第i条指令的结果写入寄存器num_inputs+i，最后一条指令的结果是输出
+
+struct ElementwiseInstruction {
+    enum class Kind : uint8_t { Binary, BinaryScalar, Unary };
+
+    Kind kind;
+    BinaryOp binary_op = BinaryOp::Add;  // Binary/BinaryScalar
+    UnaryOp unary_op = UnaryOp::Neg;     // Unary
+    uint32_t lhs = 0;                    // 操作数寄存器
+    uint32_t rhs = 0;                    // Binary的第二个操作数寄存器
+    float scalar = 0.0f;                 // BinaryScalar的标量
+};
+
+struct ElementwiseExpr {
+    size_t num_inputs = 0;
+    size_t shape_input = 0;  // 输出的shape取自哪个输入，与逐个调用时的结果shape一致
+    std::vector<ElementwiseInstruction> instructions;
+
+    // 例如 "((%0 + %1) + 1) + %0"
+    std::string toString() const;
+};
+
+// 计算表达式：按缓存大小的小块处理，中间结果只存在于小块缓冲区中，
+// 每个输入元素只从内存读取一次，输出元素只写入一次；所有输入的元素数必须相同
+Tensor fused_elementwise_op(const ElementwiseExpr& expr, const std::vector<Tensor>& inputs);
+
+} // namespace dispatcher
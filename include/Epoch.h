@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace dispatcher {
+
+// EpochManager - 基于epoch的延迟回收（EBR）
+// 读者在临界区内无锁地读取写时复制的快照；写者发布新快照后把旧快照退休，
+// 直到所有可能看到旧快照的读者都离开临界区之后才真正释放
+class EpochManager {
+public:
+    static EpochManager& instance();
+    
+    ~EpochManager();
+    
+    // RAII读侧临界区 - 支持嵌套，只有最外层会公布/撤销epoch
+    class ReadGuard {
+    public:
+        ReadGuard();
+        ~ReadGuard();
+        
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+    
+    // 退休一个已经从共享结构中摘除的对象，等到安全时再delete
+    template<typename T>
+    void retire(const T* ptr) {
+        retire(ptr, [](const void* p) { delete static_cast<const T*>(p); });
+    }
+    
+    void retire(const void* ptr, void (*deleter)(const void*));
+    
+    // 回收所有已经没有读者可能访问的对象
+    void collect();
+
+private:
+    // 每个线程独占一个槽位，独占缓存行避免读者之间的伪共享
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};   // 0表示不在临界区内
+        std::atomic<bool> in_use{false};
+        Slot* next = nullptr;
+    };
+    
+    struct Retired {
+        const void* ptr;
+        void (*deleter)(const void*);
+        uint64_t epoch;  // 退休时的全局epoch
+    };
+    
+    EpochManager() = default;
+    
+    EpochManager(const EpochManager&) = delete;
+    EpochManager& operator=(const EpochManager&) = delete;
+    
+    // 为当前线程获取（或复用）一个槽位
+    Slot* acquireSlot();
+    void releaseSlot(Slot* slot);
+    
+    // 内部辅助函数 - 在持有retire_mutex_时取出可以安全释放的对象
+    std::vector<Retired> takeReclaimableLocked();
+    
+    std::atomic<uint64_t> global_epoch_{1};
+    
+    // 槽位链表只增不减，线程退出后槽位可被新线程复用
+    std::atomic<Slot*> slots_head_{nullptr};
+    
+    std::mutex retire_mutex_;
+    std::vector<Retired> retired_;
+    
+    friend struct EpochThreadState;
+};
+
+} // namespace dispatcher
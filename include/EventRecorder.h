@@ -0,0 +1,158 @@
+#pragma once
+
+#include "DispatchKey.h"
+#include "TensorImpl.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dispatcher {
+
+// === 分发事件记录 ===
+// 开启后（GlobalDispatchState::setEventRecordingEnabled）每次内核调用都记录为一个定长事件：
+// 操作符、实际执行的dispatch key、所在线程、开始/结束时间以及嵌套深度，redispatch到下一层也是一次嵌套的调用
+// 每个线程写自己的单生产者单消费者环形缓冲区，记录路径上没有锁；缓冲区满时丢弃新事件并计数
+// flush()（或后台flush线程）把各缓冲区中的事件移入EventRecorder：默认保存在内存中一个有界的历史里，
+// 超过上限时淘汰最旧的事件，之后可以导出为Chrome trace JSON；长时间记录时改用startStreaming()，
+// 每次flush把事件直接追加写入trace文件，内存中不保留
+// 导出的文件可以在chrome://tracing或Perfetto UI（ui.perfetto.dev）中按线程查看时间线
+
+// DispatchEvent - 一次内核调用
+struct DispatchEvent {
+    uint64_t start_ns;  // 相对EventRecorder创建时刻的纳秒数
+    uint64_t end_ns;
+    uint32_t op;        // OperatorId
+    DispatchKey key;
+    uint8_t depth;      // 开始时当前线程上正在执行的外层内核数
+};
+
+// flush之后的事件，附带写入它的缓冲区编号（同一时刻每个缓冲区只属于一个线程）
+struct RecordedEvent {
+    DispatchEvent event;
+    uint32_t thread;
+};
+
+class EventRecorder {
+public:
+    // 每个线程的缓冲区能容纳的未flush事件数
+    static constexpr size_t kRingCapacity = size_t(1) << 12;
+    // 内存中保留的已flush事件数上限的默认值
+    static constexpr size_t kDefaultMaxEvents = size_t(1) << 20;
+
+    // 全局单例，程序退出时不析构；后台flush线程需要在退出前用stopFlusher()停止
+    static EventRecorder& instance();
+
+    EventRecorder(const EventRecorder&) = delete;
+    EventRecorder& operator=(const EventRecorder&) = delete;
+
+    // 把各线程缓冲区中的事件移入已记录的事件列表（或写入正在流式输出的trace文件），可以与记录并发调用
+    void flush();
+
+    // 后台flush线程：每隔period调用一次flush()；重复启动时先停止之前的线程
+    void startFlusher(std::chrono::milliseconds period = std::chrono::milliseconds(10));
+    void stopFlusher();
+
+    // 内存中已flush事件数的上限，超过时淘汰最旧的事件；调小时立即淘汰多出的事件
+    void setMaxEvents(size_t max_events);
+    size_t maxEvents() const;
+
+    // 已flush的事件，按flush的顺序排列（同一线程内按结束时间排列）
+    std::vector<RecordedEvent> events() const;
+    // 清空已flush的事件以及丢弃、淘汰计数，缓冲区中尚未flush的事件不受影响
+    void clear();
+    // 缓冲区满而丢弃的事件数
+    uint64_t droppedEvents() const;
+    // 超过maxEvents()而从内存中淘汰的事件数
+    uint64_t evictedEvents() const;
+
+    // 先flush，再把内存中的事件写成Chrome trace JSON（"X"类型的完整事件，时间单位为微秒）
+    void writeChromeTrace(std::ostream& os);
+    void writeChromeTrace(const std::string& path);
+
+    // 流式输出：先flush，之后每次flush把新事件追加写入path处的Chrome trace JSON，不再保存在内存中
+    // stopStreaming()写入剩余的事件并补全JSON；重复开始时先结束之前的文件
+    void startStreaming(const std::string& path);
+    void stopStreaming();
+
+    // 记录路径使用
+    uint64_t nowNanos() const {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch_).count());
+    }
+    void record(const DispatchEvent& event);
+
+private:
+    EventRecorder();
+
+    // 单生产者（所属线程）单消费者（持有flush_mutex_的flush）的环形缓冲区
+    struct Ring {
+        std::array<DispatchEvent, kRingCapacity> events;
+        alignas(64) std::atomic<uint64_t> head{0};  // 写者推进
+        alignas(64) std::atomic<uint64_t> tail{0};  // flush推进
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> in_use{false};
+        uint32_t index = 0;
+    };
+
+    Ring& localRing();
+
+    const std::chrono::steady_clock::time_point epoch_;
+
+    // 所有缓冲区，只增不减；线程退出后它的缓冲区可被新线程复用
+    std::vector<std::unique_ptr<Ring>> rings_;
+    mutable std::mutex rings_mutex_;
+
+    // 以下成员仅在持有flush_mutex_时访问
+    void appendLocked(const RecordedEvent& event);
+
+    std::deque<RecordedEvent> flushed_;  // 内存中有界的已flush事件
+    size_t max_events_ = kDefaultMaxEvents;
+    uint64_t evicted_ = 0;
+    uint64_t dropped_before_clear_ = 0;
+    std::ofstream stream_;               // 正在流式输出的trace文件
+    bool streaming_ = false;
+    size_t streamed_ = 0;                // 已写入stream_的事件数
+    mutable std::mutex flush_mutex_;
+
+    std::thread flusher_;
+    bool stop_flusher_ = false;
+    std::mutex flusher_mutex_;
+    std::condition_variable flusher_cv_;
+};
+
+// DispatchEventScope - 在作用域结束时记录一次内核调用
+// 默认构造不做任何事；只有调用了begin()的作用域才会记录，调用路径在关闭记录时只多一次relaxed load
+class DispatchEventScope {
+public:
+    DispatchEventScope() = default;
+    ~DispatchEventScope() {
+        if (active_) {
+            end();
+        }
+    }
+
+    DispatchEventScope(const DispatchEventScope&) = delete;
+    DispatchEventScope& operator=(const DispatchEventScope&) = delete;
+
+    static bool enabled() { return GlobalDispatchState::instance().isEventRecordingEnabled(); }
+
+    void begin(uint32_t op, DispatchKey key);
+
+private:
+    void end();
+
+    bool active_ = false;
+    DispatchEvent event_{};
+};
+
+} // namespace dispatcher
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace dispatcher {
+
+// Executor - 异步调用的执行器接口
+// Dispatcher为每个backend key维护一个执行器，callAsync把调用打包成任务提交到对应的执行器上
+// 任务不应抛出异常（callAsync会把内核的异常存入future）
+class Executor {
+public:
+    using Task = std::function<void()>;
+
+    virtual ~Executor() = default;
+
+    // 提交一个任务，立即返回
+    void submit(Task task);
+
+    // 阻塞直到此前提交的所有任务执行完毕（类似cudaStreamSynchronize）
+    void synchronize();
+
+    // 执行器名称，用于调试输出
+    virtual std::string name() const = 0;
+
+protected:
+    // 子类把任务放入自己的队列，由工作线程取出后通过run()执行
+    virtual void enqueue(Task task) = 0;
+    void run(Task& task);
+
+private:
+    // 已提交但还没执行完的任务数
+    std::mutex pending_mutex_;
+    std::condition_variable pending_cv_;
+    size_t pending_ = 0;
+};
+
+// SerialQueue - 单个工作线程按提交顺序执行任务，模拟CUDA stream
+// 同一队列上的调用严格按顺序执行，调用方线程提交后即可继续做host端的分发工作
+class SerialQueue : public Executor {
+public:
+    explicit SerialQueue(std::string name);
+    ~SerialQueue() override;
+
+    SerialQueue(const SerialQueue&) = delete;
+    SerialQueue& operator=(const SerialQueue&) = delete;
+
+    std::string name() const override { return name_; }
+
+protected:
+    void enqueue(Task task) override;
+
+private:
+    void workerLoop();
+
+    std::string name_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    bool stopping_ = false;
+    std::thread worker_;
+};
+
+// ThreadPool - 工作窃取线程池，CPU backend的默认执行器
+// 每个工作线程有自己的双端队列：工作线程内部提交的任务压入自己队列的尾部并按LIFO取出（缓存局部性好），
+// 外部提交的任务轮流分配到各个队列；自己的队列为空时从其他队列的头部窃取
+// 注意：任务不按提交顺序执行；在任务内部阻塞等待同一线程池上的future可能死锁，应改用then()
+class ThreadPool : public Executor {
+public:
+    // num_threads为0时使用硬件线程数；cpu_affinity非空时第i个工作线程绑定到cpu_affinity[i % size]
+    explicit ThreadPool(size_t num_threads = 0, std::vector<int> cpu_affinity = {});
+    ~ThreadPool() override;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t numThreads() const { return workers_.size(); }
+    std::string name() const override;
+
+    // 当前线程在本线程池中的编号，不是本线程池的工作线程时返回-1
+    int currentWorkerIndex() const;
+
+protected:
+    void enqueue(Task task) override;
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void workerLoop(size_t index);
+    bool tryPop(size_t index, Task& task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<int> cpu_affinity_;
+    std::atomic<size_t> next_worker_{0};
+
+    // 所有队列中的任务总数，空闲的工作线程在wake_cv_上等待它变为非零
+    std::atomic<size_t> queued_{0};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool stopping_ = false;
+};
+
+} // namespace dispatcher
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "IValue.h"
+#include "Stack.h"
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace dispatcher {
+
+// FunctionSchema - 操作符的参数/返回值类型描述
+// 注册unboxed内核时从C++签名自动推导，OperatorHandle据此在调用入口一次性校验参数，
+// 之后内核可以跳过逐个参数的类型检查；tensor_arguments同时告诉computeDispatchKeySet哪些参数需要扫描
+struct FunctionSchema {
+    // 每个参数在packed_argument_tags中占用的位数，Tag的取值必须能放进这么多位
+    static constexpr size_t kTagBits = 4;
+    // 能打包进一个uint64_t的最大参数个数，超过时退化为逐个比较
+    static constexpr size_t kMaxPackedArguments = 64 / kTagBits;
+
+    std::vector<IValue::Tag> arguments;
+    std::vector<IValue::Tag> returns;
+
+    // 第i位为1表示第i个参数是Tensor或TensorList
+    uint64_t tensor_arguments = 0;
+
+    // 所有参数tag按位打包后的值，校验时把实际参数打包后做一次整数比较
+    uint64_t packed_argument_tags = 0;
+
+    FunctionSchema() = default;
+    FunctionSchema(std::vector<IValue::Tag> arguments, std::vector<IValue::Tag> returns);
+
+    // 检查栈上的参数是否与schema匹配（热路径，不分配内存）
+    bool matches(const Stack& stack) const {
+        if (stack.size() != arguments.size()) {
+            return false;
+        }
+        if (arguments.size() > kMaxPackedArguments) {
+            return matchesSlow(stack);
+        }
+        uint64_t packed = 0;
+        for (size_t i = 0; i < stack.size(); ++i) {
+            packed |= static_cast<uint64_t>(stack[i].tag()) << (i * kTagBits);
+        }
+        return packed == packed_argument_tags;
+    }
+
+    // 不匹配时抛出描述具体原因的异常，只在matches()失败后调用
+    [[noreturn]] void throwMismatch(const std::string& op_name, const Stack& stack) const;
+
+    // 格式化为 "(Tensor, Double) -> Tensor"
+    std::string toString() const;
+
+    bool operator==(const FunctionSchema& other) const {
+        return arguments == other.arguments && returns == other.returns;
+    }
+    bool operator!=(const FunctionSchema& other) const { return !(*this == other); }
+
+private:
+    bool matchesSlow(const Stack& stack) const;
+};
+
+// === 从C++类型推导schema ===
+
+// C++参数/返回值类型对应的IValue tag，只为IValue能表示的类型定义
+template<typename T>
+struct ivalue_tag_of;
+
+template<> struct ivalue_tag_of<Tensor> { static constexpr IValue::Tag value = IValue::Tag::Tensor; };
+template<> struct ivalue_tag_of<double> { static constexpr IValue::Tag value = IValue::Tag::Double; };
+template<> struct ivalue_tag_of<int64_t> { static constexpr IValue::Tag value = IValue::Tag::Int; };
+template<> struct ivalue_tag_of<bool> { static constexpr IValue::Tag value = IValue::Tag::Bool; };
+template<> struct ivalue_tag_of<std::string> { static constexpr IValue::Tag value = IValue::Tag::String; };
+template<> struct ivalue_tag_of<std::vector<int64_t>> { static constexpr IValue::Tag value = IValue::Tag::IntList; };
+template<> struct ivalue_tag_of<std::vector<double>> { static constexpr IValue::Tag value = IValue::Tag::DoubleList; };
+template<> struct ivalue_tag_of<std::vector<Tensor>> { static constexpr IValue::Tag value = IValue::Tag::TensorList; };
+
+template<typename T>
+constexpr IValue::Tag ivalue_tag_of_v = ivalue_tag_of<std::decay_t<T>>::value;
+
+// 根据返回类型和参数类型推导schema，void返回值对应空的returns
+template<typename R, typename ArgsTuple>
+struct infer_schema;
+
+template<typename R, typename... Args>
+struct infer_schema<R, std::tuple<Args...>> {
+    static FunctionSchema get() {
+        std::vector<IValue::Tag> returns;
+        if constexpr (!std::is_void_v<R>) {
+            returns.push_back(ivalue_tag_of_v<R>);
+        }
+        return FunctionSchema({ivalue_tag_of_v<Args>...}, std::move(returns));
+    }
+};
+
+} // namespace dispatcher
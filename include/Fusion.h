@@ -0,0 +1,40 @@
+#pragma once
+
+#include "ElementwiseKernels.h"
+#include "Graph.h"
+#include <memory>
+#include <string>
+
+namespace dispatcher {
+
+// === 逐元素融合 ===
+// 优化捕获的计算图：找出由逐元素操作符组成、中间结果只在内部使用一次的子图，
+// 每个子图替换为一个融合内核，节省中间tensor的分配和每个操作一次的完整内存遍历
+// 融合内核注册为Dispatcher中的合成操作符（fused_elementwise_N），和普通操作符一样出现在调试信息和统计中
+
+// 可融合操作符的逐元素语义
+struct ElementwiseOpInfo {
+    ElementwiseInstruction::Kind kind;
+    BinaryOp binary_op = BinaryOp::Add;
+    UnaryOp unary_op = UnaryOp::Neg;
+
+    static ElementwiseOpInfo binary(BinaryOp op) { return {ElementwiseInstruction::Kind::Binary, op, UnaryOp::Neg}; }
+    // (tensor, 标量)形式，标量必须是捕获时固定的常量
+    static ElementwiseOpInfo binaryScalar(BinaryOp op) {
+        return {ElementwiseInstruction::Kind::BinaryScalar, op, UnaryOp::Neg};
+    }
+    static ElementwiseOpInfo unary(UnaryOp op) { return {ElementwiseInstruction::Kind::Unary, BinaryOp::Add, op}; }
+};
+
+// 声明操作符的CPU内核等价于给定的逐元素运算，融合pass只会融合声明过的操作符
+void registerElementwiseOp(const std::string& op_name, ElementwiseOpInfo info);
+const ElementwiseOpInfo* findElementwiseOp(const std::string& op_name);
+
+// 融合pass：返回融合后的新图，原图不变；没有可融合的子图时返回等价的副本
+// 只融合在CPU上执行的节点；元素数是否一致在运行时由融合内核检查
+std::shared_ptr<const Graph> fuseElementwise(const Graph& graph);
+
+// 合成操作符对应的融合表达式，不是融合操作符时返回nullptr
+std::shared_ptr<const ElementwiseExpr> findFusedExpression(const std::string& op_name);
+
+} // namespace dispatcher
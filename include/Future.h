@@ -0,0 +1,95 @@
+#pragma once
+
+#include "IValue.h"
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define DISPATCHER_HAS_COROUTINES 1
+#else
+#define DISPATCHER_HAS_COROUTINES 0
+#endif
+
+namespace dispatcher {
+
+namespace detail {
+struct FutureState;
+} // namespace detail
+
+// DispatchFuture - 异步调用的结果
+// 与std::future类似，但额外支持完成回调（then），因此可以直接作为C++20协程的awaitable；
+// 结果只能被get()取走一次，内核抛出的异常在get()时重新抛出
+class DispatchFuture {
+public:
+    DispatchFuture() = default;
+
+    // 是否关联了一个异步调用
+    bool valid() const { return state_ != nullptr; }
+
+    // 结果是否已经就绪（不阻塞）
+    bool isReady() const;
+
+    // 阻塞直到结果就绪
+    void wait() const;
+
+    // 阻塞直到结果就绪并取走结果；调用失败时重新抛出内核的异常
+    IValueList get();
+
+    // 结果就绪后调用callback；已经就绪时在当前线程立即调用，否则在完成调用的线程上调用
+    // 回调中不应长时间阻塞，否则会拖住执行器的工作线程
+    void then(std::function<void()> callback);
+
+#if DISPATCHER_HAS_COROUTINES
+    // C++20协程接口：co_await future 挂起当前协程，结果就绪后在完成调用的线程上恢复
+    bool await_ready() const { return isReady(); }
+    void await_suspend(std::coroutine_handle<> handle) {
+        then([handle]() { handle.resume(); });
+    }
+    IValueList await_resume() { return get(); }
+#endif
+
+private:
+    friend class DispatchPromise;
+    explicit DispatchFuture(std::shared_ptr<detail::FutureState> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<detail::FutureState> state_;
+};
+
+// DispatchPromise - 异步调用的生产端，由执行调用的工作线程设置结果或异常
+class DispatchPromise {
+public:
+    DispatchPromise();
+
+    DispatchFuture getFuture() const { return DispatchFuture(state_); }
+
+    // 设置结果/异常并唤醒等待者，只能调用其中一个且只能调用一次
+    void setValue(IValueList value);
+    void setException(std::exception_ptr exception);
+
+private:
+    void complete(std::unique_lock<std::mutex>& lock);
+
+    std::shared_ptr<detail::FutureState> state_;
+};
+
+namespace detail {
+
+// promise和future共享的状态
+struct FutureState {
+    mutable std::mutex mutex;
+    mutable std::condition_variable ready_cv;
+    bool ready = false;
+    bool retrieved = false;
+    IValueList value;
+    std::exception_ptr exception;
+    std::vector<std::function<void()>> callbacks;
+};
+
+} // namespace detail
+
+} // namespace dispatcher
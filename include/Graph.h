@@ -0,0 +1,200 @@
+#pragma once
+
+#include "Arena.h"
+#include "ArrayRef.h"
+#include "DispatchKeySet.h"
+#include "IValue.h"
+#include "LocalDispatchKeySet.h"
+#include "OperatorHandle.h"
+#include "Stack.h"
+#include "TensorImpl.h"
+#include <array>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace dispatcher {
+
+// === 计算图IR ===
+// 通过Tracing key捕获的一串操作符调用；每个值用一个整数ID表示，节点按执行顺序排列
+// 节点和参数槽位在Graph自己的Arena中连续存放，回放时顺序扫描
+
+// 值的来源
+enum class GraphValueKind : uint8_t {
+    Input,       // 图的输入，index为输入序号
+    Constant,    // 捕获时记录的非tensor参数，index为常量序号
+    NodeOutput,  // 节点的输出，index为节点序号
+};
+
+struct GraphValue {
+    GraphValueKind kind;
+    uint32_t index;
+
+    // 捕获时观察到的tensor元信息，供内存规划等pass使用；非tensor值的backend为Undefined
+    DispatchKey backend = DispatchKey::Undefined;
+    std::vector<int64_t> sizes;
+
+    bool isTensor() const { return backend != DispatchKey::Undefined; }
+    size_t nbytes() const {
+        if (sizes.empty()) {
+            return 0;
+        }
+        size_t numel = 1;
+        for (int64_t size : sizes) {
+            numel *= static_cast<size_t>(size);
+        }
+        return numel * TensorImpl::kElementSize;
+    }
+};
+
+// GraphNode - 一次操作符调用
+// 内核在捕获时解析并复制到图中，回放时直接调用，不再查名称、计算key set或查表
+struct GraphNode {
+    const OperatorHandle* op;
+    const KernelFunction* kernel;  // 指向Graph拥有的内核副本
+    DispatchKeySet ks;             // 调用kernel时传入的key set（已屏蔽Tracing及更高优先级的key）
+    uint32_t inputs_begin;         // 参数在Graph::nodeInputs()中的起始位置
+    uint32_t num_inputs;
+    uint32_t first_output;         // 输出占用[first_output, first_output + num_outputs)的连续值ID
+    uint32_t num_outputs;
+    DispatchKey kernel_key;        // kernel所属的dispatch key（fallback为其所在的key），用于事件和延迟统计
+};
+
+class Graph;
+
+// 逐元素融合pass，见Fusion.h
+std::shared_ptr<const Graph> fuseElementwise(const Graph& graph);
+
+// Graph - 捕获完成后不可修改的计算图
+class Graph {
+public:
+    ArrayRef<GraphNode> nodes() const { return ArrayRef<GraphNode>(nodes_, num_nodes_); }
+
+    // 节点参数对应的值ID
+    ArrayRef<uint32_t> nodeInputs(const GraphNode& node) const {
+        return ArrayRef<uint32_t>(input_slots_ + node.inputs_begin, node.num_inputs);
+    }
+
+    size_t numValues() const { return values_.size(); }
+    const GraphValue& value(uint32_t id) const { return values_[id]; }
+
+    // 图的输入/输出值ID，输入按捕获时第一次出现的顺序排列
+    const std::vector<uint32_t>& inputs() const { return inputs_; }
+    const std::vector<uint32_t>& outputs() const { return outputs_; }
+
+    const std::vector<IValue>& constants() const { return constants_; }
+
+    // IR文本形式，例如 "%2 = add(%0, %1)  [CPU]"
+    std::string toString() const;
+
+private:
+    friend class GraphCapture;
+    friend std::shared_ptr<const Graph> fuseElementwise(const Graph& graph);
+
+    // 把节点和参数槽位复制到Arena中
+    void setNodes(const std::vector<GraphNode>& nodes, const std::vector<uint32_t>& input_slots);
+
+    Arena arena_;
+    GraphNode* nodes_ = nullptr;
+    uint32_t num_nodes_ = 0;
+    uint32_t* input_slots_ = nullptr;
+
+    std::vector<GraphValue> values_;
+    std::vector<uint32_t> inputs_;
+    std::vector<uint32_t> outputs_;
+    std::vector<IValue> constants_;
+
+    // 节点引用的内核副本，deque保证地址稳定
+    std::deque<KernelFunction> kernels_;
+};
+
+// GraphCapture - 在当前线程上捕获计算图的作用域
+// 构造时在当前线程打开Tracing key，作用域内的操作符调用经过Tracing层时被记录下来；
+// 不是由图中节点产生的tensor自动成为图的输入，非tensor参数成为常量
+// 只记录最外层的调用：内核内部再调用的操作符属于该内核的实现，不会重复记录
+// 没有注册Tracing fallback时，捕获期间自动安装traceCall作为fallback，最后一个捕获结束时移除；
+// 自行注册的Tracing fallback或Tracing内核需要调用traceCall，否则调用不会被记录
+class GraphCapture {
+public:
+    GraphCapture();
+    ~GraphCapture();
+
+    GraphCapture(const GraphCapture&) = delete;
+    GraphCapture& operator=(const GraphCapture&) = delete;
+
+    // 显式声明一个输入，用于固定输入顺序（否则按第一次使用的顺序）
+    void addInput(const Tensor& tensor);
+
+    // 结束捕获并生成计算图，outputs中的tensor必须是输入或图中节点的输出
+    std::shared_ptr<const Graph> finish(const IValueList& outputs);
+
+    // 当前线程是否正在捕获
+    static bool isCapturing();
+
+    // Tracing层使用：正在捕获时记录这次调用，然后重新分发到下一层
+    static void traceCall(const OperatorHandle& op, DispatchKeySet ks, Stack* stack);
+
+private:
+    uint32_t valueOf(const IValue& value);
+    uint32_t newValue(GraphValueKind kind, uint32_t index);
+    void setTensorInfo(uint32_t id, const Tensor& tensor);
+    void record(const OperatorHandle& op, DispatchKeySet ks, Stack* stack);
+
+    std::unique_ptr<Graph> graph_;
+    std::vector<GraphNode> nodes_;
+    std::vector<uint32_t> input_slots_;
+
+    // tensor -> 值ID；同时持有这些tensor，保证捕获期间地址不会被新tensor复用
+    std::unordered_map<const TensorImpl*, uint32_t> tensor_values_;
+    std::vector<Tensor> retained_tensors_;
+
+    GraphCapture* previous_;
+    LocalDispatchKeySet saved_local_;
+    bool finished_ = false;
+};
+
+struct MemoryPlan;
+class SlabAllocator;
+
+// GraphExecutor - 回放捕获的计算图
+// 按节点顺序把参数压栈、直接调用绑定的内核，跳过名称查找、key set计算和内核解析
+// 开启统计时每个节点照常计入调用次数和延迟采样；每个值在最后一次使用后立即释放
+// 值表和参数栈在多次运行之间复用；一个执行器不能被多个线程同时使用
+// 调用方需要保证图中的操作符在回放期间不被注销
+class GraphExecutor {
+public:
+    // plan_memory为true时按planMemory()的结果为每个backend（Meta除外）预先分配一个slab，
+    // 内核用make_output_tensor创建的中间结果直接放在规划好的位置上（见MemoryPlanner.h）；
+    // 内核不能在调用之外持有中间结果
+    explicit GraphExecutor(std::shared_ptr<const Graph> graph, bool plan_memory = false);
+    ~GraphExecutor();
+
+    // inputs与Graph::inputs()一一对应
+    IValueList run(const IValueList& inputs);
+
+    const Graph& graph() const { return *graph_; }
+
+    // 内存规划结果，没有启用时返回nullptr
+    const MemoryPlan* memoryPlan() const { return plan_.get(); }
+    const SlabAllocator* slab(DispatchKey backend) const { return slabs_[static_cast<size_t>(backend)].get(); }
+
+private:
+    std::shared_ptr<const Graph> graph_;
+    std::vector<IValue> values_;
+    Stack stack_;
+
+    // 每个节点执行完后可以释放的值（最后一次使用在该节点），按节点顺序拼接
+    std::vector<uint32_t> release_begin_;
+    std::vector<uint32_t> release_values_;
+
+    // 统计节点的结果实际放进规划区域的次数
+    void countPlannedOutputs(const OutputRegion* regions, uint32_t num_outputs);
+
+    std::unique_ptr<MemoryPlan> plan_;
+    std::array<std::unique_ptr<SlabAllocator>, static_cast<size_t>(DispatchKey::NumDispatchKeys)> slabs_;
+    std::vector<OutputRegion> output_regions_;  // 按值ID索引
+};
+
+} // namespace dispatcher
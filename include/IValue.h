@@ -1,9 +1,15 @@
 #pragma once
 
+#include "ArrayRef.h"
+#include "IntrusivePtr.h"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <vector>
-#include <variant>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 namespace dispatcher {
@@ -11,12 +17,39 @@ namespace dispatcher {
 // 前向声明
 class TensorImpl;
 
+// Tensor - 侵入式引用计数的TensorImpl句柄
+using Tensor = intrusive_ptr<TensorImpl>;
+
+namespace detail {
+
+// SharedPayload - 引用计数的不可变堆存储
+// 放不进内联缓冲区的字符串和列表存放在这里，IValue拷贝时只增加引用计数而不深拷贝
+template<typename T>
+struct SharedPayload {
+    template<typename... Args>
+    explicit SharedPayload(Args&&... args) : value(std::forward<Args>(args)...) {}
+    
+    mutable std::atomic<uint32_t> refcount{1};
+    const T value;
+    
+    void retain() const { refcount.fetch_add(1, std::memory_order_relaxed); }
+    void release() const {
+        if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+};
+
+} // namespace detail
+
 // IValue - 实现boxing/unboxing机制
 // 允许将任意类型的值包装成统一的IValue类型，用于boxed calling convention
+// Tensor句柄（一个指针大小）、标量、短字符串和小的int列表（例如sizes）都内联存储在payload中，
+// 构造和拷贝这些值不需要堆分配
 class IValue {
 public:
     // 支持的基本类型枚举
-    enum class Tag {
+    enum class Tag : uint8_t {
         None,
         Tensor,
         Double,
@@ -27,26 +60,33 @@ public:
         DoubleList,
         TensorList
     };
+    
+    // 内联缓冲区容量
+    static constexpr size_t kInlineStringCapacity = 31;
+    static constexpr size_t kInlineIntListCapacity = 4;
 
     // 构造函数 - 默认构造为None类型
     IValue() : tag_(Tag::None) {}
     
     // 构造函数 - 从tensor构造
-    explicit IValue(std::shared_ptr<TensorImpl> tensor);
+    explicit IValue(Tensor tensor);
     
     // 构造函数 - 从基本类型构造
     explicit IValue(double value);
     explicit IValue(int64_t value);
     explicit IValue(bool value);
-    explicit IValue(std::string value);
+    explicit IValue(const std::string& value);
+    explicit IValue(std::string&& value);
     explicit IValue(const char* value);
     
     // 构造函数 - 从列表类型构造
-    explicit IValue(std::vector<int64_t> value);
+    explicit IValue(const std::vector<int64_t>& value);
+    explicit IValue(std::vector<int64_t>&& value);
+    explicit IValue(IntArrayRef value);
     explicit IValue(std::vector<double> value);
-    explicit IValue(std::vector<std::shared_ptr<TensorImpl>> value);
+    explicit IValue(std::vector<Tensor> value);
     
-    // 拷贝构造和赋值
+    // 拷贝构造和赋值 - 内联值按值拷贝，堆上的值共享引用计数存储
     IValue(const IValue& other);
     IValue& operator=(const IValue& other);
     
@@ -69,39 +109,88 @@ public:
     bool isTensorList() const { return tag_ == Tag::TensorList; }
     
     // 类型转换函数 - 这些函数在类型不匹配时会抛出异常
-    std::shared_ptr<TensorImpl> toTensor() const;
+    Tensor toTensor() const;
     double toDouble() const;
     int64_t toInt() const;
     bool toBool() const;
     std::string toString() const;
     std::vector<int64_t> toIntList() const;
     std::vector<double> toDoubleList() const;
-    std::vector<std::shared_ptr<TensorImpl>> toTensorList() const;
+    std::vector<Tensor> toTensorList() const;
+    
+    // 零拷贝访问 - 返回指向IValue内部存储的引用或视图，生命周期不超过该IValue
+    const Tensor& toTensorRef() const;
+    std::string_view toStringView() const;
+    IntArrayRef toIntListRef() const;
+    ArrayRef<double> toDoubleListRef() const;
+    ArrayRef<Tensor> toTensorListRef() const;
+    
+    // 不检查类型的访问 - 调用方必须已经确认过tag（例如操作符入口已按schema校验过参数）
+    // 返回的引用指向IValue内部存储
+    const Tensor& toTensorRefUnchecked() const { return payload_.as_tensor; }
+    const double& toDoubleUnchecked() const { return payload_.as_double; }
+    const int64_t& toIntUnchecked() const { return payload_.as_int; }
+    const bool& toBoolUnchecked() const { return payload_.as_bool; }
+    
+    // 遍历该IValue中包含的所有tensor（Tensor或TensorList），非tensor值不做任何事
+    // 直接读取内部存储，不做类型检查的异常路径，也不拷贝句柄，供dispatch key计算的热路径使用
+    template<typename F>
+    void forEachTensor(F&& fn) const {
+        if (tag_ == Tag::Tensor) {
+            fn(payload_.as_tensor);
+        } else if (tag_ == Tag::TensorList) {
+            for (const Tensor& tensor : payload_.as_tensor_list->value) {
+                fn(tensor);
+            }
+        }
+    }
     
     // 获取tag
     Tag tag() const { return tag_; }
     
+    // tag的名称，如 "Tensor"、"Double"
+    static const char* tagName(Tag tag);
+    
     // 调试用字符串表示
     std::string debugString() const;
 
 private:
     Tag tag_;
     
+    // 值是否内联存储在payload中（String和IntList才会用到）
+    bool is_inline_ = false;
+    
+    // 内联字符串或int列表的长度
+    uint8_t inline_size_ = 0;
+    
     // 使用union来存储不同类型的数据，节省内存
     union Payload {
-        std::shared_ptr<TensorImpl>* tensor;
+        Tensor as_tensor;
         double as_double;
         int64_t as_int;
         bool as_bool;
-        std::string* as_string;
-        std::vector<int64_t>* as_int_list;
-        std::vector<double>* as_double_list;
-        std::vector<std::shared_ptr<TensorImpl>>* as_tensor_list;
+        char inline_chars[kInlineStringCapacity + 1];
+        int64_t inline_ints[kInlineIntListCapacity];
+        const detail::SharedPayload<std::string>* as_string;
+        const detail::SharedPayload<std::vector<int64_t>>* as_int_list;
+        const detail::SharedPayload<std::vector<double>>* as_double_list;
+        const detail::SharedPayload<std::vector<Tensor>>* as_tensor_list;
         
         Payload() {}
         ~Payload() {}
     } payload_;
     
+    // 内部辅助函数 - 从另一个IValue拷贝/移动payload（当前对象必须没有持有资源）
+    void copyFrom(const IValue& other);
+    void moveFrom(IValue& other) noexcept;
+    void copyPayloadBits(const IValue& other) noexcept {
+        std::memcpy(static_cast<void*>(&payload_), static_cast<const void*>(&other.payload_), sizeof(Payload));
+    }
+    
+    // 内部辅助函数 - 内联存储字符串/int列表，放不下时使用共享堆存储
+    void initString(std::string_view value);
+    void initIntList(const int64_t* data, size_t size);
+    
     // 内部辅助函数 - 清理payload中的数据
     void destroy();
 };
@@ -115,4 +204,4 @@ IValue make_ivalue(T&& value) {
 // IValue列表类型，用于函数参数和返回值
 using IValueList = std::vector<IValue>;
 
-} // namespace dispatcher 
\ No newline at end of file
+} // namespace dispatcher
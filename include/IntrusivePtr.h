@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace dispatcher {
+
+// intrusive_ptr_target - 侵入式引用计数的基类
+// 引用计数直接嵌在对象内部，不需要像std::shared_ptr那样额外分配控制块
+class intrusive_ptr_target {
+public:
+    // 当前引用计数，仅用于调试
+    uint32_t use_count() const { return refcount_.load(std::memory_order_relaxed); }
+
+protected:
+    intrusive_ptr_target() = default;
+    virtual ~intrusive_ptr_target() = default;
+    
+    // 拷贝对象时不拷贝引用计数
+    intrusive_ptr_target(const intrusive_ptr_target&) {}
+    intrusive_ptr_target& operator=(const intrusive_ptr_target&) { return *this; }
+
+private:
+    template<typename T>
+    friend class intrusive_ptr;
+    
+    void retain() const { refcount_.fetch_add(1, std::memory_order_relaxed); }
+    void release() const {
+        if (refcount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+    
+    mutable std::atomic<uint32_t> refcount_{0};
+};
+
+// intrusive_ptr - 指向intrusive_ptr_target子类的强引用句柄，大小与裸指针相同
+// 注意：拷贝/析构需要T是完整类型
+template<typename T>
+class intrusive_ptr {
+public:
+    using element_type = T;
+    
+    constexpr intrusive_ptr() noexcept = default;
+    constexpr intrusive_ptr(std::nullptr_t) noexcept {}
+    
+    // 从裸指针构造，持有一个新的引用
+    explicit intrusive_ptr(T* target) : target_(target) {
+        if (target_) {
+            target_->retain();
+        }
+    }
+    
+    intrusive_ptr(const intrusive_ptr& other) : target_(other.target_) {
+        if (target_) {
+            target_->retain();
+        }
+    }
+    
+    intrusive_ptr(intrusive_ptr&& other) noexcept : target_(other.target_) {
+        other.target_ = nullptr;
+    }
+    
+    // 子类指针到基类指针的转换
+    template<typename U, typename = std::enable_if_t<std::is_convertible<U*, T*>::value>>
+    intrusive_ptr(const intrusive_ptr<U>& other) : intrusive_ptr(other.get()) {}
+    
+    ~intrusive_ptr() { reset(); }
+    
+    intrusive_ptr& operator=(const intrusive_ptr& other) {
+        intrusive_ptr(other).swap(*this);
+        return *this;
+    }
+    
+    intrusive_ptr& operator=(intrusive_ptr&& other) noexcept {
+        intrusive_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+    
+    void reset() {
+        if (target_) {
+            target_->release();
+            target_ = nullptr;
+        }
+    }
+    
+    void swap(intrusive_ptr& other) noexcept { std::swap(target_, other.target_); }
+    
+    T* get() const noexcept { return target_; }
+    T& operator*() const noexcept { return *target_; }
+    T* operator->() const noexcept { return target_; }
+    explicit operator bool() const noexcept { return target_ != nullptr; }
+    
+    uint32_t use_count() const { return target_ ? target_->use_count() : 0; }
+    
+    bool operator==(const intrusive_ptr& other) const { return target_ == other.target_; }
+    bool operator!=(const intrusive_ptr& other) const { return target_ != other.target_; }
+    bool operator==(std::nullptr_t) const { return target_ == nullptr; }
+    bool operator!=(std::nullptr_t) const { return target_ != nullptr; }
+
+private:
+    T* target_ = nullptr;
+};
+
+// 工厂函数 - 对象和引用计数在同一次分配中创建
+template<typename T, typename... Args>
+intrusive_ptr<T> make_intrusive(Args&&... args) {
+    return intrusive_ptr<T>(new T(std::forward<Args>(args)...));
+}
+
+} // namespace dispatcher
+
+namespace std {
+template<typename T>
+struct hash<dispatcher::intrusive_ptr<T>> {
+    size_t operator()(const dispatcher::intrusive_ptr<T>& ptr) const {
+        return hash<T*>()(ptr.get());
+    }
+};
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace dispatcher {
+
+// 延迟直方图的桶布局 - HDR风格的对数-线性分桶
+// 小于kSubBuckets纳秒的值每纳秒一个桶；之后每个2的幂区间再均分为kSubBuckets个子桶，
+// 相对误差不超过1/kSubBuckets，覆盖到约2^40纳秒（约18分钟），更大的值落在最后一个桶
+struct LatencyBuckets {
+    static constexpr uint32_t kSubBucketBits = 3;
+    static constexpr uint32_t kSubBuckets = 1u << kSubBucketBits;
+    static constexpr uint32_t kMaxExponent = 40;
+    static constexpr size_t kNumBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+    
+    // 纳秒值 -> 桶索引
+    static constexpr size_t indexOf(uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<size_t>(ns);
+        }
+        uint32_t exponent = static_cast<uint32_t>(63 - __builtin_clzll(ns));
+        if (exponent > kMaxExponent) {
+            return kNumBuckets - 1;
+        }
+        uint64_t sub = (ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return (exponent - kSubBucketBits + 1) * kSubBuckets + static_cast<size_t>(sub);
+    }
+    
+    // 桶索引 -> 该桶覆盖的最大纳秒值
+    static constexpr uint64_t upperBoundOf(size_t index) {
+        if (index < kSubBuckets) {
+            return index;
+        }
+        uint32_t exponent = static_cast<uint32_t>(index / kSubBuckets) + kSubBucketBits - 1;
+        uint64_t sub = index % kSubBuckets;
+        uint64_t width = uint64_t(1) << (exponent - kSubBucketBits);
+        return (uint64_t(1) << exponent) + (sub + 1) * width - 1;
+    }
+};
+
+// LatencyHistogram - 延迟分布的快照，可以合并，并支持分位数查询
+class LatencyHistogram {
+public:
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    
+    uint64_t count() const { return count_; }
+    uint64_t totalNanos() const { return total_ns_; }
+    uint64_t maxNanos() const { return max_ns_; }
+    double meanNanos() const { return count_ ? static_cast<double>(total_ns_) / count_ : 0.0; }
+    
+    // 分位数查询，q取值[0, 1]，返回所在桶的上界（纳秒）
+    uint64_t percentile(double q) const;
+    uint64_t p50() const { return percentile(0.50); }
+    uint64_t p99() const { return percentile(0.99); }
+    uint64_t p999() const { return percentile(0.999); }
+    
+    // 调试用字符串表示
+    std::string toString() const;
+
+private:
+    friend class AtomicLatencyHistogram;
+    
+    std::array<uint64_t, LatencyBuckets::kNumBuckets> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t total_ns_ = 0;
+    uint64_t max_ns_ = 0;
+};
+
+// AtomicLatencyHistogram - 供单个写线程以relaxed原子操作记录、其他线程随时读取的版本
+class AtomicLatencyHistogram {
+public:
+    void record(uint64_t ns);
+    
+    // 把当前内容累加到快照中
+    void mergeInto(LatencyHistogram& snapshot) const;
+    
+    void reset();
+
+private:
+    std::array<std::atomic<uint64_t>, LatencyBuckets::kNumBuckets> buckets_{};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> total_ns_{0};
+    std::atomic<uint64_t> max_ns_{0};
+};
+
+} // namespace dispatcher
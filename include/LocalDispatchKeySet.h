@@ -0,0 +1,69 @@
+#pragma once
+
+#include "DispatchKey.h"
+#include "DispatchKeySet.h"
+
+namespace dispatcher {
+
+// LocalDispatchKeySet - 线程局部的dispatch key包含/排除集合
+// 计算dispatch key set时先OR上included，再屏蔽excluded，只需两次位运算
+// 与GlobalDispatchState不同，这里的修改只影响当前线程，适合功能性包装器和单个请求内的模式切换
+struct LocalDispatchKeySet {
+    DispatchKeySet included;  // 额外加入的key（例如当前线程开启tracing模式）
+    DispatchKeySet excluded;  // 需要屏蔽的key（例如包装器重新分发时屏蔽自身）
+
+    // 把线程局部状态应用到计算出的key set上
+    constexpr DispatchKeySet apply(DispatchKeySet ks) const {
+        return (ks | included) - excluded;
+    }
+};
+
+namespace detail {
+// 常量初始化的thread_local，访问时没有初始化检查
+inline thread_local LocalDispatchKeySet tls_local_dispatch_key_set;
+} // namespace detail
+
+// 获取当前线程的包含/排除集合
+inline LocalDispatchKeySet& localDispatchKeySet() {
+    return detail::tls_local_dispatch_key_set;
+}
+
+// IncludeDispatchKeyGuard - 在作用域内把指定key加入当前线程的included集合
+// 析构时恢复进入作用域前的状态，支持嵌套
+class IncludeDispatchKeyGuard {
+public:
+    explicit IncludeDispatchKeyGuard(DispatchKeySet keys)
+        : saved_(localDispatchKeySet().included) {
+        localDispatchKeySet().included |= keys;
+    }
+    explicit IncludeDispatchKeyGuard(DispatchKey key) : IncludeDispatchKeyGuard(DispatchKeySet(key)) {}
+
+    ~IncludeDispatchKeyGuard() { localDispatchKeySet().included = saved_; }
+
+    IncludeDispatchKeyGuard(const IncludeDispatchKeyGuard&) = delete;
+    IncludeDispatchKeyGuard& operator=(const IncludeDispatchKeyGuard&) = delete;
+
+private:
+    DispatchKeySet saved_;
+};
+
+// ExcludeDispatchKeyGuard - 在作用域内把指定key加入当前线程的excluded集合
+// 功能性包装器用它屏蔽自身的key，重新分发时不会再回到自己
+class ExcludeDispatchKeyGuard {
+public:
+    explicit ExcludeDispatchKeyGuard(DispatchKeySet keys)
+        : saved_(localDispatchKeySet().excluded) {
+        localDispatchKeySet().excluded |= keys;
+    }
+    explicit ExcludeDispatchKeyGuard(DispatchKey key) : ExcludeDispatchKeyGuard(DispatchKeySet(key)) {}
+
+    ~ExcludeDispatchKeyGuard() { localDispatchKeySet().excluded = saved_; }
+
+    ExcludeDispatchKeyGuard(const ExcludeDispatchKeyGuard&) = delete;
+    ExcludeDispatchKeyGuard& operator=(const ExcludeDispatchKeyGuard&) = delete;
+
+private:
+    DispatchKeySet saved_;
+};
+
+} // namespace dispatcher
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Allocator.h"
+#include "Storage.h"
+#include "DispatchKey.h"
+#include "Graph.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dispatcher {
+
+// === 计算图的静态内存规划 ===
+// 捕获的计算图形状固定、每个中间结果的生命周期（产生它的节点到最后一个使用它的节点）已知，
+// 因此可以在运行前给每个中间结果分配一个偏移，让生命周期不重叠的中间结果共用同一段内存；
+// 每个backend一个预先分配的内存块（slab），回放时中间结果不再经过分配器
+// 在Meta tensor上捕获的图同样可以规划，得到的Meta一行就是同一模型在真实backend上的内存峰值估计
+
+// MemoryPlan - 规划结果
+struct MemoryPlan {
+    static constexpr size_t kNumBackends = static_cast<size_t>(DispatchKey::NumDispatchKeys);
+
+    struct Assignment {
+        DispatchKey backend;
+        size_t offset;   // 在该backend的slab中的偏移，按kAllocatorAlignment对齐
+        size_t nbytes;   // 中间结果的实际字节数
+        bool in_place;   // 与这个节点的某个输入共用内存（该输入在此节点之后不再使用）
+    };
+
+    // 按值ID索引到assignments；不参与规划的值（图的输入/输出、常量、非tensor）为-1
+    std::vector<int32_t> by_value;
+    std::vector<Assignment> assignments;
+
+    // 每个backend规划后的slab大小（即规划后的峰值）和逐个分配时的总字节数
+    std::array<size_t, kNumBackends> planned_bytes{};
+    std::array<size_t, kNumBackends> naive_bytes{};
+    size_t num_in_place = 0;
+
+    const Assignment* find(uint32_t value) const {
+        return value < by_value.size() && by_value[value] >= 0 ? &assignments[by_value[value]] : nullptr;
+    }
+
+    // 每个backend一行，例如 "CPU: planned=8192B, naive=12288B (3 values, 1 in-place)"
+    std::string toString() const;
+};
+
+// 规划图中所有中间结果的内存：贪心best-fit区间装箱，按大小从大到小依次放入
+// 与其生命周期重叠的已放置区间之间最小的可用空隙；逐元素节点（见Fusion.h）的输出
+// 在其某个输入恰好在此节点死亡且大小相同时直接复用该输入的内存（原地执行）
+// 视图操作符（见TensorViews.h）的输出不参与规划，被引用的值的生命周期延长到其所有视图的最后一次使用
+MemoryPlan planMemory(const Graph& graph);
+
+// SlabAllocator - 持有一个backend的slab，把其中预先规划的区域交给节点的输出
+// GraphExecutor执行节点前用OutputRegionGuard登记这个节点每个输出的区域（见Storage.h），
+// 只有内核通过make_output_tensor创建的结果会放进区域，内核内部的临时tensor照常向backend的分配器申请；
+// 大小与规划不符的结果同样直接使用backend的分配器，不经过本对象
+// slab中的Storage不拥有内存，slab随本对象一起释放：内核不能在调用之外持有中间结果
+class SlabAllocator {
+public:
+    SlabAllocator(DispatchKey backend, size_t nbytes);
+    ~SlabAllocator();
+
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    // slab中[offset, offset + nbytes)处的区域
+    OutputRegion region(size_t offset, size_t nbytes) const;
+
+    // 结果确实放进了规划区域的次数
+    void recordHit() { ++num_hits_; }
+    size_t numHits() const { return num_hits_; }
+
+    DispatchKey backend() const { return backend_; }
+    size_t slabBytes() const { return slab_bytes_; }
+
+private:
+    DispatchKey backend_;
+    Allocator* allocator_;  // 全局的backend分配器，slab从它申请
+    char* slab_ = nullptr;
+    size_t slab_bytes_;
+    size_t num_hits_ = 0;
+};
+
+} // namespace dispatcher
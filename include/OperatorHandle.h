@@ -3,8 +3,15 @@
 #include "DispatchKey.h"
 #include "DispatchKeySet.h"
 #include "IValue.h"
+#include "Stack.h"
+#include "FunctionSchema.h"
+#include "TensorImpl.h"
+#include "Epoch.h"
+#include "EventRecorder.h"
+#include <array>
+#include <atomic>
 #include <functional>
-#include <unordered_map>
+#include <mutex>
 #include <string>
 #include <memory>
 #include <type_traits>
@@ -13,14 +20,11 @@
 
 namespace dispatcher {
 
-// 前向声明
-class TensorImpl;
+class OperatorHandle;
+struct StaticKernelEntry;
 
 // === Boxing/Unboxing 类型萃取系统 ===
 
-// 类型别名 - 简化 Tensor 类型
-using Tensor = std::shared_ptr<TensorImpl>;
-
 // 类型萃取 - 将 C++ 类型转换为 IValue
 template<typename T>
 struct arg_to_ivalue {
@@ -38,9 +42,12 @@ struct arg_to_ivalue<Tensor> {
 };
 
 // 类型萃取 - 从 IValue 提取 C++ 类型
+// convert() 检查tag，类型不匹配时抛出异常；
+// unchecked() 假定tag已经按schema校验过，供unboxed内核的boxed入口使用
 template<typename T>
 struct ivalue_to_arg {
     static T convert(const IValue& ivalue);
+    static T unchecked(const IValue& ivalue);
 };
 
 // 特化 - Tensor 类型
@@ -52,21 +59,22 @@ struct ivalue_to_arg<Tensor> {
         }
         return ivalue.toTensor();
     }
+    
+    static Tensor unchecked(const IValue& ivalue) { return ivalue.toTensorRefUnchecked(); }
 };
 
 // 特化 - const Tensor& 类型
+// 借用IValue内联存储的句柄：返回的引用在内核调用期间有效，没有引用计数操作
 template<>
 struct ivalue_to_arg<const Tensor&> {
     static const Tensor& convert(const IValue& ivalue) {
         if (!ivalue.isTensor()) {
             throw std::runtime_error("Expected Tensor type");
         }
-        // 注意：这里返回临时对象的引用是不安全的，但为了演示简化处理
-        // 在实际实现中需要更复杂的生命周期管理
-        static thread_local Tensor temp_tensor;
-        temp_tensor = ivalue.toTensor();
-        return temp_tensor;
+        return ivalue.toTensorRef();
     }
+    
+    static const Tensor& unchecked(const IValue& ivalue) { return ivalue.toTensorRefUnchecked(); }
 };
 
 // 特化 - Tensor& 类型
@@ -80,6 +88,12 @@ struct ivalue_to_arg<Tensor&> {
         temp_tensor = ivalue.toTensor();
         return temp_tensor;
     }
+    
+    static Tensor& unchecked(const IValue& ivalue) {
+        static thread_local Tensor temp_tensor;
+        temp_tensor = ivalue.toTensorRefUnchecked();
+        return temp_tensor;
+    }
 };
 
 // 特化 - double 类型
@@ -91,6 +105,8 @@ struct ivalue_to_arg<double> {
         }
         return ivalue.toDouble();
     }
+    
+    static double unchecked(const IValue& ivalue) { return ivalue.toDoubleUnchecked(); }
 };
 
 // 特化 - const double& 类型
@@ -104,6 +120,9 @@ struct ivalue_to_arg<const double&> {
         temp_double = ivalue.toDouble();
         return temp_double;
     }
+    
+    // 直接引用IValue内部存储，多个同类型参数不会共用同一个临时变量
+    static const double& unchecked(const IValue& ivalue) { return ivalue.toDoubleUnchecked(); }
 };
 
 // 特化 - int64_t 类型
@@ -115,6 +134,8 @@ struct ivalue_to_arg<int64_t> {
         }
         return ivalue.toInt();
     }
+    
+    static int64_t unchecked(const IValue& ivalue) { return ivalue.toIntUnchecked(); }
 };
 
 // 特化 - const int64_t& 类型
@@ -128,6 +149,8 @@ struct ivalue_to_arg<const int64_t&> {
         temp_int = ivalue.toInt();
         return temp_int;
     }
+    
+    static const int64_t& unchecked(const IValue& ivalue) { return ivalue.toIntUnchecked(); }
 };
 
 // 特化 - bool 类型
@@ -139,6 +162,8 @@ struct ivalue_to_arg<bool> {
         }
         return ivalue.toBool();
     }
+    
+    static bool unchecked(const IValue& ivalue) { return ivalue.toBoolUnchecked(); }
 };
 
 // 特化 - const bool& 类型
@@ -152,6 +177,21 @@ struct ivalue_to_arg<const bool&> {
         temp_bool = ivalue.toBool();
         return temp_bool;
     }
+    
+    static const bool& unchecked(const IValue& ivalue) { return ivalue.toBoolUnchecked(); }
+};
+
+// 特化 - std::vector<int64_t> 类型（形状等整数列表），按值复制出来
+template<>
+struct ivalue_to_arg<std::vector<int64_t>> {
+    static std::vector<int64_t> convert(const IValue& ivalue) {
+        if (!ivalue.isIntList()) {
+            throw std::runtime_error("Expected IntList type");
+        }
+        return ivalue.toIntList();
+    }
+    
+    static std::vector<int64_t> unchecked(const IValue& ivalue) { return ivalue.toIntList(); }
 };
 
 // 函数类型萃取 - 提取函数签名信息
@@ -232,44 +272,169 @@ struct is_boxed_function<std::function<IValueList(const IValueList&)>> {
 template<typename F>
 constexpr bool is_boxed_function_v = is_boxed_function<F>::value;
 
+// 检测是否是带dispatch上下文的 boxed 函数类型：
+// IValueList(const OperatorHandle&, DispatchKeySet, const IValueList&)
+template<typename F>
+struct is_boxed_function_with_context {
+    static constexpr bool value = false;
+};
+
+template<>
+struct is_boxed_function_with_context<IValueList(*)(const OperatorHandle&, DispatchKeySet, const IValueList&)> {
+    static constexpr bool value = true;
+};
+
+template<>
+struct is_boxed_function_with_context<IValueList(&)(const OperatorHandle&, DispatchKeySet, const IValueList&)> {
+    static constexpr bool value = true;
+};
+
+template<>
+struct is_boxed_function_with_context<std::function<IValueList(const OperatorHandle&, DispatchKeySet, const IValueList&)>> {
+    static constexpr bool value = true;
+};
+
+template<typename F>
+constexpr bool is_boxed_function_with_context_v = is_boxed_function_with_context<F>::value;
+
+// 检测是否是基于栈的 boxed 函数类型（内部调用约定）：
+// void(const OperatorHandle&, DispatchKeySet, Stack*)
+template<typename F>
+struct is_stack_boxed_function {
+    static constexpr bool value = false;
+};
+
+template<>
+struct is_stack_boxed_function<void(*)(const OperatorHandle&, DispatchKeySet, Stack*)> {
+    static constexpr bool value = true;
+};
+
+template<>
+struct is_stack_boxed_function<void(&)(const OperatorHandle&, DispatchKeySet, Stack*)> {
+    static constexpr bool value = true;
+};
+
+template<>
+struct is_stack_boxed_function<std::function<void(const OperatorHandle&, DispatchKeySet, Stack*)>> {
+    static constexpr bool value = true;
+};
+
+template<typename F>
+constexpr bool is_stack_boxed_function_v = is_stack_boxed_function<F>::value;
+
+// 检测unboxed内核是否以 (const OperatorHandle&, DispatchKeySet) 作为前两个参数
+// 这样的内核可以直接通过句柄重新分发；dispatch上下文不属于操作符的对外签名
+template<typename ArgsTuple>
+struct strip_dispatch_context {
+    static constexpr bool value = false;
+    using type = ArgsTuple;
+};
+
+template<typename... Rest>
+struct strip_dispatch_context<std::tuple<const OperatorHandle&, DispatchKeySet, Rest...>> {
+    static constexpr bool value = true;
+    using type = std::tuple<Rest...>;
+};
+
 // === Boxing/Unboxing 辅助函数 ===
 
-// 静态函数 - 包装返回值
+// 静态函数 - 把返回值压入栈
 template<typename R>
-IValueList wrapReturn(R&& result) {
-    if constexpr (std::is_void_v<std::decay_t<R>>) {
-        return {};
-    } else {
-        return {arg_to_ivalue<std::decay_t<R>>::convert(std::forward<R>(result))};
-    }
+void pushReturn(Stack* stack, R&& result) {
+    stack->push_back(arg_to_ivalue<std::decay_t<R>>::convert(std::forward<R>(result)));
 }
 
-// 静态函数 - 调用 unboxed 函数并包装返回值
-template<typename Func, size_t... Is>
-IValueList callUnboxedImpl(Func&& func, const IValueList& args, std::index_sequence<Is...>) {
-    using traits = function_traits<std::decay_t<Func>>;
-    using return_type = typename traits::return_type;
+// === Unboxed 直接调用支持 ===
+
+// 签名标识 - 每个C++函数类型对应一个唯一地址，用于在运行时比较unboxed内核的签名
+template<typename Sig>
+struct SignatureId {
+    static constexpr char tag = 0;
+};
+
+template<typename Sig>
+constexpr const void* signatureId() {
+    return &SignatureId<Sig>::tag;
+}
+
+// Unboxed跳板函数 - 把类型擦除的functor指针还原为具体类型并直接调用
+// 所有跳板都接受dispatch上下文，不需要上下文的内核直接忽略它
+template<typename Functor, typename R, typename ArgsTuple, bool WithContext>
+struct UnboxedTrampoline;
+
+template<typename Functor, typename R, typename... Args>
+struct UnboxedTrampoline<Functor, R, std::tuple<Args...>, false> {
+    using Signature = R(Args...);
+    using return_type = R;
+    using arg_types = std::tuple<Args...>;
+    static constexpr size_t arity = sizeof...(Args);
+    
+    static R call(const void* functor, const OperatorHandle&, DispatchKeySet, Args... args) {
+        return (*static_cast<const Functor*>(functor))(std::forward<Args>(args)...);
+    }
+};
+
+template<typename Functor, typename R, typename... Args>
+struct UnboxedTrampoline<Functor, R, std::tuple<Args...>, true> {
+    using Signature = R(Args...);
+    using return_type = R;
+    using arg_types = std::tuple<Args...>;
+    static constexpr size_t arity = sizeof...(Args);
+    
+    static R call(const void* functor, const OperatorHandle& op, DispatchKeySet ks, Args... args) {
+        return (*static_cast<const Functor*>(functor))(op, ks, std::forward<Args>(args)...);
+    }
+};
+
+// 根据functor的参数列表选择对应的跳板
+template<typename Functor>
+using UnboxedTrampolineFor = UnboxedTrampoline<
+    Functor,
+    typename function_traits<Functor>::return_type,
+    typename strip_dispatch_context<typename function_traits<Functor>::arg_types>::type,
+    strip_dispatch_context<typename function_traits<Functor>::arg_types>::value>;
+
+// 静态函数 - 通过跳板调用 unboxed 函数，参数从栈上读取，结果原地压回栈上
+// 调用方必须已经按内核的schema校验过栈上的参数，这里不再逐个检查类型
+// 引用类型的参数直接借用栈上的IValue，所以必须在调用结束后才能弹出参数
+template<typename Trampoline, size_t... Is>
+void callUnboxedImpl(const void* functor, const OperatorHandle& op, DispatchKeySet ks,
+                     Stack* stack, std::index_sequence<Is...>) {
+    using return_type = typename Trampoline::return_type;
+    using arg_types = typename Trampoline::arg_types;
     
-    // 从IValue列表中提取每个参数，转换为正确的C++类型，然后调用函数
+    // 从栈中提取每个参数，转换为正确的C++类型，然后调用函数
     if constexpr (std::is_void_v<return_type>) {
         // void 返回类型
-        func(ivalue_to_arg<typename traits::template arg_type<Is>>::convert(args[Is])...);
-        return {};
+        Trampoline::call(functor, op, ks, ivalue_to_arg<std::tuple_element_t<Is, arg_types>>::unchecked((*stack)[Is])...);
+        stack->clear();
     } else {
         // 有返回值的类型
-        auto result = func(ivalue_to_arg<typename traits::template arg_type<Is>>::convert(args[Is])...);
-        return wrapReturn(std::move(result));
+        auto result = Trampoline::call(functor, op, ks, ivalue_to_arg<std::tuple_element_t<Is, arg_types>>::unchecked((*stack)[Is])...);
+        stack->clear();
+        pushReturn(stack, std::move(result));
     }
 }
 
 // === KernelFunction 和相关类型定义 ===
 
 // 函数指针类型定义
-// Boxed函数：接受和返回IValue列表
-using BoxedKernelFunction = std::function<IValueList(const IValueList&)>;
+// Boxed函数：接受dispatch上下文（当前操作符句柄和本次分发使用的key set），
+// 从栈上弹出参数并把结果原地压回栈上，见Stack.h
+using BoxedKernelFunction = std::function<void(const OperatorHandle&, DispatchKeySet, Stack*)>;
 
-// Unboxed函数：直接的C++函数类型（这里简化为void*，实际中需要模板特化）
-using UnboxedKernelFunction = void*;
+// 返回IValue列表的boxed函数，注册时会被适配为BoxedKernelFunction
+using ListBoxedKernelFunction = std::function<IValueList(const OperatorHandle&, DispatchKeySet, const IValueList&)>;
+using SimpleBoxedKernelFunction = std::function<IValueList(const IValueList&)>;
+
+// Unboxed函数：类型擦除后的跳板函数指针，
+// 实际类型为 R(*)(const void* functor, const OperatorHandle&, DispatchKeySet, Args...)，
+// 只有在签名标识匹配时才会被转换回具体类型调用
+using UnboxedKernelFunction = void (*)();
+
+// 批量函数：一次处理count个相互独立的调用，stacks[i]上是第i次调用的参数，返回时替换为它的结果
+// 同一批调用使用同一个dispatch key set，内核可以借此在整批数据上做向量化
+using BatchedKernelFunction = std::function<void(const OperatorHandle&, DispatchKeySet, Stack* stacks, size_t count)>;
 
 // KernelFunction - 封装boxed和unboxed函数
 class KernelFunction {
@@ -281,54 +446,211 @@ public:
     explicit KernelFunction(BoxedKernelFunction boxed_fn);
     
     // 构造函数 - 智能构造：自动检测函数类型并决定是否需要boxing
-    template<typename Func>
+    // unboxed函数会同时保留原始的类型化入口，供TypedOperatorHandle直接调用；
+    // 以 (const OperatorHandle&, DispatchKeySet) 开头的函数会在调用时收到dispatch上下文
+    // 排除KernelFunction自身，保证拷贝非const左值时使用拷贝构造函数
+    template<typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, KernelFunction>>>
     explicit KernelFunction(Func&& func);
     
-    // 调用boxed函数
-    IValueList callBoxed(const IValueList& args) const;
+    // 调用boxed函数，op和ks是本次分发的上下文；调用前栈上是参数，返回后栈上是结果
+    // 对于unboxed内核，调用方负责保证参数符合schema()（OperatorHandle的入口会校验）
+    void callBoxed(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) const;
+    
+    // 批量调用：有批量入口时整批交给它，否则逐个调用boxed函数
+    void callBatched(const OperatorHandle& op, DispatchKeySet ks, Stack* stacks, size_t count) const;
+    
+    // 附加批量入口，参数约定与本内核的boxed函数相同
+    KernelFunction& setBatched(BatchedKernelFunction batched_fn) {
+        batched_fn_ = std::move(batched_fn);
+        return *this;
+    }
+    bool hasBatched() const { return static_cast<bool>(batched_fn_); }
+    
+    // 以C++类型直接调用：签名匹配时跳转到unboxed内核，不构造IValue和vector；
+    // 否则（例如只有boxed实现的内核）退化为boxing后调用boxed函数
+    template<typename R, typename... Args>
+    R callUnboxed(const OperatorHandle& op, DispatchKeySet ks, Args... args) const;
     
     // 检查是否有效
     bool isValid() const { return static_cast<bool>(boxed_fn_); }
+    
+    // 检查是否有指定签名的unboxed入口
+    template<typename Sig>
+    bool hasUnboxed() const { return unboxed_fn_ && unboxed_signature_ == signatureId<Sig>(); }
+    
+    // 从unboxed函数签名推导出的schema；boxed函数没有schema，返回空指针
+    const std::shared_ptr<const FunctionSchema>& schema() const { return schema_; }
 
 private:
     BoxedKernelFunction boxed_fn_;
+    BatchedKernelFunction batched_fn_;
+    std::shared_ptr<const FunctionSchema> schema_;
+    
+    // unboxed入口：跳板函数、被调用的functor以及签名标识
+    UnboxedKernelFunction unboxed_fn_ = nullptr;
+    std::shared_ptr<const void> functor_;
+    const void* unboxed_signature_ = nullptr;
     
     // 辅助函数 - 将unboxed函数包装为boxed函数
-    template<typename Func>
-    static BoxedKernelFunction makeBoxedFromUnboxed(Func&& unboxed_fn);
+    template<typename Functor>
+    static BoxedKernelFunction makeBoxedFromUnboxed(std::shared_ptr<const Functor> unboxed_fn);
 };
 
+// 每个dispatch key对应一个内核函数的定长数组，按DispatchKey直接索引
+using KernelFunctionTable = std::array<KernelFunction, static_cast<size_t>(DispatchKey::NumDispatchKeys)>;
+
+// OperatorId - 注册时分配的稳定整数ID
+// 同一个操作符名称总是被intern成同一个ID，即使注销后重新注册也不变
+using OperatorId = uint32_t;
+constexpr OperatorId kInvalidOperatorId = UINT32_MAX;
+
+template<typename Sig>
+class TypedOperatorHandle;
+
 // OperatorHandle - 管理单个操作符的dispatch table
+// dispatch table以不可变版本发布：写者复制、修改后原子替换，旧版本通过EpochManager回收，
+// 因此运行中的调用永远不会阻塞，也不会看到修改到一半的表
 class OperatorHandle {
+private:
+    static constexpr size_t kNumDispatchKeys = static_cast<size_t>(DispatchKey::NumDispatchKeys);
+    static constexpr size_t kNumKeySetMasks = size_t(1) << kNumDispatchKeys;
+    
+    // DispatchTable - 一个已发布的、不可修改的dispatch table版本
+    struct DispatchTable {
+        // 每个dispatch key对应的内核函数，按DispatchKey直接索引
+        KernelFunctionTable kernels;
+        
+        // 发布时Dispatcher中全局fallback的副本，只在本操作符没有该key的内核时使用
+        KernelFunctionTable fallbacks;
+        
+        // 操作符的schema，由第一个注册的unboxed内核确定，之后保持不变；纯boxed操作符为空
+        std::shared_ptr<const FunctionSchema> schema;
+        
+        // key set位表示 -> 解析后的内核函数（指向本表的kernels或fallbacks）
+        // 每种key set组合的查找结果都预先算好，findKernel只需一次数组索引，fallback也不例外
+        std::array<const KernelFunction*, kNumKeySetMasks> resolved{};
+        
+        // 根据kernels和fallbacks重建resolved
+        void rebuild();
+        
+        // 对单个key set执行按优先级的查找（仅在重建时使用）
+        const KernelFunction* resolveKernel(const DispatchKeySet& ks) const;
+        
+        // resolved中的指针所属的dispatch key
+        DispatchKey keyOf(const KernelFunction* kernel) const;
+    };
+
 public:
+    // KernelTableUpdate - 批量修改内核的事务
+    // 持有期间独占该句柄的写锁，多次setKernel/removeKernel只在publish()时发布一次；
+    // 析构时若尚未发布会自动发布，但因异常离开作用域（例如setKernel的schema不一致）时丢弃全部修改，
+    // 自动发布本身失败时同样丢弃，不会从析构函数抛出
+    class KernelTableUpdate {
+    public:
+        explicit KernelTableUpdate(OperatorHandle& handle);
+        ~KernelTableUpdate();
+        
+        KernelTableUpdate(KernelTableUpdate&&) = default;
+        KernelTableUpdate(const KernelTableUpdate&) = delete;
+        KernelTableUpdate& operator=(const KernelTableUpdate&) = delete;
+        
+        // 在待发布的表中注册/移除内核函数
+        KernelTableUpdate& setKernel(DispatchKey key, KernelFunction kernel);
+        KernelTableUpdate& removeKernel(DispatchKey key);
+        
+        // 原子地发布所有修改
+        void publish();
+    
+    private:
+        OperatorHandle* handle_;
+        std::unique_lock<std::mutex> lock_;
+        std::unique_ptr<DispatchTable> pending_;
+        int uncaught_exceptions_;  // 构造时正在传播的异常数，析构时据此判断是否处于异常展开中
+    };
+    
     // 构造函数
-    explicit OperatorHandle(std::string name);
+    OperatorHandle(std::string name, OperatorId id);
+    
+    // 静态注册的操作符（见StaticRegistration.h）：dispatch table推迟到第一次使用时由这些条目建立
+    // 条目必须按dispatch key排序，且在句柄的生命周期内有效
+    OperatorHandle(std::string name, OperatorId id, ArrayRef<StaticKernelEntry> static_kernels);
     
     // 析构函数
-    ~OperatorHandle() = default;
+    ~OperatorHandle();
+    
+    // 句柄地址被注册表和缓存引用，禁止拷贝和移动
+    OperatorHandle(const OperatorHandle&) = delete;
+    OperatorHandle& operator=(const OperatorHandle&) = delete;
     
     // 获取操作符名称
     const std::string& name() const { return name_; }
     
-    // 注册内核函数到指定的dispatch key
+    // 获取操作符的intern ID
+    OperatorId id() const { return id_; }
+    
+    // 注册内核函数到指定的dispatch key（单个修改，立即发布）
     void setKernel(DispatchKey key, KernelFunction kernel);
     
-    // 移除指定dispatch key的内核函数
+    // 移除指定dispatch key的内核函数（单个修改，立即发布）
     void removeKernel(DispatchKey key);
     
-    // 检查是否有指定dispatch key的内核函数
+    // 开始一次批量修改，见KernelTableUpdate
+    // 每次发布都会重新读取Dispatcher中的全局fallback
+    KernelTableUpdate updateKernels();
+    
+    // 检查是否有指定dispatch key的内核函数（不包括全局fallback）
     bool hasKernel(DispatchKey key) const;
     
+    // 操作符的schema，没有注册过unboxed内核时为空；一经确定不会再改变，指针在句柄的生命周期内有效
+    const FunctionSchema* schema() const;
+    
     // 根据dispatch key set查找最佳匹配的内核函数
     // 这是dispatch的核心逻辑：按优先级顺序查找第一个可用的内核
+    // 返回的指针只在调用方处于EpochManager::ReadGuard内时有效
     const KernelFunction* findKernel(const DispatchKeySet& ks) const;
+    // 同时通过kernel_key返回内核所属的dispatch key（fallback为其所在的key），没有内核时不修改kernel_key
+    const KernelFunction* findKernel(const DispatchKeySet& ks, DispatchKey* kernel_key) const;
+    
+    // 调用已经解析好的内核（kernel_key是findKernel返回的所属key），不校验参数；
+    // 与callBoxed一样记录事件和延迟采样；调用方需处于ReadGuard内，保证kernel所在的表不会被释放
+    void callKernel(const KernelFunction& kernel, DispatchKey kernel_key, const DispatchKeySet& ks, Stack* stack) const;
+    
+    // 基于栈调用操作符 - 根据dispatch key set选择内核，参数在栈上被原地替换为结果
+    // 有schema时先用打包的tag一次性校验参数，之后各层内核都不再检查
+    void callBoxed(const DispatchKeySet& ks, Stack* stack) const;
+    
+    // 基于栈调用操作符 - 从栈上的tensor参数自动计算dispatch key set
+    void callBoxed(Stack* stack) const;
     
     // 调用操作符 - 根据dispatch key set自动选择合适的内核
+    // IValueList接口是基于栈调用的兼容层：参数复制到新栈上，调用结束后该栈即返回值
     IValueList call(const DispatchKeySet& ks, const IValueList& args) const;
     
     // 便捷调用接口 - 从tensor参数自动计算dispatch key set
     IValueList call(const IValueList& args) const;
     
+    // 重新分发 - 屏蔽currentKey及更高优先级的key，直接跳转到本句柄表中的下一个内核
+    // 功能性包装器用它代替按名称重新查找操作符和重新计算key set
+    // 参数已经在最外层入口按schema校验过，重新分发时不再重复校验
+    void redispatchBoxed(DispatchKey currentKey, DispatchKeySet ks, Stack* stack) const {
+        callBoxedUnchecked(ks & DispatchKeySet::keysBelow(currentKey), stack);
+    }
+    
+    IValueList redispatch(DispatchKey currentKey, DispatchKeySet ks, const IValueList& args) const {
+        return call(ks & DispatchKeySet::keysBelow(currentKey), args);
+    }
+    
+    // 批量调用 - 对同一个操作符发起多个相互独立的调用，返回值与batch一一对应
+    // hint非空时跳过逐个计算，所有调用都使用localDispatchKeySet().apply(hint)作为key set，
+    // 执行的是应用当前线程的包含/排除集合之后的结果对应的内核；否则按每个调用的key set分组，
+    // 每组只查找一次内核，并通过内核的批量入口（如果有）一次执行整组；
+    // 每组记录一个事件，延迟采样记录组内平摊到每个调用的耗时
+    std::vector<IValueList> callBatch(ArrayRef<IValueList> batch, DispatchKeySet hint = DispatchKeySet()) const;
+    
+    // 获取类型化的调用句柄，例如 op.typed<Tensor(const Tensor&, const Tensor&)>()
+    template<typename Sig>
+    TypedOperatorHandle<Sig> typed() const;
+    
     // 获取所有已注册的dispatch key
     std::vector<DispatchKey> getRegisteredKeys() const;
     
@@ -336,14 +658,43 @@ public:
     std::string debugString() const;
     
     // 从IValue参数计算dispatch key set（公有方法，供Dispatcher使用）
+    // 有schema时只扫描schema中标记为tensor的参数
     DispatchKeySet computeDispatchKeySet(const IValueList& args) const;
+    
+    // 全局fallback变化后重新发布dispatch table；尚未建立的表在建立时自然读到最新的fallback，不受影响
+    void refreshFallbacks();
 
 private:
+    // 查找并调用内核，不校验参数
+    void callBoxedUnchecked(const DispatchKeySet& ks, Stack* stack) const;
+    
+    // 通过内核的批量入口调用一组栈，与callKernel一样记录事件和延迟采样
+    void callKernelBatched(const KernelFunction& kernel, DispatchKey kernel_key, const DispatchKeySet& ks,
+                           Stack* stacks, size_t count) const;
+    
+    // 使用给定的schema（可以为空）计算dispatch key set，调用方需处于ReadGuard内
+    static DispatchKeySet computeDispatchKeySet(const FunctionSchema* schema, const IValueList& args);
+    
     std::string name_;
+    OperatorId id_;
+    
+    // 当前发布的dispatch table，读者无锁加载；静态注册的操作符在第一次使用前为nullptr
+    mutable std::atomic<const DispatchTable*> table_;
+    
+    // 串行化写者，也保护第一次建立表的过程
+    mutable std::mutex write_mutex_;
+    
+    // 静态注册的内核条目，建立表之后不再使用
+    ArrayRef<StaticKernelEntry> static_kernels_;
+    
+    const DispatchTable* currentTable() const {
+        const DispatchTable* table = table_.load(std::memory_order_acquire);
+        return table ? table : materializeTable();
+    }
     
-    // Dispatch table: dispatch key -> 内核函数
-    // 使用unordered_map存储每个dispatch key对应的函数实现
-    std::unordered_map<DispatchKey, KernelFunction> dispatch_table_;
+    // 由静态条目建立第一个表；materializeTableLocked要求调用方持有write_mutex_
+    const DispatchTable* materializeTable() const;
+    const DispatchTable* materializeTableLocked() const;
 };
 
 // 便捷宏定义 - 用于简化内核函数注册
@@ -353,35 +704,159 @@ private:
 // === 模板实现部分 ===
 
 // KernelFunction的智能构造函数 - 自动检测函数类型
-template<typename Func>
+template<typename Func, typename>
 KernelFunction::KernelFunction(Func&& func) {
     using DecayedFunc = std::decay_t<Func>;
     
     // 检查是否是已经 boxed 的函数
-    if constexpr (is_boxed_function_v<DecayedFunc>) {
-        // 已经是 boxed 函数，直接使用
+    if constexpr (is_stack_boxed_function_v<DecayedFunc>) {
+        // 已经是基于栈的 boxed 函数，直接使用
         boxed_fn_ = BoxedKernelFunction(std::forward<Func>(func));
+    } else if constexpr (is_boxed_function_with_context_v<DecayedFunc>) {
+        // 返回IValue列表的 boxed 函数：整个栈作为参数列表传入，返回的列表替换栈的内容
+        boxed_fn_ = [fn = DecayedFunc(std::forward<Func>(func))](const OperatorHandle& op, DispatchKeySet ks,
+                                                                Stack* stack) {
+            *stack = fn(op, ks, *stack);
+        };
+    } else if constexpr (is_boxed_function_v<DecayedFunc>) {
+        // 不需要上下文的 boxed 函数，同样适配为基于栈的调用约定
+        boxed_fn_ = [fn = DecayedFunc(std::forward<Func>(func))](const OperatorHandle&, DispatchKeySet,
+                                                                Stack* stack) {
+            *stack = fn(*stack);
+        };
     } else {
-        // 是 unboxed 函数，需要进行 boxing
-        boxed_fn_ = makeBoxedFromUnboxed(std::forward<Func>(func));
+        // 是 unboxed 函数：boxed入口和unboxed入口共享同一个functor
+        using Trampoline = UnboxedTrampolineFor<DecayedFunc>;
+        
+        auto functor = std::make_shared<const DecayedFunc>(std::forward<Func>(func));
+        boxed_fn_ = makeBoxedFromUnboxed(functor);
+        schema_ = std::make_shared<const FunctionSchema>(
+            infer_schema<typename Trampoline::return_type, typename Trampoline::arg_types>::get());
+        unboxed_fn_ = reinterpret_cast<UnboxedKernelFunction>(&Trampoline::call);
+        unboxed_signature_ = signatureId<typename Trampoline::Signature>();
+        functor_ = std::move(functor);
     }
 }
 
 // 核心实现 - 将unboxed函数包装为boxed函数
-template<typename Func>
-BoxedKernelFunction KernelFunction::makeBoxedFromUnboxed(Func&& unboxed_fn) {
-    using traits = function_traits<std::decay_t<Func>>;
-    
-    return [unboxed_fn = std::forward<Func>(unboxed_fn)](const IValueList& args) -> IValueList {
-        // 第一步：验证参数数量
-        if (args.size() != traits::arity) {
-            throw std::runtime_error("参数数量不匹配：期望 " + std::to_string(traits::arity) + 
-                                   " 个参数，实际得到 " + std::to_string(args.size()) + " 个");
-        }
-        
-        // 第二步：使用index_sequence展开参数并调用unboxed函数
-        return callUnboxedImpl(unboxed_fn, args, std::make_index_sequence<traits::arity>{});
+template<typename Functor>
+BoxedKernelFunction KernelFunction::makeBoxedFromUnboxed(std::shared_ptr<const Functor> unboxed_fn) {
+    using Trampoline = UnboxedTrampolineFor<Functor>;
+    
+    // 参数数量和类型已经由OperatorHandle按schema校验，这里直接展开
+    return [unboxed_fn = std::move(unboxed_fn)](const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+        callUnboxedImpl<Trampoline>(unboxed_fn.get(), op, ks, stack,
+                                    std::make_index_sequence<Trampoline::arity>{});
     };
 }
 
-} // namespace dispatcher 
\ No newline at end of file
+template<typename R, typename... Args>
+R KernelFunction::callUnboxed(const OperatorHandle& op, DispatchKeySet ks, Args... args) const {
+    if (unboxed_fn_ && unboxed_signature_ == signatureId<R(Args...)>()) {
+        // 快速路径：直接跳转到类型化的内核
+        auto fn = reinterpret_cast<R (*)(const void*, const OperatorHandle&, DispatchKeySet, Args...)>(unboxed_fn_);
+        return fn(functor_.get(), op, ks, std::forward<Args>(args)...);
+    }
+    
+    // 慢速路径：把参数boxing到线程局部的复用栈上调用boxed函数，再unboxing返回值
+    PooledStack stack;
+    push(*stack, arg_to_ivalue<std::decay_t<Args>>::convert(args)...);
+    if (schema_ && !schema_->matches(*stack)) {
+        // 调用方的签名与内核不一致，unboxed内核的boxed入口不做检查，必须在这里拦截
+        schema_->throwMismatch(op.name(), *stack);
+    }
+    callBoxed(op, ks, stack.get());
+    if constexpr (std::is_void_v<R>) {
+        return;
+    } else {
+        if (stack->size() != 1) {
+            throw std::runtime_error("Expected exactly one return value, got " + std::to_string(stack->size()));
+        }
+        return ivalue_to_arg<R>::convert((*stack)[0]);
+    }
+}
+
+namespace detail {
+
+// 从类型化参数中直接收集tensor的dispatch key，非tensor参数被忽略
+inline void collectTensorKeys(DispatchKeySet& ks, bool& found, const Tensor& tensor) {
+    if (tensor) {
+        ks |= tensor->tensorKeySet();
+        found = true;
+    }
+}
+
+inline void collectTensorKeys(DispatchKeySet& ks, bool& found, const std::vector<Tensor>& tensors) {
+    for (const auto& tensor : tensors) {
+        collectTensorKeys(ks, found, tensor);
+    }
+}
+
+template<typename T>
+inline void collectTensorKeys(DispatchKeySet&, bool&, const T&) {}
+
+} // namespace detail
+
+// TypedOperatorHandle - 类型化的操作符调用句柄
+// 直接从C++参数计算dispatch key set并调用unboxed内核，全程不构造IValueList
+template<typename R, typename... Args>
+class TypedOperatorHandle<R(Args...)> {
+public:
+    explicit TypedOperatorHandle(const OperatorHandle& handle) : handle_(&handle) {}
+    
+    const OperatorHandle& handle() const { return *handle_; }
+    
+    // 从tensor参数计算dispatch key set并调用
+    R call(Args... args) const {
+        DispatchKeySet ks;
+        bool found = false;
+        (detail::collectTensorKeys(ks, found, args), ...);
+        // 与boxed路径一致：合并全局功能性key，没有tensor参数时使用全局状态或默认CPU backend
+        return call(finalizeDispatchKeySet(ks, found), std::forward<Args>(args)...);
+    }
+    
+    // 使用指定的dispatch key set调用
+    R call(DispatchKeySet ks, Args... args) const {
+        EpochManager::ReadGuard guard;
+        if (DispatchEventScope::enabled()) {
+            return callRecorded(ks, std::forward<Args>(args)...);
+        }
+        const KernelFunction* kernel = handle_->findKernel(ks);
+        if (!kernel) {
+            throwNoKernel(ks);
+        }
+        return kernel->template callUnboxed<R, Args...>(*handle_, ks, std::forward<Args>(args)...);
+    }
+    
+    // 重新分发 - 屏蔽currentKey及更高优先级的key后调用下一个内核，与OperatorHandle::redispatch对应
+    R redispatch(DispatchKey currentKey, DispatchKeySet ks, Args... args) const {
+        return call(ks & DispatchKeySet::keysBelow(currentKey), std::forward<Args>(args)...);
+    }
+
+private:
+    [[noreturn]] void throwNoKernel(DispatchKeySet ks) const {
+        throw std::runtime_error("No kernel found for operator '" + handle_->name() +
+                               "' with dispatch key set " + ks.toString());
+    }
+    
+    // 开启事件记录时的慢路径：额外取得内核所属的dispatch key
+    R callRecorded(DispatchKeySet ks, Args... args) const {
+        DispatchKey key = DispatchKey::Undefined;
+        const KernelFunction* kernel = handle_->findKernel(ks, &key);
+        if (!kernel) {
+            throwNoKernel(ks);
+        }
+        DispatchEventScope event;
+        event.begin(handle_->id(), key);
+        return kernel->template callUnboxed<R, Args...>(*handle_, ks, std::forward<Args>(args)...);
+    }
+    
+    const OperatorHandle* handle_;
+};
+
+template<typename Sig>
+TypedOperatorHandle<Sig> OperatorHandle::typed() const {
+    return TypedOperatorHandle<Sig>(*this);
+}
+
+} // namespace dispatcher
\ No newline at end of file
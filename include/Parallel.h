@@ -0,0 +1,53 @@
+#pragma once
+
+#include "TensorImpl.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+namespace dispatcher {
+
+// CPU内核的intra-op并行原语
+// parallel_for把[begin, end)切成若干块，调用方线程执行第一块，其余块交给intra-op线程池并等待全部完成；
+// 线程池与异步调用的CPU执行器相互独立，线程数和核心绑定通过GlobalDispatchState配置
+
+namespace detail {
+// 当前线程是否正在执行某个parallel_for的分块
+inline thread_local bool tls_in_parallel_region = false;
+
+void parallelForImpl(int64_t begin, int64_t end, int64_t grain_size,
+                     const std::function<void(int64_t, int64_t)>& fn);
+} // namespace detail
+
+// 当前线程是否处于parallel_for的分块内；嵌套的parallel_for在这里直接顺序执行，
+// 因此不会向线程池提交任务后阻塞等待（不会死锁），也不会产生超过线程池大小的并发
+inline bool inParallelRegion() {
+    return detail::tls_in_parallel_region;
+}
+
+// intra-op并行实际使用的线程数（包括调用方线程），关闭并行时为1
+size_t getNumIntraOpThreads();
+
+// 对[begin, end)并行调用fn(chunk_begin, chunk_end)，每块至少grain_size个元素
+// 区间不超过grain_size、关闭并行或在分块内嵌套调用时，直接在当前线程上调用fn(begin, end)
+// 任意分块抛出的异常在所有分块结束后于调用方线程重新抛出（只保留第一个）
+template<typename F>
+void parallel_for(int64_t begin, int64_t end, int64_t grain_size, const F& fn) {
+    if (begin >= end) {
+        return;
+    }
+    // 顺序路径内联在调用方，不构造std::function
+    if (end - begin <= std::max<int64_t>(grain_size, 1) || inParallelRegion()) {
+        fn(begin, end);
+        return;
+    }
+    detail::parallelForImpl(begin, end, grain_size, std::function<void(int64_t, int64_t)>(std::cref(fn)));
+}
+
+// 逐元素内核的便捷形式：在[0, numel)上并行，元素数不超过GlobalDispatchState::parallelCutoff()时顺序执行
+template<typename F>
+void parallel_for(const TensorImpl& tensor, const F& fn) {
+    parallel_for(0, tensor.numel(), GlobalDispatchState::instance().parallelCutoff(), fn);
+}
+
+} // namespace dispatcher
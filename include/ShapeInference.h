@@ -0,0 +1,32 @@
+#pragma once
+
+#include "DispatchKeySet.h"
+#include "Stack.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace dispatcher {
+
+class OperatorHandle;
+
+// === Meta backend的形状推断 ===
+// Meta tensor（make_tensor_meta）只有sizes没有数据，在其上调用操作符会分发到DispatchKey::Meta的内核；
+// Meta内核只计算输出的形状，不分配内存也不做计算。配合GraphCapture和planMemory，
+// 可以在运行真实backend之前检查整个操作序列的形状，并得到中间结果的内存峰值
+
+// 形状推断函数：根据参数计算输出的sizes，形状不合法时抛出std::runtime_error
+using ShapeFunction = std::function<std::vector<int64_t>(const Stack& args)>;
+
+// 为操作符注册Meta内核：调用shape_fn，把参数替换为一个该形状的Meta tensor
+// 操作符尚未注册时会先注册；重复调用替换之前的形状函数
+void registerShapeFunction(const std::string& op_name, ShapeFunction shape_fn);
+
+// 逐元素运算的形状函数：所有tensor参数的元素数必须相同（与CPU内核的检查一致），输出形状与第一个tensor参数相同
+std::vector<int64_t> elementwiseShape(const Stack& args);
+
+// 按elementwiseShape推断形状的Meta内核，可以直接用STATIC_REGISTER_KERNEL静态注册
+void elementwise_meta_kernel(const OperatorHandle& op, DispatchKeySet ks, Stack* stack);
+
+} // namespace dispatcher
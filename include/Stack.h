@@ -0,0 +1,91 @@
+#pragma once
+
+#include "IValue.h"
+#include "ArrayRef.h"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace dispatcher {
+
+// Stack - boxed调用约定使用的参数/结果栈
+// 调用时栈上恰好是本次调用的参数，内核返回时栈上恰好是它的结果；
+// 内核原地弹出参数、压入结果，重新分发时直接把同一个栈交给下一层，整个调用链不再分配新的vector
+// 与IValueList是同一类型，旧的IValueList接口可以直接把参数列表当作栈使用
+using Stack = std::vector<IValue>;
+
+// === 栈操作辅助函数 ===
+
+// 压入一个或多个值
+template<typename... Args>
+inline void push(Stack& stack, Args&&... args) {
+    (stack.emplace_back(std::forward<Args>(args)), ...);
+}
+
+// 弹出栈顶的值
+inline IValue pop(Stack& stack) {
+    IValue value = std::move(stack.back());
+    stack.pop_back();
+    return value;
+}
+
+// 丢弃栈顶的n个值
+inline void drop(Stack& stack, size_t n) {
+    stack.erase(stack.end() - static_cast<std::ptrdiff_t>(n), stack.end());
+}
+
+// 查看栈顶n个值中的第i个（从0开始），不弹出
+inline const IValue& peek(const Stack& stack, size_t i, size_t n) {
+    return stack[stack.size() - n + i];
+}
+
+// 栈顶n个值的视图
+inline ArrayRef<IValue> last(const Stack& stack, size_t n) {
+    return ArrayRef<IValue>(stack.data() + stack.size() - n, n);
+}
+
+namespace detail {
+
+// 每个线程的栈池，按嵌套深度复用；unique_ptr保证扩容时已借出的栈地址不变
+struct StackPool {
+    std::vector<std::unique_ptr<Stack>> stacks;
+    size_t depth = 0;
+};
+
+inline StackPool& localStackPool() {
+    static thread_local StackPool pool;
+    return pool;
+}
+
+} // namespace detail
+
+// PooledStack - 从当前线程的栈池借用一个Stack，作用域结束时清空并归还
+// 归还时保留容量，因此稳定状态下借用和压栈都不分配内存；
+// 内核内部再调用其他操作符时借到的是下一层的栈，与外层互不干扰
+class PooledStack {
+public:
+    PooledStack() {
+        detail::StackPool& pool = detail::localStackPool();
+        if (pool.depth == pool.stacks.size()) {
+            pool.stacks.push_back(std::make_unique<Stack>());
+        }
+        stack_ = pool.stacks[pool.depth++].get();
+    }
+
+    ~PooledStack() {
+        stack_->clear();
+        --detail::localStackPool().depth;
+    }
+
+    PooledStack(const PooledStack&) = delete;
+    PooledStack& operator=(const PooledStack&) = delete;
+
+    Stack* get() const { return stack_; }
+    Stack& operator*() const { return *stack_; }
+    Stack* operator->() const { return stack_; }
+
+private:
+    Stack* stack_;
+};
+
+} // namespace dispatcher
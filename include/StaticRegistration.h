@@ -0,0 +1,69 @@
+#pragma once
+
+#include "OperatorHandle.h"
+#include "DispatchKey.h"
+
+namespace dispatcher {
+
+// === 静态注册 ===
+// STATIC_REGISTER_KERNEL在编译期生成一个常量初始化的条目（操作符名、dispatch key、内核工厂函数指针），
+// 放进专门的链接段dispatcher_kernels；程序启动时不执行任何注册代码
+// Dispatcher构造时一次性读取整个段：按操作符名排序后预先分配好注册表，每个操作符只创建句柄；
+// 句柄的dispatch table（包括KernelFunction的构造）推迟到第一次使用时才建立
+// 静态注册的操作符与运行时注册的操作符行为相同，之后仍可以用registerOp/setKernel继续修改
+
+// 静态注册表中的一个条目；只包含常量，可以在编译期初始化
+struct StaticKernelEntry {
+    const char* name;               // 操作符名称
+    const char* overload_name;      // 重载名称，默认重载为""
+    KernelFunction (*make_kernel)();  // 第一次使用该操作符时调用，构造内核
+    DispatchKey key;
+};
+
+// 把函数包装为内核工厂：KernelFunction的构造推迟到调用时
+template<auto Func>
+KernelFunction makeStaticKernel() {
+    return KernelFunction(Func);
+}
+
+// 链接进程序的全部静态条目（未排序，可能为空）
+ArrayRef<StaticKernelEntry> staticKernelEntries();
+
+namespace detail {
+// 没有链接段支持的平台上，由静态对象在动态初始化阶段登记条目
+struct StaticKernelRegistrar {
+    explicit StaticKernelRegistrar(const StaticKernelEntry& entry);
+};
+} // namespace detail
+
+} // namespace dispatcher
+
+#define DISPATCHER_CONCAT_IMPL(a, b) a##b
+#define DISPATCHER_CONCAT(a, b) DISPATCHER_CONCAT_IMPL(a, b)
+
+#if defined(__ELF__)
+// 段名必须是合法的C标识符，链接器才会生成__start_/__stop_符号
+// 显式指定对齐，保证段中的条目像数组一样紧密排列
+#define DISPATCHER_STATIC_ENTRY(var, ...)                                                                    \
+    __attribute__((used, section("dispatcher_kernels"), aligned(alignof(dispatcher::StaticKernelEntry)))) \
+    static const dispatcher::StaticKernelEntry var = {__VA_ARGS__}
+#else
+#define DISPATCHER_STATIC_ENTRY(var, ...)                                  \
+    static const dispatcher::StaticKernelEntry var = {__VA_ARGS__};        \
+    static const dispatcher::detail::StaticKernelRegistrar DISPATCHER_CONCAT(var, _registrar)(var)
+#endif
+
+// 在命名空间作用域静态注册内核，例如 STATIC_REGISTER_KERNEL("add", CPU, add_cpu_kernel)
+// func必须是函数（不能是lambda），支持的函数形式与REGISTER_KERNEL相同
+#define STATIC_REGISTER_KERNEL(op_name, dispatch_key, func)                                     \
+    DISPATCHER_STATIC_ENTRY(DISPATCHER_CONCAT(static_kernel_entry_, __COUNTER__), op_name, "", \
+                            &dispatcher::makeStaticKernel<func>, dispatcher::DispatchKey::dispatch_key)
+
+#define STATIC_REGISTER_KERNEL_OVERLOAD(op_name, overload, dispatch_key, func)                        \
+    DISPATCHER_STATIC_ENTRY(DISPATCHER_CONCAT(static_kernel_entry_, __COUNTER__), op_name, overload, \
+                            &dispatcher::makeStaticKernel<func>, dispatcher::DispatchKey::dispatch_key)
+
+// factory是返回KernelFunction的函数，用于需要额外配置的内核（例如附加批量入口）
+#define STATIC_REGISTER_KERNEL_FACTORY(op_name, dispatch_key, factory)                          \
+    DISPATCHER_STATIC_ENTRY(DISPATCHER_CONCAT(static_kernel_entry_, __COUNTER__), op_name, "", \
+                            &factory, dispatcher::DispatchKey::dispatch_key)
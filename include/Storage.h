@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Allocator.h"
+#include "IntrusivePtr.h"
+#include <array>
+#include <cstddef>
+
+namespace dispatcher {
+
+class StorageImpl;
+
+// Storage - 侵入式引用计数的StorageImpl句柄，多个tensor可以共享同一块数据
+using Storage = intrusive_ptr<StorageImpl>;
+
+// StorageImpl - tensor的数据缓冲区
+// 内存来自创建时指定的Allocator，最后一个引用释放时归还给同一个分配器；
+// 没有分配器时内存由外部拥有（例如GraphExecutor的slab），释放时不做任何事
+class StorageImpl : public intrusive_ptr_target {
+public:
+    StorageImpl(size_t nbytes, Allocator* allocator)
+        : data_(allocator->allocate(nbytes)), nbytes_(nbytes), allocator_(allocator) {}
+
+    // 使用外部拥有的内存，调用方保证它比这个Storage活得更久
+    StorageImpl(void* data, size_t nbytes) : data_(data), nbytes_(nbytes), allocator_(nullptr) {}
+
+    ~StorageImpl() override {
+        if (allocator_) {
+            allocator_->deallocate(data_, nbytes_);
+        }
+    }
+
+    StorageImpl(const StorageImpl&) = delete;
+    StorageImpl& operator=(const StorageImpl&) = delete;
+
+    void* data() { return data_; }
+    const void* data() const { return data_; }
+    size_t nbytes() const { return nbytes_; }
+    Allocator* allocator() const { return allocator_; }
+
+private:
+    void* data_;
+    size_t nbytes_;
+    Allocator* allocator_;
+};
+
+// 工厂函数 - 使用backend的分配器创建Storage
+inline Storage make_storage(size_t nbytes, DispatchKey backend) {
+    return make_intrusive<StorageImpl>(nbytes, getAllocator(backend));
+}
+
+// OutputRegion - 预先为内核的某个结果准备好的内存，data为空表示该结果没有准备
+struct OutputRegion {
+    DispatchKey backend;
+    void* data;
+    size_t nbytes;
+};
+
+namespace detail {
+// 当前线程上正在执行的调用为其结果登记的区域，按结果的顺序依次被make_output_storage取走
+struct OutputRegions {
+    const OutputRegion* regions = nullptr;
+    size_t count = 0;
+    size_t next = 0;
+};
+inline thread_local OutputRegions tls_output_regions;
+} // namespace detail
+
+// OutputRegionGuard - 在作用域内为当前线程接下来创建的结果登记区域，析构时恢复，支持嵌套
+// 例如GraphExecutor用它把节点的输出放进静态规划好的内存块；regions在作用域内必须保持有效
+class OutputRegionGuard {
+public:
+    OutputRegionGuard(const OutputRegion* regions, size_t count) : saved_(detail::tls_output_regions) {
+        detail::tls_output_regions = detail::OutputRegions{regions, count, 0};
+    }
+    ~OutputRegionGuard() { detail::tls_output_regions = saved_; }
+
+    OutputRegionGuard(const OutputRegionGuard&) = delete;
+    OutputRegionGuard& operator=(const OutputRegionGuard&) = delete;
+
+private:
+    detail::OutputRegions saved_;
+};
+
+// 为内核的结果创建Storage：第k次调用取第k个登记的区域，backend和大小都一致时直接使用该区域，
+// 否则（没有登记、形状与规划时不同）向backend的分配器申请
+// 只用于内核最终返回的结果；临时缓冲区（例如clone、contiguous的副本）使用make_storage，不会占用登记的区域
+inline Storage make_output_storage(size_t nbytes, DispatchKey backend) {
+    detail::OutputRegions& state = detail::tls_output_regions;
+    if (state.next < state.count) {
+        const OutputRegion& region = state.regions[state.next++];
+        if (region.data && region.backend == backend && region.nbytes == nbytes) {
+            return make_intrusive<StorageImpl>(region.data, nbytes);
+        }
+    }
+    return make_storage(nbytes, backend);
+}
+
+} // namespace dispatcher
@@ -2,19 +2,41 @@
 
 #include "DispatchKey.h"
 #include "DispatchKeySet.h"
-#include <vector>
+#include "LocalDispatchKeySet.h"
+#include "IntrusivePtr.h"
+#include "Storage.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include <string>
 
 namespace dispatcher {
 
+class TensorImpl;
+struct AutogradNode;
+class AutogradGraph;
+
+// Tensor - 侵入式引用计数的TensorImpl句柄，引用计数嵌在TensorImpl中
+using Tensor = intrusive_ptr<TensorImpl>;
+
 // TensorImpl - 简化的tensor实现
 // 用于演示dispatcher如何根据tensor的属性进行分发
-class TensorImpl {
+// 数据保存在Storage中，元素类型固定为float（简化：没有dtype）
+// 元素(i0, i1, ...)位于storage的第 storage_offset + i0*strides[0] + i1*strides[1] + ... 个float；
+// 视图（见TensorViews.h）与原tensor共享Storage，只是sizes/strides/storage_offset不同
+class TensorImpl : public intrusive_ptr_target {
 public:
-    // 构造函数 - 创建指定形状和后端的tensor
+    // 每个元素的字节数
+    static constexpr size_t kElementSize = sizeof(float);
+    
+    // 构造函数 - 创建指定形状和后端的连续tensor，数据通过backend的分配器分配（内容未初始化）
     TensorImpl(std::vector<int64_t> sizes, DispatchKey backend_key);
     
+    // 构造函数 - 创建共享storage的视图，调用方保证所有元素都落在storage范围内
+    TensorImpl(Storage storage, std::vector<int64_t> sizes, std::vector<int64_t> strides, int64_t storage_offset,
+               DispatchKey backend_key);
+    
     // 虚析构函数，支持继承
     virtual ~TensorImpl() = default;
     
@@ -27,6 +49,28 @@ public:
     // 获取tensor的维度数量
     int64_t dim() const { return static_cast<int64_t>(sizes_.size()); }
     
+    // 每一维相邻元素之间相隔的元素数，以及第一个元素在storage中的位置（以元素计）
+    const std::vector<int64_t>& strides() const { return strides_; }
+    int64_t storageOffset() const { return storage_offset_; }
+    
+    // 是否按行优先连续存放（大小为1的维度不看stride）；构造时计算并缓存，内核据此选择连续的快速路径
+    bool isContiguous() const { return is_contiguous_; }
+    
+    // 连续时返回自身，否则按元素复制为新的连续tensor
+    Tensor contiguous() const;
+    
+    // 数据缓冲区，视图与原tensor共享同一个Storage；Meta tensor没有Storage
+    const Storage& storage() const { return storage_; }
+    size_t nbytes() const { return static_cast<size_t>(numel()) * kElementSize; }
+    
+    // 第一个元素的指针，元素数为0或Meta tensor时为nullptr；只有isContiguous()时才能把它当作numel()个连续的float
+    float* data() {
+        return storage_ && storage_->data() ? static_cast<float*>(storage_->data()) + storage_offset_ : nullptr;
+    }
+    const float* data() const {
+        return storage_ && storage_->data() ? static_cast<const float*>(storage_->data()) + storage_offset_ : nullptr;
+    }
+    
     // 获取后端dispatch key（CPU、CUDA等）
     DispatchKey backendKey() const { return backend_key_; }
     
@@ -34,61 +78,152 @@ public:
     // 这个函数会根据tensor的属性和全局状态计算出完整的dispatch key集合
     DispatchKeySet keySet() const;
     
+    // tensor自身属性决定的dispatch key set（backend + Autograd），不包含全局状态
+    // 该集合缓存为成员，只在属性变化时更新，dispatch热路径上直接读取
+    DispatchKeySet tensorKeySet() const { return key_set_; }
+    
     // 设置是否需要梯度（用于autograd）
-    void setRequiresGrad(bool requires_grad) { requires_grad_ = requires_grad; }
+    void setRequiresGrad(bool requires_grad) {
+        requires_grad_ = requires_grad;
+        if (requires_grad) {
+            key_set_.add(DispatchKey::Autograd);
+        } else {
+            key_set_.remove(DispatchKey::Autograd);
+        }
+    }
     bool requiresGrad() const { return requires_grad_; }
     
+    // autograd（见Autograd.h）：由需要梯度的输入计算得到的tensor通过grad_fn指向生成它的反向节点，
+    // 并持有节点所在的图；没有grad_fn的叶子tensor在反向传播时把梯度累加到grad()
+    AutogradNode* gradFn() const { return grad_fn_; }
+    const std::shared_ptr<AutogradGraph>& autogradGraph() const { return autograd_graph_; }
+    void setGradFn(AutogradNode* grad_fn, std::shared_ptr<AutogradGraph> graph) {
+        grad_fn_ = grad_fn;
+        autograd_graph_ = std::move(graph);
+    }
+    bool isLeaf() const { return grad_fn_ == nullptr; }
+    const Tensor& grad() const { return grad_; }
+    void setGrad(Tensor grad) { grad_ = std::move(grad); }
+    
     // 获取tensor的调试信息
     std::string debugString() const;
     
     // 判断tensor是否在指定设备上
     bool is_cpu() const { return backend_key_ == DispatchKey::CPU; }
     bool is_cuda() const { return backend_key_ == DispatchKey::CUDA; }
+    bool is_meta() const { return backend_key_ == DispatchKey::Meta; }
     
-    // 克隆tensor（浅拷贝metadata，深拷贝数据的接口）
-    virtual std::shared_ptr<TensorImpl> clone() const;
+    // 克隆tensor（拷贝metadata，深拷贝数据到新的连续Storage）
+    virtual Tensor clone() const;
 
 protected:
     std::vector<int64_t> sizes_;     // tensor的形状
+    std::vector<int64_t> strides_;   // 每一维的步长（以元素计）
+    int64_t storage_offset_ = 0;     // 第一个元素在storage中的位置（以元素计）
+    bool is_contiguous_ = true;      // 缓存的isContiguous()
     DispatchKey backend_key_;        // 后端类型（CPU/CUDA等）
     bool requires_grad_ = false;     // 是否需要梯度计算
-    
-    // 可以添加其他属性如stride、storage等，这里简化处理
+    DispatchKeySet key_set_;         // 缓存的tensor自身dispatch key set
+    Storage storage_;                // 数据缓冲区
+    AutogradNode* grad_fn_ = nullptr;  // 生成该tensor的反向节点，分配在autograd_graph_中
+    std::shared_ptr<AutogradGraph> autograd_graph_;
+    Tensor grad_;                    // 叶子tensor累加的梯度
 };
 
+// 行优先连续存放时的strides
+std::vector<int64_t> contiguousStrides(const std::vector<int64_t>& sizes);
+
 // 工厂函数 - 创建不同后端的tensor
-std::shared_ptr<TensorImpl> make_tensor_cpu(std::vector<int64_t> sizes);
-std::shared_ptr<TensorImpl> make_tensor_cuda(std::vector<int64_t> sizes);
+Tensor make_tensor_cpu(std::vector<int64_t> sizes);
+Tensor make_tensor_cuda(std::vector<int64_t> sizes);
+// 只有形状的tensor：不分配内存，在其上调用操作符只做形状推断（见ShapeInference.h）
+Tensor make_tensor_meta(std::vector<int64_t> sizes);
+// 内核创建要返回的结果tensor：数据放在为该结果登记的区域中（见Storage.h的make_output_storage）
+Tensor make_output_tensor(DispatchKey backend, std::vector<int64_t> sizes);
 
 // 工具函数 - 根据tensors计算合并的dispatch key set
-DispatchKeySet computeDispatchKeySet(const std::vector<std::shared_ptr<TensorImpl>>& tensors);
+DispatchKeySet computeDispatchKeySet(const std::vector<Tensor>& tensors);
 
 // 全局状态管理 - 用于功能性dispatch key
+// 各开关直接维护一个缓存的key位掩码，computeFunctionalityKeys()只需一次原子读取
 class GlobalDispatchState {
 public:
     static GlobalDispatchState& instance();
     
     // 设置和获取是否启用autograd
-    void setAutogradEnabled(bool enabled) { autograd_enabled_ = enabled; }
-    bool isAutogradEnabled() const { return autograd_enabled_; }
+    void setAutogradEnabled(bool enabled) { setKeyEnabled(DispatchKey::Autograd, enabled); }
+    bool isAutogradEnabled() const { return isKeyEnabled(DispatchKey::Autograd); }
     
     // 设置和获取是否启用tracing
-    void setTracingEnabled(bool enabled) { tracing_enabled_ = enabled; }
-    bool isTracingEnabled() const { return tracing_enabled_; }
+    void setTracingEnabled(bool enabled) { setKeyEnabled(DispatchKey::Tracing, enabled); }
+    bool isTracingEnabled() const { return isKeyEnabled(DispatchKey::Tracing); }
     
     // 设置和获取是否启用profiling
-    void setProfilingEnabled(bool enabled) { profiling_enabled_ = enabled; }
-    bool isProfilingEnabled() const { return profiling_enabled_; }
+    void setProfilingEnabled(bool enabled) { setKeyEnabled(DispatchKey::Profiling, enabled); }
+    bool isProfilingEnabled() const { return isKeyEnabled(DispatchKey::Profiling); }
     
     // 计算当前全局状态对应的功能性dispatch key set
-    DispatchKeySet computeFunctionalityKeys() const;
+    DispatchKeySet computeFunctionalityKeys() const {
+        return DispatchKeySet::fromRaw(functionality_bits_.load(std::memory_order_relaxed));
+    }
+    
+    // === CPU intra-op并行配置（见Parallel.h） ===
+    // 任何修改都会递增threadConfigVersion()，parallel_for在下一次调用时按新配置重建线程池
+    
+    // intra-op并行使用的线程数（包括调用方线程），0表示使用硬件线程数，1表示关闭并行
+    void setNumThreads(size_t num_threads);
+    size_t numThreads() const { return num_threads_.load(std::memory_order_relaxed); }
+    
+    // 工作线程绑定的CPU核心编号，第i个工作线程绑定到cores[i % cores.size()]，为空表示不绑定
+    void setThreadAffinity(std::vector<int> cores);
+    std::vector<int> threadAffinity() const;
+    
+    // 顺序执行阈值：元素数不超过该值的tensor在调用方线程上直接计算
+    void setParallelCutoff(int64_t cutoff) { parallel_cutoff_.store(cutoff, std::memory_order_relaxed); }
+    int64_t parallelCutoff() const { return parallel_cutoff_.load(std::memory_order_relaxed); }
+    
+    uint64_t threadConfigVersion() const { return thread_config_version_.load(std::memory_order_acquire); }
+    
+    // 是否把每次内核调用记录为时间线事件（见EventRecorder.h）
+    void setEventRecordingEnabled(bool enabled) { event_recording_enabled_.store(enabled, std::memory_order_relaxed); }
+    bool isEventRecordingEnabled() const { return event_recording_enabled_.load(std::memory_order_relaxed); }
 
 private:
-    bool autograd_enabled_ = false;
-    bool tracing_enabled_ = false;
-    bool profiling_enabled_ = false;
+    void setKeyEnabled(DispatchKey key, bool enabled) {
+        uint64_t bit = DispatchKeySet(key).raw();
+        if (enabled) {
+            functionality_bits_.fetch_or(bit, std::memory_order_relaxed);
+        } else {
+            functionality_bits_.fetch_and(~bit, std::memory_order_relaxed);
+        }
+    }
+    
+    bool isKeyEnabled(DispatchKey key) const {
+        return computeFunctionalityKeys().has(key);
+    }
+    
+    std::atomic<uint64_t> functionality_bits_{0};  // 已启用的功能性key位掩码
+    
+    std::atomic<size_t> num_threads_{0};
+    std::atomic<int64_t> parallel_cutoff_{32768};
+    std::atomic<uint64_t> thread_config_version_{0};
+    std::atomic<bool> event_recording_enabled_{false};
+    mutable std::mutex affinity_mutex_;
+    std::vector<int> thread_affinity_;  // 仅在持有affinity_mutex_时访问
     
     GlobalDispatchState() = default;
 };
 
-} // namespace dispatcher 
\ No newline at end of file
+// 合并从参数中收集到的tensor key与全局功能性key，再应用当前线程的包含/排除集合
+// 没有任何tensor参数时使用默认的CPU backend，功能性key照常生效，
+// 这样标量操作在tracing/profiling开启时经过对应的fallback后仍能落到CPU内核
+inline DispatchKeySet finalizeDispatchKeySet(DispatchKeySet tensor_keys, bool has_tensor) {
+    const LocalDispatchKeySet& local = localDispatchKeySet();
+    DispatchKeySet global_keys = GlobalDispatchState::instance().computeFunctionalityKeys();
+    if (!has_tensor) {
+        tensor_keys = DispatchKeySet(DispatchKey::CPU);
+    }
+    return local.apply(tensor_keys | global_keys);
+}
+
+} // namespace dispatcher
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "TensorImpl.h"
+#include <string>
+#include <vector>
+
+namespace dispatcher {
+
+// === Tensor视图 ===
+// 返回与输入共享Storage的新tensor，只改变sizes/strides/storage_offset，不复制数据；
+// 对视图的写入对原tensor可见。负的维度编号从最后一维倒数
+// 这些函数本身不参与autograd，结果不需要梯度；经由操作符调用时Autograd内核记录反向节点，梯度写回原tensor
+
+// 第dim维取[start, end)中每隔step个元素，start/end按Python的规则处理负数并截断到合法范围
+Tensor slice(const Tensor& self, int64_t dim, int64_t start, int64_t end, int64_t step = 1);
+
+// 交换两个维度
+Tensor transpose(const Tensor& self, int64_t dim0, int64_t dim1);
+
+// 改变形状，元素数不变，最多一个-1表示由其余维度推断；要求输入连续
+Tensor view(const Tensor& self, std::vector<int64_t> sizes);
+
+// 与view相同，输入不连续时先复制为连续tensor（此时结果不是视图）
+Tensor reshape(const Tensor& self, std::vector<int64_t> sizes);
+
+// 把大小为1的维度广播到指定大小（stride为0，不复制数据），-1表示保持该维不变，可以在前面增加新的维度
+Tensor expand(const Tensor& self, std::vector<int64_t> sizes);
+
+// 把slice/transpose/view/reshape/expand注册为操作符，CPU、CUDA和Meta共用同一份实现，另有各自的Autograd内核
+void registerViewOperators();
+
+// 操作符的结果是否可能与输入共享Storage；计算图的内存规划据此延长被引用的中间结果的生命周期
+bool isViewOperator(const std::string& op_name);
+
+} // namespace dispatcher
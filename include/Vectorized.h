@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// 逐元素内核的底层接口：运算列表、指令集检测和每个指令集的内核函数表
+// 各指令集的实现文件（VectorizedAVX2.cpp等）以不同的编译选项编译，只包含本头文件和VectorizedImpl.h，
+// 避免带扩展指令的inline函数副本被链接到其他翻译单元
+
+namespace dispatcher {
+
+// === 逐元素运算列表 ===
+// 每一项是(名称, 表达式)，表达式中a/b是同类型的操作数，T是它们的类型（float或SIMD向量）
+// 新增一项即可得到所有指令集的向量化实现和parallel_for切分，不需要修改任何内核代码
+// 可用的运算：+ - * /、一元负号、maximum(x, y)，以及T(标量)构造的广播常量
+
+#define DISPATCHER_FORALL_BINARY_OPS(_) \
+    _(Add, a + b)                       \
+    _(Sub, a - b)                       \
+    _(Mul, a * b)                       \
+    _(Div, a / b)                       \
+    _(Maximum, maximum(a, b))
+
+#define DISPATCHER_FORALL_UNARY_OPS(_) \
+    _(Neg, -a)                         \
+    _(Square, a * a)                   \
+    _(Relu, maximum(a, T(0.0f)))
+
+#define DISPATCHER_DEFINE_OP_ENUM(name, expr) name,
+
+enum class BinaryOp {
+    DISPATCHER_FORALL_BINARY_OPS(DISPATCHER_DEFINE_OP_ENUM)
+    NumOps
+};
+
+enum class UnaryOp {
+    DISPATCHER_FORALL_UNARY_OPS(DISPATCHER_DEFINE_OP_ENUM)
+    NumOps
+};
+
+#undef DISPATCHER_DEFINE_OP_ENUM
+
+constexpr size_t kNumBinaryOps = static_cast<size_t>(BinaryOp::NumOps);
+constexpr size_t kNumUnaryOps = static_cast<size_t>(UnaryOp::NumOps);
+
+const char* toString(BinaryOp op);
+const char* toString(UnaryOp op);
+
+// === CPU指令集 ===
+
+// 按能力从低到高排列；Default是不依赖扩展指令集的实现（aarch64上NEON是基础指令集，Default即NEON）
+enum class CpuCapability {
+    Default,
+    NEON,
+    AVX2,
+    AVX512,
+};
+
+const char* toString(CpuCapability capability);
+
+// 当前CPU和本次构建共同支持的最高指令集
+// 环境变量DISPATCHER_CPU_CAPABILITY（default/avx2/avx512）可以把它降低到指定级别
+CpuCapability detectCpuCapability();
+
+// 逐元素内核当前使用的指令集，第一次使用时按detectCpuCapability()选择
+CpuCapability cpuCapability();
+
+// 切换逐元素内核的指令集（例如对比不同实现），不支持的级别抛出异常
+void setCpuCapability(CpuCapability capability);
+
+// === 内核函数表 ===
+
+// 每个指令集一张表，按BinaryOp/UnaryOp索引；指针都按元素个数处理连续的float数组
+using BinaryKernelFn = void (*)(float* out, const float* a, const float* b, int64_t n);
+using BinaryScalarKernelFn = void (*)(float* out, const float* a, float b, int64_t n);
+using UnaryKernelFn = void (*)(float* out, const float* a, int64_t n);
+
+struct ElementwiseKernelTable {
+    CpuCapability capability;
+    size_t vector_width;  // 每条向量指令处理的float个数
+    std::array<BinaryKernelFn, kNumBinaryOps> binary;
+    std::array<BinaryScalarKernelFn, kNumBinaryOps> binary_scalar;
+    std::array<UnaryKernelFn, kNumUnaryOps> unary;
+};
+
+// 当前指令集的函数表
+const ElementwiseKernelTable& elementwiseKernels();
+
+} // namespace dispatcher
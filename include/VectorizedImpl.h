@@ -0,0 +1,252 @@
+#pragma once
+
+// 逐元素内核的实现模板，只由各指令集的实现文件包含
+// 包含前需要定义DISPATCHER_CPU_CAPABILITY（Default/AVX2/AVX512）以及对应的DISPATCHER_CPU_CAPABILITY_<名称>宏；
+// 所有定义都在匿名命名空间中，不同编译选项生成的代码不会在链接时互相替换
+
+#include "Vectorized.h"
+#include <cstdint>
+
+#if defined(DISPATCHER_CPU_CAPABILITY_AVX512) || defined(DISPATCHER_CPU_CAPABILITY_AVX2)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DISPATCHER_VEC_NEON 1
+#endif
+
+#define DISPATCHER_CONCAT_IMPL(a, b) a##b
+#define DISPATCHER_CONCAT(a, b) DISPATCHER_CONCAT_IMPL(a, b)
+
+namespace dispatcher {
+namespace {
+
+// === Vec - 一个SIMD寄存器宽度的float向量 ===
+// 提供load/store（对齐与非对齐）、四则运算、取负、maximum和从标量广播的构造
+
+#if defined(DISPATCHER_CPU_CAPABILITY_AVX512)
+
+struct Vec {
+    static constexpr int64_t kSize = 16;
+    static constexpr uintptr_t kAlignment = 64;
+    static constexpr CpuCapability kCapability = CpuCapability::AVX512;
+
+    __m512 v;
+
+    Vec(__m512 value) : v(value) {}
+    Vec(float value) : v(_mm512_set1_ps(value)) {}
+
+    static Vec load(const float* ptr) { return _mm512_load_ps(ptr); }
+    static Vec loadu(const float* ptr) { return _mm512_loadu_ps(ptr); }
+    void store(float* ptr) const { _mm512_store_ps(ptr, v); }
+    void storeu(float* ptr) const { _mm512_storeu_ps(ptr, v); }
+};
+
+inline Vec operator+(const Vec& a, const Vec& b) { return _mm512_add_ps(a.v, b.v); }
+inline Vec operator-(const Vec& a, const Vec& b) { return _mm512_sub_ps(a.v, b.v); }
+inline Vec operator*(const Vec& a, const Vec& b) { return _mm512_mul_ps(a.v, b.v); }
+inline Vec operator/(const Vec& a, const Vec& b) { return _mm512_div_ps(a.v, b.v); }
+inline Vec operator-(const Vec& a) { return _mm512_sub_ps(_mm512_setzero_ps(), a.v); }
+inline Vec maximum(const Vec& a, const Vec& b) { return _mm512_max_ps(a.v, b.v); }
+
+#elif defined(DISPATCHER_CPU_CAPABILITY_AVX2)
+
+struct Vec {
+    static constexpr int64_t kSize = 8;
+    static constexpr uintptr_t kAlignment = 32;
+    static constexpr CpuCapability kCapability = CpuCapability::AVX2;
+
+    __m256 v;
+
+    Vec(__m256 value) : v(value) {}
+    Vec(float value) : v(_mm256_set1_ps(value)) {}
+
+    static Vec load(const float* ptr) { return _mm256_load_ps(ptr); }
+    static Vec loadu(const float* ptr) { return _mm256_loadu_ps(ptr); }
+    void store(float* ptr) const { _mm256_store_ps(ptr, v); }
+    void storeu(float* ptr) const { _mm256_storeu_ps(ptr, v); }
+};
+
+inline Vec operator+(const Vec& a, const Vec& b) { return _mm256_add_ps(a.v, b.v); }
+inline Vec operator-(const Vec& a, const Vec& b) { return _mm256_sub_ps(a.v, b.v); }
+inline Vec operator*(const Vec& a, const Vec& b) { return _mm256_mul_ps(a.v, b.v); }
+inline Vec operator/(const Vec& a, const Vec& b) { return _mm256_div_ps(a.v, b.v); }
+inline Vec operator-(const Vec& a) { return _mm256_sub_ps(_mm256_setzero_ps(), a.v); }
+inline Vec maximum(const Vec& a, const Vec& b) { return _mm256_max_ps(a.v, b.v); }
+
+#elif defined(DISPATCHER_VEC_NEON)
+
+struct Vec {
+    static constexpr int64_t kSize = 4;
+    static constexpr uintptr_t kAlignment = 16;
+    static constexpr CpuCapability kCapability = CpuCapability::NEON;
+
+    float32x4_t v;
+
+    Vec(float32x4_t value) : v(value) {}
+    Vec(float value) : v(vdupq_n_f32(value)) {}
+
+    // NEON的load/store不区分对齐
+    static Vec load(const float* ptr) { return vld1q_f32(ptr); }
+    static Vec loadu(const float* ptr) { return vld1q_f32(ptr); }
+    void store(float* ptr) const { vst1q_f32(ptr, v); }
+    void storeu(float* ptr) const { vst1q_f32(ptr, v); }
+};
+
+inline Vec operator+(const Vec& a, const Vec& b) { return vaddq_f32(a.v, b.v); }
+inline Vec operator-(const Vec& a, const Vec& b) { return vsubq_f32(a.v, b.v); }
+inline Vec operator*(const Vec& a, const Vec& b) { return vmulq_f32(a.v, b.v); }
+inline Vec operator/(const Vec& a, const Vec& b) { return vdivq_f32(a.v, b.v); }
+inline Vec operator-(const Vec& a) { return vnegq_f32(a.v); }
+// 与标量版本一致：任一操作数为NaN时返回b
+inline Vec maximum(const Vec& a, const Vec& b) { return vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v); }
+
+#else
+
+// 不依赖扩展指令集的实现：固定长度的循环，由编译器按基础指令集自动向量化
+struct Vec {
+    static constexpr int64_t kSize = 4;
+    static constexpr uintptr_t kAlignment = 16;
+    static constexpr CpuCapability kCapability = CpuCapability::Default;
+
+    float v[kSize];
+
+    Vec() = default;
+    Vec(float value) {
+        for (int64_t i = 0; i < kSize; ++i) v[i] = value;
+    }
+
+    static Vec load(const float* ptr) { return loadu(ptr); }
+    static Vec loadu(const float* ptr) {
+        Vec result;
+        for (int64_t i = 0; i < kSize; ++i) result.v[i] = ptr[i];
+        return result;
+    }
+    void store(float* ptr) const { storeu(ptr); }
+    void storeu(float* ptr) const {
+        for (int64_t i = 0; i < kSize; ++i) ptr[i] = v[i];
+    }
+};
+
+template<typename F>
+inline Vec mapVec(const Vec& a, const Vec& b, F f) {
+    Vec result;
+    for (int64_t i = 0; i < Vec::kSize; ++i) result.v[i] = f(a.v[i], b.v[i]);
+    return result;
+}
+
+inline Vec operator+(const Vec& a, const Vec& b) { return mapVec(a, b, [](float x, float y) { return x + y; }); }
+inline Vec operator-(const Vec& a, const Vec& b) { return mapVec(a, b, [](float x, float y) { return x - y; }); }
+inline Vec operator*(const Vec& a, const Vec& b) { return mapVec(a, b, [](float x, float y) { return x * y; }); }
+inline Vec operator/(const Vec& a, const Vec& b) { return mapVec(a, b, [](float x, float y) { return x / y; }); }
+inline Vec operator-(const Vec& a) { return Vec(0.0f) - a; }
+inline Vec maximum(const Vec& a, const Vec& b) { return mapVec(a, b, [](float x, float y) { return x > y ? x : y; }); }
+
+#endif
+
+// 标量版本，处理不足一个向量的尾部；语义与向量版本一致（任一操作数为NaN时返回b）
+inline float maximum(float a, float b) { return a > b ? a : b; }
+
+inline bool isAligned(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % Vec::kAlignment == 0;
+}
+
+// === 由运算列表生成的函数对象 ===
+
+#define DISPATCHER_DEFINE_BINARY_FUNCTOR(name, expr)              \
+    struct name##Op {                                             \
+        template<typename T>                                      \
+        T operator()(const T& a, const T& b) const { return expr; } \
+    };
+DISPATCHER_FORALL_BINARY_OPS(DISPATCHER_DEFINE_BINARY_FUNCTOR)
+#undef DISPATCHER_DEFINE_BINARY_FUNCTOR
+
+#define DISPATCHER_DEFINE_UNARY_FUNCTOR(name, expr)    \
+    struct name##Op {                                  \
+        template<typename T>                           \
+        T operator()(const T& a) const { return expr; } \
+    };
+DISPATCHER_FORALL_UNARY_OPS(DISPATCHER_DEFINE_UNARY_FUNCTOR)
+#undef DISPATCHER_DEFINE_UNARY_FUNCTOR
+
+// === 通用的向量化循环 ===
+// 所有指针都对齐时使用对齐的load/store，否则使用非对齐版本；不足一个向量的尾部逐个处理
+
+template<typename Op>
+void binaryKernel(float* out, const float* a, const float* b, int64_t n) {
+    Op op;
+    int64_t i = 0;
+    if (isAligned(out) && isAligned(a) && isAligned(b)) {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::load(a + i), Vec::load(b + i)).store(out + i);
+        }
+    } else {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::loadu(a + i), Vec::loadu(b + i)).storeu(out + i);
+        }
+    }
+    for (; i < n; ++i) {
+        out[i] = op(a[i], b[i]);
+    }
+}
+
+template<typename Op>
+void binaryScalarKernel(float* out, const float* a, float b, int64_t n) {
+    Op op;
+    const Vec vb(b);
+    int64_t i = 0;
+    if (isAligned(out) && isAligned(a)) {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::load(a + i), vb).store(out + i);
+        }
+    } else {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::loadu(a + i), vb).storeu(out + i);
+        }
+    }
+    for (; i < n; ++i) {
+        out[i] = op(a[i], b);
+    }
+}
+
+template<typename Op>
+void unaryKernel(float* out, const float* a, int64_t n) {
+    Op op;
+    int64_t i = 0;
+    if (isAligned(out) && isAligned(a)) {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::load(a + i)).store(out + i);
+        }
+    } else {
+        for (; i + Vec::kSize <= n; i += Vec::kSize) {
+            op(Vec::loadu(a + i)).storeu(out + i);
+        }
+    }
+    for (; i < n; ++i) {
+        out[i] = op(a[i]);
+    }
+}
+
+} // namespace
+
+namespace detail {
+
+// 本指令集的函数表，由ElementwiseKernels.cpp按检测结果选择
+const ElementwiseKernelTable& DISPATCHER_CONCAT(elementwiseKernels, DISPATCHER_CPU_CAPABILITY)() {
+#define DISPATCHER_BINARY_ENTRY(name, expr) &binaryKernel<name##Op>,
+#define DISPATCHER_BINARY_SCALAR_ENTRY(name, expr) &binaryScalarKernel<name##Op>,
+#define DISPATCHER_UNARY_ENTRY(name, expr) &unaryKernel<name##Op>,
+    static constexpr ElementwiseKernelTable table = {
+        Vec::kCapability,
+        static_cast<size_t>(Vec::kSize),
+        {{DISPATCHER_FORALL_BINARY_OPS(DISPATCHER_BINARY_ENTRY)}},
+        {{DISPATCHER_FORALL_BINARY_OPS(DISPATCHER_BINARY_SCALAR_ENTRY)}},
+        {{DISPATCHER_FORALL_UNARY_OPS(DISPATCHER_UNARY_ENTRY)}},
+    };
+#undef DISPATCHER_BINARY_ENTRY
+#undef DISPATCHER_BINARY_SCALAR_ENTRY
+#undef DISPATCHER_UNARY_ENTRY
+    return table;
+}
+
+} // namespace detail
+} // namespace dispatcher
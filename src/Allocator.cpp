@@ -0,0 +1,149 @@
+#include "Allocator.h"
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+namespace dispatcher {
+
+// === CachingAllocator ===
+
+CachingAllocator::CachingAllocator(std::string name) : name_(std::move(name)) {}
+
+CachingAllocator::~CachingAllocator() {
+    emptyCache();
+}
+
+size_t CachingAllocator::roundSize(size_t nbytes) {
+    if (nbytes <= kMinBlockSize) {
+        return kMinBlockSize;
+    }
+    if (nbytes > kMaxCachedSize) {
+        return (nbytes + kAllocatorAlignment - 1) / kAllocatorAlignment * kAllocatorAlignment;
+    }
+    // 向上取整到2的幂
+    return size_t(1) << (64 - __builtin_clzll(static_cast<unsigned long long>(nbytes - 1)));
+}
+
+size_t CachingAllocator::sizeClassOf(size_t block_size) {
+    // block_size是[kMinBlockSize, kMaxCachedSize]范围内的2的幂
+    return static_cast<size_t>(__builtin_ctzll(block_size) - __builtin_ctzll(kMinBlockSize));
+}
+
+void* CachingAllocator::systemAllocate(size_t block_size) {
+    return ::operator new(block_size, std::align_val_t(kAllocatorAlignment));
+}
+
+void CachingAllocator::systemFree(void* ptr) {
+    ::operator delete(ptr, std::align_val_t(kAllocatorAlignment));
+}
+
+void* CachingAllocator::allocate(size_t nbytes) {
+    if (nbytes == 0) {
+        return nullptr;
+    }
+    size_t block_size = roundSize(nbytes);
+    bool cacheable = block_size <= kMaxCachedSize;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.num_allocs;
+        stats_.allocated_bytes += block_size;
+        if (stats_.allocated_bytes > stats_.peak_bytes) {
+            stats_.peak_bytes = stats_.allocated_bytes;
+        }
+        if (cacheable) {
+            auto& free_list = free_blocks_[sizeClassOf(block_size)];
+            if (!free_list.empty()) {
+                void* ptr = free_list.back();
+                free_list.pop_back();
+                stats_.cached_bytes -= block_size;
+                ++stats_.num_cache_hits;
+                return ptr;
+            }
+        }
+    }
+
+    // 缓存未命中：在锁外向系统申请
+    try {
+        return systemAllocate(block_size);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.allocated_bytes -= block_size;
+        throw;
+    }
+}
+
+void CachingAllocator::deallocate(void* ptr, size_t nbytes) {
+    if (!ptr) {
+        return;
+    }
+    size_t block_size = roundSize(nbytes);
+    if (block_size > kMaxCachedSize) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.allocated_bytes -= block_size;
+        }
+        systemFree(ptr);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.allocated_bytes -= block_size;
+    stats_.cached_bytes += block_size;
+    free_blocks_[sizeClassOf(block_size)].push_back(ptr);
+}
+
+AllocatorStats CachingAllocator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void CachingAllocator::resetPeakStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.peak_bytes = stats_.allocated_bytes;
+}
+
+void CachingAllocator::emptyCache() {
+    std::array<std::vector<void*>, kNumSizeClasses> blocks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        blocks.swap(free_blocks_);
+        stats_.cached_bytes = 0;
+    }
+    for (auto& free_list : blocks) {
+        for (void* ptr : free_list) {
+            systemFree(ptr);
+        }
+    }
+}
+
+// === 分配器注册表 ===
+
+static constexpr size_t kNumAllocatorSlots = static_cast<size_t>(DispatchKey::NumDispatchKeys);
+
+static std::array<std::atomic<Allocator*>, kNumAllocatorSlots>& allocatorSlots() {
+    static std::array<std::atomic<Allocator*>, kNumAllocatorSlots> slots{};
+    return slots;
+}
+
+static Allocator* defaultAllocator(DispatchKey backend) {
+    // 默认分配器有意不析构：程序退出时仍可能有静态对象持有的Storage需要归还内存
+    static CachingAllocator* cpu_allocator = new CachingAllocator("CPU");
+    static CachingAllocator* cuda_allocator = new CachingAllocator("CUDA (simulated)");
+    return backend == DispatchKey::CUDA ? cuda_allocator : cpu_allocator;
+}
+
+Allocator* getAllocator(DispatchKey backend) {
+    Allocator* allocator = allocatorSlots()[static_cast<size_t>(backend)].load(std::memory_order_acquire);
+    return allocator ? allocator : defaultAllocator(backend);
+}
+
+void setAllocator(DispatchKey backend, Allocator* allocator) {
+    if (!isBackendKey(backend)) {
+        throw std::runtime_error("Allocators can only be set for backend keys, got " +
+                                 std::string(toString(backend)));
+    }
+    allocatorSlots()[static_cast<size_t>(backend)].store(allocator, std::memory_order_release);
+}
+
+} // namespace dispatcher
@@ -0,0 +1,357 @@
+#include "Autograd.h"
+#include "Dispatcher.h"
+#include "ElementwiseKernels.h"
+#include "Executor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace dispatcher {
+
+// === AutogradGraph ===
+
+AutogradGraph::AutogradGraph() {
+    arenas_.emplace_back();
+}
+
+AutogradGraph::~AutogradGraph() {
+    AutogradTape::instance().live_nodes_.fetch_sub(num_nodes_, std::memory_order_relaxed);
+}
+
+// === AutogradTape ===
+
+AutogradTape& AutogradTape::instance() {
+    // 有意不析构：执行器的工作线程可能在静态对象析构之后仍在运行Autograd内核
+    static AutogradTape* instance = new AutogradTape();
+    return *instance;
+}
+
+std::shared_ptr<AutogradGraph> AutogradTape::graphOfLocked(const Tensor& tensor) {
+    std::shared_ptr<AutogradGraph> graph = tensor->autogradGraph();
+    while (graph && graph->merged_into_) {
+        graph = graph->merged_into_;
+    }
+    return graph;
+}
+
+void AutogradTape::mergeLocked(const std::shared_ptr<AutogradGraph>& target, AutogradGraph& source) {
+    // Arena的块和保存的tensor数组整体移交，节点与saved的地址不变
+    for (Arena& arena : source.arenas_) {
+        target->arenas_.push_back(std::move(arena));
+    }
+    source.arenas_.clear();
+    for (auto& saved : source.saved_) {
+        target->saved_.push_back(std::move(saved));
+    }
+    source.saved_.clear();
+    target->leaves_.insert(target->leaves_.end(), source.leaves_.begin(), source.leaves_.end());
+    source.leaves_.clear();
+    target->num_nodes_ += source.num_nodes_;
+    source.num_nodes_ = 0;
+    source.merged_into_ = target;
+}
+
+// 保存的tensor与原tensor共享Storage但不带grad_fn，避免图通过它持有自己
+static Tensor detachForSave(const Tensor& tensor) {
+    if (!tensor || !tensor->gradFn()) {
+        return tensor;
+    }
+    return make_intrusive<TensorImpl>(tensor->storage(), tensor->sizes(), tensor->strides(), tensor->storageOffset(),
+                                      tensor->backendKey());
+}
+
+AutogradNode* AutogradTape::record(const char* name, BackwardFunction backward, ArrayRef<Tensor> inputs,
+                                   const Tensor& output, ArrayRef<Tensor> saved, IntArrayRef args) {
+    bool needs_grad = std::any_of(inputs.begin(), inputs.end(),
+                                  [](const Tensor& input) { return input && input->requiresGrad(); });
+    if (!needs_grad || !output) {
+        return nullptr;
+    }
+
+    // 锁外准备保存的tensor
+    std::unique_ptr<Tensor[]> saved_tensors;
+    if (!saved.empty()) {
+        saved_tensors = std::make_unique<Tensor[]>(saved.size());
+        for (size_t i = 0; i < saved.size(); ++i) {
+            saved_tensors[i] = detachForSave(saved[i]);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // 节点放进第一个带grad_fn的输入所在的图，其余输入的图合并进来；所有输入都是叶子时新建一个图
+    std::shared_ptr<AutogradGraph> graph;
+    for (const Tensor& input : inputs) {
+        if (!input || !input->requiresGrad() || !input->gradFn()) {
+            continue;
+        }
+        std::shared_ptr<AutogradGraph> input_graph = graphOfLocked(input);
+        if (!graph) {
+            graph = std::move(input_graph);
+        } else if (input_graph != graph) {
+            mergeLocked(graph, *input_graph);
+        }
+    }
+    if (!graph) {
+        graph = std::make_shared<AutogradGraph>();
+    }
+
+    Arena& arena = graph->arenas_.front();
+    AutogradNode* node = arena.create<AutogradNode>();
+    node->name = name;
+    node->backward = backward;
+    node->inputs = arena.allocateArray<AutogradEdge>(inputs.size());
+    node->num_inputs = static_cast<uint32_t>(inputs.size());
+    node->num_saved = static_cast<uint32_t>(saved.size());
+    node->saved = saved_tensors.get();
+    int64_t* node_args = arena.allocateArray<int64_t>(args.size());
+    std::copy(args.begin(), args.end(), node_args);
+    node->args = node_args;
+    node->num_args = static_cast<uint32_t>(args.size());
+    node->device = output->backendKey();
+    if (saved_tensors) {
+        graph->saved_.push_back(std::move(saved_tensors));
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const Tensor& input = inputs[i];
+        if (!input || !input->requiresGrad()) {
+            continue;
+        }
+        if (AutogradNode* grad_fn = input->gradFn()) {
+            node->inputs[i].node = grad_fn;
+        } else {
+            node->inputs[i].leaf = input.get();
+            graph->leaves_.push_back(input);
+        }
+    }
+    ++graph->num_nodes_;
+    live_nodes_.fetch_add(1, std::memory_order_relaxed);
+
+    output->setGradFn(node, std::move(graph));
+    output->setRequiresGrad(true);
+    return node;
+}
+
+// === 反向执行 ===
+
+namespace {
+
+// 与grad同backend、同形状的新tensor
+Tensor makeLike(const Tensor& tensor) {
+    switch (tensor->backendKey()) {
+        case DispatchKey::CUDA: return make_tensor_cuda(tensor->sizes());
+        case DispatchKey::Meta: return make_tensor_meta(tensor->sizes());
+        default: return make_tensor_cpu(tensor->sizes());
+    }
+}
+
+Tensor onesLike(const Tensor& tensor) {
+    Tensor ones = makeLike(tensor);
+    if (float* data = ones->data()) {
+        std::fill(data, data + ones->numel(), 1.0f);
+    }
+    return ones;
+}
+
+// 梯度累加：CPU上逐元素相加；模拟的CUDA与Meta没有计算内核，与它们的add内核一样只产生同形状的结果
+Tensor accumulateGrad(const Tensor& sum, const Tensor& grad) {
+    if (!sum) {
+        return grad;
+    }
+    if (sum->is_cpu() && grad->is_cpu()) {
+        return binary_op(BinaryOp::Add, sum, grad);
+    }
+    return makeLike(sum);
+}
+
+// 每个节点在一次反向执行中的状态
+struct NodeTask {
+    std::mutex mutex;
+    Tensor grad;                              // 下游节点交来的梯度之和
+    std::atomic<uint32_t> dependencies{0};    // 尚未交出梯度的下游边数
+};
+
+// 一次backward()的共享状态，调用方线程等到所有节点结束后才返回，任务可以按引用访问
+struct GraphTask {
+    std::shared_ptr<AutogradGraph> graph;  // 反向执行期间保持节点有效
+    // 从root可达的节点及其状态；遍历完成后只读，各线程可以并发查找
+    std::unordered_map<const AutogradNode*, uint32_t> index;
+    std::unique_ptr<NodeTask[]> nodes;
+    std::shared_ptr<Executor> cpu_executor;
+    std::shared_ptr<Executor> cuda_executor;
+
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    size_t remaining = 0;  // 尚未结束的节点数
+    std::exception_ptr error;
+    std::atomic<bool> failed{false};
+
+    NodeTask& taskOf(const AutogradNode* node) { return nodes[index.find(node)->second]; }
+
+    // 把就绪的节点提交到它所在设备的执行器；提交失败时记录错误并在当前线程上完成该节点
+    void schedule(AutogradNode* node);
+    // 执行一个节点并把梯度交给下游；无论哪一步出错都会完成所有出边和finish()，保证remaining归零
+    void run(AutogradNode* node);
+    void fail(std::exception_ptr node_error);
+    void finish();
+};
+
+void GraphTask::schedule(AutogradNode* node) {
+    try {
+        Executor& executor = node->device == DispatchKey::CUDA ? *cuda_executor : *cpu_executor;
+        executor.submit([this, node]() { run(node); });
+    } catch (...) {
+        // 失败之后节点只传递依赖计数，不再计算，内联执行的递归深度不超过图的深度
+        fail(std::current_exception());
+        run(node);
+    }
+}
+
+void GraphTask::run(AutogradNode* node) {
+    // 反向函数内部的调用不再记录新的节点
+    ExcludeDispatchKeyGuard no_grad(DispatchKey::Autograd);
+
+    std::vector<Tensor> grad_inputs;
+    // 出错之后不再计算，但仍然按依赖完成剩余的节点
+    try {
+        Tensor grad = std::move(taskOf(node).grad);
+        if (grad && !failed.load(std::memory_order_relaxed)) {
+            grad_inputs.resize(node->num_inputs);
+            node->backward(*node, ArrayRef<Tensor>(node->saved, node->num_saved), grad, grad_inputs.data());
+        }
+    } catch (...) {
+        fail(std::current_exception());
+    }
+
+    for (uint32_t i = 0; i < node->num_inputs; ++i) {
+        const AutogradEdge& edge = node->inputs[i];
+        try {
+            Tensor grad_input;
+            if (i < grad_inputs.size() && !failed.load(std::memory_order_relaxed)) {
+                grad_input = std::move(grad_inputs[i]);
+            }
+            if (grad_input && edge.leaf) {
+                AutogradTape::instance().accumulateLeafGrad(*edge.leaf, grad_input);
+            } else if (grad_input && edge.node) {
+                NodeTask& next = taskOf(edge.node);
+                std::lock_guard<std::mutex> lock(next.mutex);
+                next.grad = accumulateGrad(next.grad, grad_input);
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        // 最后一条边交出梯度（或者出错）后next就绪
+        if (edge.node && taskOf(edge.node).dependencies.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            schedule(edge.node);
+        }
+    }
+    finish();
+}
+
+void GraphTask::fail(std::exception_ptr node_error) {
+    failed.store(true, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(done_mutex);
+    if (!error) {
+        error = node_error;
+    }
+}
+
+void GraphTask::finish() {
+    std::lock_guard<std::mutex> lock(done_mutex);
+    if (--remaining == 0) {
+        done_cv.notify_all();
+    }
+}
+
+} // namespace
+
+void AutogradTape::accumulateLeafGrad(TensorImpl& leaf, const Tensor& grad) {
+    std::lock_guard<std::mutex> lock(grad_mutex_);
+    leaf.setGrad(accumulateGrad(leaf.grad(), grad));
+}
+
+void backward(const Tensor& root, Tensor grad_output) {
+    if (!root) {
+        throw std::runtime_error("backward: root tensor为空");
+    }
+    if (!root->requiresGrad()) {
+        throw std::runtime_error("backward: root tensor不需要梯度，" + root->debugString());
+    }
+    if (!grad_output) {
+        grad_output = onesLike(root);
+    }
+
+    AutogradTape& tape = AutogradTape::instance();
+    GraphTask task;
+    AutogradNode* root_node;
+    {
+        // 只在读取root的图时持有记录锁，反向执行和等待都在锁外进行
+        std::lock_guard<std::mutex> lock(tape.mutex_);
+        root_node = root->gradFn();
+        if (root_node) {
+            task.graph = AutogradTape::graphOfLocked(root);
+        }
+    }
+    if (!root_node) {
+        // 叶子tensor：梯度直接累加到自身
+        tape.accumulateLeafGrad(*root, grad_output);
+        return;
+    }
+
+    task.cpu_executor = Dispatcher::instance().getExecutor(DispatchKey::CPU);
+    task.cuda_executor = Dispatcher::instance().getExecutor(DispatchKey::CUDA);
+
+    // 统计从root可达的节点，以及每个节点的入边数（同一节点作为多个输入时每条边各算一次）
+    // 节点记录之后不再修改，遍历与其他线程上的记录并发进行是安全的
+    std::vector<AutogradNode*> reachable = {root_node};
+    task.index.emplace(root_node, 0);
+    for (size_t i = 0; i < reachable.size(); ++i) {
+        AutogradNode* node = reachable[i];
+        for (uint32_t k = 0; k < node->num_inputs; ++k) {
+            AutogradNode* next = node->inputs[k].node;
+            if (next && task.index.emplace(next, static_cast<uint32_t>(reachable.size())).second) {
+                reachable.push_back(next);
+            }
+        }
+    }
+    task.nodes = std::make_unique<NodeTask[]>(reachable.size());
+    task.remaining = reachable.size();
+    for (AutogradNode* node : reachable) {
+        for (uint32_t k = 0; k < node->num_inputs; ++k) {
+            if (AutogradNode* next = node->inputs[k].node) {
+                task.taskOf(next).dependencies.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    task.taskOf(root_node).grad = std::move(grad_output);
+    task.schedule(root_node);
+    {
+        std::unique_lock<std::mutex> done_lock(task.done_mutex);
+        task.done_cv.wait(done_lock, [&task]() { return task.remaining == 0; });
+    }
+
+    // root与图断开；图中的其他输出仍然持有它，最后一个输出释放时图才释放
+    std::shared_ptr<AutogradGraph> released;
+    {
+        std::lock_guard<std::mutex> lock(tape.mutex_);
+        released = root->autogradGraph();
+        root->setGradFn(nullptr, nullptr);
+    }
+    task.graph.reset();
+    released.reset();
+    if (task.error) {
+        std::rethrow_exception(task.error);
+    }
+}
+
+void add_backward(const AutogradNode&, ArrayRef<Tensor>, const Tensor& grad_output, Tensor* grad_inputs) {
+    grad_inputs[0] = grad_output;
+    grad_inputs[1] = grad_output;
+}
+
+} // namespace dispatcher
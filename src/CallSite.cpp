@@ -0,0 +1,51 @@
+#include "CallSite.h"
+#include "Epoch.h"
+#include <stdexcept>
+
+namespace dispatcher {
+
+void OperatorCallSite::resolveOperator(uint64_t version) {
+    handle_ = Dispatcher::instance().findOperator(name_);
+    if (!handle_) {
+        throw std::runtime_error("Operator '" + name_.fullName() + "' is not registered");
+    }
+    schema_ = handle_->schema();
+    kernel_ = nullptr;
+    version_ = version;
+}
+
+void OperatorCallSite::callBoxed(Stack* stack) {
+    // 版本号在ReadGuard内读取：读到的版本没有变化时，缓存的句柄和内核所在的表都还没有被retire
+    EpochManager::ReadGuard guard;
+    uint64_t version = Dispatcher::dispatchVersion();
+    if (version != version_) {
+        resolveOperator(version);
+    }
+
+    DispatchKeySet ks = handle_->computeDispatchKeySet(*stack);
+    if (ks == ks_ && kernel_) {
+        ++hits_;
+    } else {
+        ++misses_;
+        kernel_ = handle_->findKernel(ks, &kernel_key_);
+        if (!kernel_) {
+            throw std::runtime_error("No kernel found for operator '" + handle_->name() +
+                                     "' with dispatch key set " + ks.toString());
+        }
+        ks_ = ks;
+    }
+
+    // 参数每次都不同，schema校验不能缓存
+    if (schema_ && !schema_->matches(*stack)) {
+        schema_->throwMismatch(handle_->name(), *stack);
+    }
+
+    handle_->callKernel(*kernel_, kernel_key_, ks, stack);
+
+    const Dispatcher& dispatcher = Dispatcher::instance();
+    if (dispatcher.isProfilingEnabled()) {
+        dispatcher.recordCall(handle_->id(), ks.highestPriorityKey());
+    }
+}
+
+} // namespace dispatcher
@@ -1,7 +1,6 @@
 #include "DispatchKeySet.h"
 #include "DispatchKey.h"
 #include <sstream>
-#include <algorithm>
 
 namespace dispatcher {
 
@@ -10,6 +9,7 @@ const char* toString(DispatchKey key) {
     switch (key) {
         case DispatchKey::CPU: return "CPU";
         case DispatchKey::CUDA: return "CUDA";
+        case DispatchKey::Meta: return "Meta";
         case DispatchKey::Autograd: return "Autograd";
         case DispatchKey::Tracing: return "Tracing";
         case DispatchKey::Profiling: return "Profiling";
@@ -28,6 +28,7 @@ uint8_t dispatchKeyPriority(DispatchKey key) {
         case DispatchKey::Profiling: return 2;   // 第三优先级 - profiling包装
         case DispatchKey::CPU: return 10;        // Backend实现
         case DispatchKey::CUDA: return 11;       // Backend实现
+        case DispatchKey::Meta: return 12;       // Backend实现 - 与真实backend混用时让位于它们
         case DispatchKey::CatchAll: return 100;  // 最低优先级 - 兜底实现
         case DispatchKey::Undefined: return 255; // 未定义，不应该被选中
         default: return 128;
@@ -35,7 +36,7 @@ uint8_t dispatchKeyPriority(DispatchKey key) {
 }
 
 bool isBackendKey(DispatchKey key) {
-    return key == DispatchKey::CPU || key == DispatchKey::CUDA;
+    return key == DispatchKey::CPU || key == DispatchKey::CUDA || key == DispatchKey::Meta;
 }
 
 bool isFunctionalityKey(DispatchKey key) {
@@ -43,120 +44,9 @@ bool isFunctionalityKey(DispatchKey key) {
 }
 
 // DispatchKeySet实现
-DispatchKeySet::DispatchKeySet(DispatchKey key) {
-    add(key);
-}
-
-DispatchKeySet::DispatchKeySet(std::initializer_list<DispatchKey> keys) {
-    for (auto key : keys) {
-        add(key);
-    }
-}
-
-DispatchKeySet& DispatchKeySet::add(DispatchKey key) {
-    raw_repr_.set(keyIndex(key));
-    return *this;
-}
-
-DispatchKeySet& DispatchKeySet::remove(DispatchKey key) {
-    raw_repr_.reset(keyIndex(key));
-    return *this;
-}
-
-bool DispatchKeySet::has(DispatchKey key) const {
-    return raw_repr_.test(keyIndex(key));
-}
-
-bool DispatchKeySet::empty() const {
-    return raw_repr_.none();
-}
-
-void DispatchKeySet::clear() {
-    raw_repr_.reset();
-}
-
-DispatchKey DispatchKeySet::highestPriorityKey() const {
-    if (empty()) {
-        return DispatchKey::Undefined;
-    }
-    
-    // 创建优先级排序的dispatch key列表
-    std::vector<DispatchKey> keys_by_priority;
-    for (int i = 0; i < static_cast<int>(DispatchKey::NumDispatchKeys); ++i) {
-        auto key = static_cast<DispatchKey>(i);
-        if (has(key)) {
-            keys_by_priority.push_back(key);
-        }
-    }
-    
-    // 按优先级排序（优先级数字小的在前）
-    std::sort(keys_by_priority.begin(), keys_by_priority.end(),
-              [](DispatchKey a, DispatchKey b) {
-                  return dispatchKeyPriority(a) < dispatchKeyPriority(b);
-              });
-    
-    return keys_by_priority.empty() ? DispatchKey::Undefined : keys_by_priority[0];
-}
-
-DispatchKeySet DispatchKeySet::operator|(const DispatchKeySet& other) const {
-    DispatchKeySet result = *this;
-    result |= other;
-    return result;
-}
-
-DispatchKeySet& DispatchKeySet::operator|=(const DispatchKeySet& other) {
-    raw_repr_ |= other.raw_repr_;
-    return *this;
-}
-
-DispatchKeySet DispatchKeySet::operator&(const DispatchKeySet& other) const {
-    DispatchKeySet result = *this;
-    result &= other;
-    return result;
-}
-
-DispatchKeySet& DispatchKeySet::operator&=(const DispatchKeySet& other) {
-    raw_repr_ &= other.raw_repr_;
-    return *this;
-}
-
-DispatchKeySet DispatchKeySet::operator-(const DispatchKeySet& other) const {
-    DispatchKeySet result = *this;
-    result -= other;
-    return result;
-}
-
-DispatchKeySet& DispatchKeySet::operator-=(const DispatchKeySet& other) {
-    raw_repr_ &= ~other.raw_repr_;
-    return *this;
-}
-
-bool DispatchKeySet::operator==(const DispatchKeySet& other) const {
-    return raw_repr_ == other.raw_repr_;
-}
-
-bool DispatchKeySet::operator!=(const DispatchKeySet& other) const {
-    return !(*this == other);
-}
-
 std::vector<DispatchKey> DispatchKeySet::toVector() const {
-    std::vector<DispatchKey> result;
-    
-    // 收集所有存在的dispatch key
-    for (int i = 0; i < static_cast<int>(DispatchKey::NumDispatchKeys); ++i) {
-        auto key = static_cast<DispatchKey>(i);
-        if (has(key)) {
-            result.push_back(key);
-        }
-    }
-    
-    // 按优先级排序
-    std::sort(result.begin(), result.end(),
-              [](DispatchKey a, DispatchKey b) {
-                  return dispatchKeyPriority(a) < dispatchKeyPriority(b);
-              });
-    
-    return result;
+    // 迭代器本身就按优先级顺序产生key，无需排序
+    return std::vector<DispatchKey>(begin(), end());
 }
 
 std::string DispatchKeySet::toString() const {
@@ -167,14 +57,26 @@ std::string DispatchKeySet::toString() const {
     std::ostringstream oss;
     oss << "{";
     
-    auto keys = toVector();
-    for (size_t i = 0; i < keys.size(); ++i) {
-        if (i > 0) oss << ", ";
-        oss << dispatcher::toString(keys[i]);
+    bool first = true;
+    for (auto key : *this) {
+        if (!first) oss << ", ";
+        oss << dispatcher::toString(key);
+        first = false;
     }
     
     oss << "}";
     return oss.str();
 }
 
-} // namespace dispatcher 
\ No newline at end of file
+// 位布局必须与dispatchKeyPriority的顺序一致
+static_assert(DispatchKeySet({DispatchKey::CPU, DispatchKey::Autograd}).highestPriorityKey() == DispatchKey::Autograd,
+              "functionality keys must outrank backend keys");
+static_assert(DispatchKeySet({DispatchKey::CUDA, DispatchKey::CatchAll}).highestPriorityKey() == DispatchKey::CUDA,
+              "backend keys must outrank CatchAll");
+static_assert(DispatchKeySet().highestPriorityKey() == DispatchKey::Undefined,
+              "empty set must map to Undefined");
+static_assert((DispatchKeySet({DispatchKey::Autograd, DispatchKey::Tracing, DispatchKey::CPU}) &
+               DispatchKeySet::keysBelow(DispatchKey::Autograd)) == DispatchKeySet({DispatchKey::Tracing, DispatchKey::CPU}),
+              "redispatch must drop the current key and everything above it");
+
+} // namespace dispatcher
@@ -1,17 +1,228 @@
 #include "Dispatcher.h"
+#include "Epoch.h"
+#include "LocalDispatchKeySet.h"
 #include <stdexcept>
 #include <sstream>
 #include <iostream>
 #include <mutex>
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 namespace dispatcher {
 
+static constexpr size_t kNumStatsKeys = static_cast<size_t>(DispatchKey::NumDispatchKeys);
+
+// CallStatsShard - 单个线程的调用计数
+// 计数按OperatorId分块惰性分配，块指针一旦发布就不再改变，合并时无需与写入线程同步
+struct Dispatcher::CallStatsShard {
+    static constexpr size_t kOpsPerChunk = 64;
+    static constexpr size_t kMaxChunks = 1024;  // 最多统计65536个操作符
+    
+    struct AtomicCounters {
+        std::atomic<uint64_t> calls;
+        std::array<std::atomic<uint64_t>, kNumStatsKeys> key_counts;
+        std::array<std::atomic<AtomicLatencyHistogram*>, kNumStatsKeys> latency;  // 第一次采样时分配
+    };
+    
+    struct Counters {
+        uint64_t calls = 0;
+        std::array<uint64_t, kNumStatsKeys> key_counts{};
+    };
+    
+    struct Chunk {
+        AtomicCounters ops[kOpsPerChunk];
+        
+        ~Chunk() {
+            for (auto& counters : ops) {
+                for (auto& histogram : counters.latency) {
+                    delete histogram.load();
+                }
+            }
+        }
+    };
+    
+    std::array<std::atomic<Chunk*>, kMaxChunks> chunks{};
+    std::atomic<bool> in_use{false};
+    
+    ~CallStatsShard() {
+        for (auto& chunk : chunks) {
+            delete chunk.load();
+        }
+    }
+    
+    // 获取某个操作符的计数，必要时分配所在的块（只由所属线程调用）
+    AtomicCounters* countersFor(OperatorId id) {
+        size_t chunk_index = id / kOpsPerChunk;
+        if (chunk_index >= kMaxChunks) {
+            return nullptr;
+        }
+        Chunk* chunk = chunks[chunk_index].load(std::memory_order_acquire);
+        if (!chunk) {
+            chunk = new Chunk();  // 值初始化，所有计数为0
+            chunks[chunk_index].store(chunk, std::memory_order_release);
+        }
+        return &chunk->ops[id % kOpsPerChunk];
+    }
+    
+    // 把本分片的计数累加到按ID索引的数组中
+    void mergeInto(std::vector<Counters>& merged) const {
+        for (size_t c = 0; c < kMaxChunks; ++c) {
+            const Chunk* chunk = chunks[c].load(std::memory_order_acquire);
+            if (!chunk) {
+                continue;
+            }
+            if (merged.size() < (c + 1) * kOpsPerChunk) {
+                merged.resize((c + 1) * kOpsPerChunk);
+            }
+            for (size_t i = 0; i < kOpsPerChunk; ++i) {
+                const AtomicCounters& src = chunk->ops[i];
+                Counters& dst = merged[c * kOpsPerChunk + i];
+                dst.calls += src.calls.load(std::memory_order_relaxed);
+                for (size_t k = 0; k < kNumStatsKeys; ++k) {
+                    dst.key_counts[k] += src.key_counts[k].load(std::memory_order_relaxed);
+                }
+            }
+        }
+    }
+    
+    // 把本分片的延迟直方图累加到按ID、DispatchKey索引的数组中
+    void mergeLatencyInto(std::vector<std::array<LatencyHistogram, kNumStatsKeys>>& merged) const {
+        for (size_t c = 0; c < kMaxChunks; ++c) {
+            const Chunk* chunk = chunks[c].load(std::memory_order_acquire);
+            if (!chunk) {
+                continue;
+            }
+            if (merged.size() < (c + 1) * kOpsPerChunk) {
+                merged.resize((c + 1) * kOpsPerChunk);
+            }
+            for (size_t i = 0; i < kOpsPerChunk; ++i) {
+                for (size_t k = 0; k < kNumStatsKeys; ++k) {
+                    const AtomicLatencyHistogram* histogram = chunk->ops[i].latency[k].load(std::memory_order_acquire);
+                    if (histogram) {
+                        histogram->mergeInto(merged[c * kOpsPerChunk + i][k]);
+                    }
+                }
+            }
+        }
+    }
+    
+    void reset() {
+        for (auto& chunk_ptr : chunks) {
+            Chunk* chunk = chunk_ptr.load(std::memory_order_acquire);
+            if (!chunk) {
+                continue;
+            }
+            for (auto& counters : chunk->ops) {
+                counters.calls.store(0, std::memory_order_relaxed);
+                for (auto& count : counters.key_counts) {
+                    count.store(0, std::memory_order_relaxed);
+                }
+                for (auto& histogram : counters.latency) {
+                    if (AtomicLatencyHistogram* h = histogram.load(std::memory_order_acquire)) {
+                        h->reset();
+                    }
+                }
+            }
+        }
+    }
+};
+
 // Dispatcher实现
+std::atomic<uint32_t> Dispatcher::latency_sample_period_{0};
+std::atomic<uint64_t> Dispatcher::dispatch_version_{0};
+
 Dispatcher& Dispatcher::instance() {
     static Dispatcher instance;
     return instance;
 }
 
+Dispatcher::Dispatcher() : snapshot_(new RegistrySnapshot()) {
+    // 确保EpochManager比Dispatcher更晚析构
+    EpochManager::instance();
+    loadStaticRegistrations();
+}
+
+void Dispatcher::loadStaticRegistrations() {
+    ArrayRef<StaticKernelEntry> entries = staticKernelEntries();
+    if (entries.empty()) {
+        return;
+    }
+    
+    // 排序后同一操作符的条目相邻，操作符ID按名称顺序分配，与链接顺序无关
+    static_kernels_.assign(entries.begin(), entries.end());
+    std::sort(static_kernels_.begin(), static_kernels_.end(), [](const StaticKernelEntry& a, const StaticKernelEntry& b) {
+        int by_name = std::strcmp(a.name, b.name);
+        if (by_name != 0) return by_name < 0;
+        int by_overload = std::strcmp(a.overload_name, b.overload_name);
+        if (by_overload != 0) return by_overload < 0;
+        return a.key < b.key;
+    });
+    
+    size_t num_ops = 0;
+    for (size_t i = 0; i < static_kernels_.size(); ++i) {
+        const StaticKernelEntry& entry = static_kernels_[i];
+        if (i == 0 || std::strcmp(entry.name, static_kernels_[i - 1].name) != 0 ||
+            std::strcmp(entry.overload_name, static_kernels_[i - 1].overload_name) != 0) {
+            ++num_ops;
+        } else if (entry.key == static_kernels_[i - 1].key) {
+            throw std::runtime_error("Operator '" + OperatorName(entry.name, entry.overload_name).fullName() +
+                                     "' has more than one static kernel for dispatch key " + toString(entry.key));
+        }
+    }
+    
+    // 构造期间没有其他线程能访问Dispatcher，一次建立完整的注册表和快照
+    operators_.reserve(num_ops);
+    interned_ids_.reserve(num_ops);
+    auto snapshot = std::make_unique<RegistrySnapshot>();
+    snapshot->by_name.reserve(num_ops);
+    snapshot->by_id.reserve(num_ops);
+    snapshot->names.reserve(num_ops);
+    for (size_t begin = 0; begin < static_kernels_.size();) {
+        size_t end = begin + 1;
+        while (end < static_kernels_.size() && std::strcmp(static_kernels_[end].name, static_kernels_[begin].name) == 0 &&
+               std::strcmp(static_kernels_[end].overload_name, static_kernels_[begin].overload_name) == 0) {
+            ++end;
+        }
+        OperatorName name(static_kernels_[begin].name, static_kernels_[begin].overload_name);
+        OperatorId id = internOperatorName(name);
+        auto handle = std::make_unique<OperatorHandle>(
+            name.fullName(), id, ArrayRef<StaticKernelEntry>(static_kernels_.data() + begin, end - begin));
+        snapshot->by_name.emplace(name, handle.get());
+        snapshot->by_id.push_back(handle.get());
+        snapshot->names.push_back(name);
+        operators_.emplace(std::move(name), std::move(handle));
+        begin = end;
+    }
+    delete snapshot_.exchange(snapshot.release(), std::memory_order_acq_rel);
+}
+
+Dispatcher::~Dispatcher() {
+    // 先停止执行器：剩余的异步调用执行完毕后工作线程才退出，此时操作符句柄仍然有效
+    for (auto& executor : executors_) {
+        executor.reset();
+    }
+    delete snapshot_.load();
+}
+
+void Dispatcher::publishSnapshot(const RegistrySnapshot* snapshot) {
+    // 注意：这个函数在持有锁的情况下被调用
+    const RegistrySnapshot* old = snapshot_.exchange(snapshot, std::memory_order_acq_rel);
+    bumpDispatchVersion();
+    EpochManager::instance().retire(old);
+}
+
+OperatorId Dispatcher::internOperatorName(const OperatorName& name) {
+    // 注意：这个函数在持有锁的情况下被调用
+    auto it = interned_ids_.find(name);
+    if (it != interned_ids_.end()) {
+        return it->second;
+    }
+    OperatorId id = static_cast<OperatorId>(interned_ids_.size());
+    interned_ids_.emplace(name, id);
+    return id;
+}
+
 OperatorHandle& Dispatcher::registerOperator(const OperatorName& name) {
     std::lock_guard<std::mutex> lock(registry_mutex_);
     
@@ -22,12 +233,23 @@ OperatorHandle& Dispatcher::registerOperator(const OperatorName& name) {
     }
     
     // 创建新的操作符句柄
-    auto handle = std::make_unique<OperatorHandle>(name.fullName());
+    OperatorId id = internOperatorName(name);
+    auto handle = std::make_unique<OperatorHandle>(name.fullName(), id);
     OperatorHandle& handle_ref = *handle;
     
     // 插入到注册表中
     operators_[name] = std::move(handle);
     
+    // 复制当前快照并发布包含新操作符的版本
+    auto snapshot = std::make_unique<RegistrySnapshot>(*currentSnapshot());
+    snapshot->by_name[name] = &handle_ref;
+    if (snapshot->by_id.size() <= id) {
+        snapshot->by_id.resize(id + 1, nullptr);
+        snapshot->names.resize(id + 1, name);
+    }
+    snapshot->by_id[id] = &handle_ref;
+    publishSnapshot(snapshot.release());
+    
     // 通知回调函数
     notifyRegistrationCallbacks(name, true);
     
@@ -35,17 +257,25 @@ OperatorHandle& Dispatcher::registerOperator(const OperatorName& name) {
 }
 
 OperatorHandle* Dispatcher::findOperator(const OperatorName& name) {
-    std::lock_guard<std::mutex> lock(registry_mutex_);
-    
-    auto it = operators_.find(name);
-    return (it != operators_.end()) ? it->second.get() : nullptr;
+    // 快照本身也可能被并发的注册/注销退休，读取期间必须处于临界区内
+    EpochManager::ReadGuard guard;
+    const RegistrySnapshot* snapshot = currentSnapshot();
+    auto it = snapshot->by_name.find(name);
+    return (it != snapshot->by_name.end()) ? it->second : nullptr;
 }
 
 const OperatorHandle* Dispatcher::findOperator(const OperatorName& name) const {
-    std::lock_guard<std::mutex> lock(registry_mutex_);
-    
-    auto it = operators_.find(name);
-    return (it != operators_.end()) ? it->second.get() : nullptr;
+    return const_cast<Dispatcher*>(this)->findOperator(name);
+}
+
+OperatorHandle* Dispatcher::findOperator(OperatorId id) {
+    EpochManager::ReadGuard guard;
+    const RegistrySnapshot* snapshot = currentSnapshot();
+    return id < snapshot->by_id.size() ? snapshot->by_id[id] : nullptr;
+}
+
+const OperatorHandle* Dispatcher::findOperator(OperatorId id) const {
+    return const_cast<Dispatcher*>(this)->findOperator(id);
 }
 
 void Dispatcher::deregisterOperator(const OperatorName& name) {
@@ -53,22 +283,34 @@ void Dispatcher::deregisterOperator(const OperatorName& name) {
     
     auto it = operators_.find(name);
     if (it != operators_.end()) {
+        std::unique_ptr<OperatorHandle> handle = std::move(it->second);
         operators_.erase(it);
+        
+        // 发布不包含该操作符的快照，ID保留给以后重新注册时使用
+        auto snapshot = std::make_unique<RegistrySnapshot>(*currentSnapshot());
+        snapshot->by_name.erase(name);
+        snapshot->by_id[handle->id()] = nullptr;
+        publishSnapshot(snapshot.release());
+        
+        // 可能仍有读者在旧快照中使用该句柄，延迟释放
+        EpochManager::instance().retire(handle.release());
+        
         // 通知回调函数
         notifyRegistrationCallbacks(name, false);
     }
 }
 
 bool Dispatcher::hasOperator(const OperatorName& name) const {
-    std::lock_guard<std::mutex> lock(registry_mutex_);
-    return operators_.find(name) != operators_.end();
+    // 只比较指针，不解引用句柄；ReadGuard由findOperator持有
+    return findOperator(name) != nullptr;
 }
 
 std::vector<OperatorName> Dispatcher::getAllOperatorNames() const {
-    std::lock_guard<std::mutex> lock(registry_mutex_);
+    EpochManager::ReadGuard guard;
+    const RegistrySnapshot* snapshot = currentSnapshot();
     
     std::vector<OperatorName> names;
-    for (const auto& entry : operators_) {
+    for (const auto& entry : snapshot->by_name) {
         names.push_back(entry.first);
     }
     
@@ -76,27 +318,21 @@ std::vector<OperatorName> Dispatcher::getAllOperatorNames() const {
 }
 
 IValueList Dispatcher::call(const OperatorName& name, const IValueList& args) const {
+    // 在epoch临界区内查找和调用，保证句柄不会被并发的注销释放
+    EpochManager::ReadGuard guard;
+    
     // 查找操作符
     const OperatorHandle* handle = findOperator(name);
     if (!handle) {
         throw std::runtime_error("Operator '" + name.fullName() + "' is not registered");
     }
     
-    // 调用操作符（让OperatorHandle计算dispatch key set）
-    auto result = handle->call(args);
-    
-    // 更新统计信息
-    if (profiling_enabled_) {
-        // 从参数计算dispatch key set以获取使用的key
-        auto ks = handle->computeDispatchKeySet(args);
-        auto key = ks.highestPriorityKey();
-        updateCallStats(name, key);
-    }
-    
-    return result;
+    return call(*handle, args);
 }
 
 IValueList Dispatcher::call(const OperatorName& name, const DispatchKeySet& ks, const IValueList& args) const {
+    EpochManager::ReadGuard guard;
+    
     // 查找操作符
     const OperatorHandle* handle = findOperator(name);
     if (!handle) {
@@ -107,8 +343,8 @@ IValueList Dispatcher::call(const OperatorName& name, const DispatchKeySet& ks,
     auto result = handle->call(ks, args);
     
     // 更新统计信息
-    if (profiling_enabled_) {
-        updateCallStats(name, ks.highestPriorityKey());
+    if (isProfilingEnabled()) {
+        updateCallStats(handle->id(), ks.highestPriorityKey());
     }
     
     return result;
@@ -118,6 +354,204 @@ IValueList Dispatcher::call(const std::string& name, const IValueList& args) con
     return call(OperatorName(name), args);
 }
 
+IValueList Dispatcher::call(OperatorId id, const IValueList& args) const {
+    EpochManager::ReadGuard guard;
+    
+    const OperatorHandle* handle = findOperator(id);
+    if (!handle) {
+        throw std::runtime_error("Operator id " + std::to_string(id) + " is not registered");
+    }
+    
+    return call(*handle, args);
+}
+
+IValueList Dispatcher::call(const OperatorHandle& handle, const IValueList& args) const {
+    // 兼容层：复制参数到新栈上调用，调用结束后栈即结果
+    Stack stack(args);
+    callBoxed(handle, &stack);
+    return stack;
+}
+
+void Dispatcher::callBoxed(const OperatorHandle& handle, Stack* stack) const {
+    EpochManager::ReadGuard guard;
+    
+    // 参数会在调用中被结果替换，先计算dispatch key set
+    auto ks = handle.computeDispatchKeySet(*stack);
+    handle.callBoxed(ks, stack);
+    
+    // 更新统计信息
+    if (isProfilingEnabled()) {
+        updateCallStats(handle.id(), ks.highestPriorityKey());
+    }
+}
+
+std::vector<IValueList> Dispatcher::callBatch(const OperatorHandle& handle, ArrayRef<IValueList> batch,
+                                              DispatchKeySet hint) const {
+    EpochManager::ReadGuard guard;
+    
+    auto results = handle.callBatch(batch, hint);
+    
+    // 更新统计信息：输入参数没有被修改，可以在调用后重新计算每个调用的key set
+    if (isProfilingEnabled()) {
+        if (!hint.empty()) {
+            updateCallStats(handle.id(), localDispatchKeySet().apply(hint).highestPriorityKey(), batch.size());
+        } else {
+            for (const IValueList& args : batch) {
+                updateCallStats(handle.id(), handle.computeDispatchKeySet(args).highestPriorityKey());
+            }
+        }
+    }
+    
+    return results;
+}
+
+void Dispatcher::callBoxed(OperatorId id, Stack* stack) const {
+    EpochManager::ReadGuard guard;
+    
+    const OperatorHandle* handle = findOperator(id);
+    if (!handle) {
+        throw std::runtime_error("Operator id " + std::to_string(id) + " is not registered");
+    }
+    
+    callBoxed(*handle, stack);
+}
+
+// 异步调用按key set中的backend选择执行器：与内核选择一致CPU优先于CUDA，没有backend时使用CPU
+static DispatchKey asyncBackendKey(DispatchKeySet ks) {
+    DispatchKey key = (ks & DispatchKeySet{DispatchKey::CPU, DispatchKey::CUDA}).highestPriorityKey();
+    return key == DispatchKey::Undefined ? DispatchKey::CPU : key;
+}
+
+DispatchFuture Dispatcher::callAsync(const OperatorName& name, IValueList args) const {
+    EpochManager::ReadGuard guard;
+    
+    const OperatorHandle* handle = findOperator(name);
+    if (!handle) {
+        throw std::runtime_error("Operator '" + name.fullName() + "' is not registered");
+    }
+    
+    return callAsync(*handle, std::move(args));
+}
+
+DispatchFuture Dispatcher::callAsync(OperatorId id, IValueList args) const {
+    EpochManager::ReadGuard guard;
+    
+    const OperatorHandle* handle = findOperator(id);
+    if (!handle) {
+        throw std::runtime_error("Operator id " + std::to_string(id) + " is not registered");
+    }
+    
+    return callAsync(*handle, std::move(args));
+}
+
+DispatchFuture Dispatcher::callAsync(const OperatorHandle& handle, IValueList args) const {
+    // host端的分发工作（计算key set、选择执行器）在调用方线程上完成，工作线程只执行内核
+    DispatchKeySet ks;
+    {
+        EpochManager::ReadGuard guard;
+        ks = handle.computeDispatchKeySet(args);
+    }
+    std::shared_ptr<Executor> executor = getExecutor(asyncBackendKey(ks));
+    
+    if (isProfilingEnabled()) {
+        updateCallStats(handle.id(), ks.highestPriorityKey());
+    }
+    
+    DispatchPromise promise;
+    DispatchFuture future = promise.getFuture();
+    LocalDispatchKeySet local = localDispatchKeySet();
+    
+    executor->submit([&handle, ks, local, promise, stack = std::move(args)]() mutable {
+        // 在工作线程上恢复调用方的局部key集合，内核内部的嵌套调用与同步调用时看到相同的状态
+        LocalDispatchKeySet saved = localDispatchKeySet();
+        localDispatchKeySet() = local;
+        try {
+            EpochManager::ReadGuard guard;
+            handle.callBoxed(ks, &stack);
+            localDispatchKeySet() = saved;
+            promise.setValue(std::move(stack));
+        } catch (...) {
+            localDispatchKeySet() = saved;
+            promise.setException(std::current_exception());
+        }
+    });
+    
+    return future;
+}
+
+std::shared_ptr<Executor> Dispatcher::getExecutor(DispatchKey backend) const {
+    std::lock_guard<std::mutex> lock(executor_mutex_);
+    auto& executor = executors_[static_cast<size_t>(backend)];
+    if (!executor) {
+        // 默认执行器：CUDA使用按顺序执行的队列模拟stream，其他backend使用工作窃取线程池
+        if (backend == DispatchKey::CUDA) {
+            executor = std::make_shared<SerialQueue>("CUDA stream");
+        } else {
+            executor = std::make_shared<ThreadPool>();
+        }
+    }
+    return executor;
+}
+
+void Dispatcher::setExecutor(DispatchKey backend, std::shared_ptr<Executor> executor) {
+    if (!isBackendKey(backend)) {
+        throw std::runtime_error("Executors can only be set for backend keys, got " + std::string(toString(backend)));
+    }
+    std::shared_ptr<Executor> old;
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex_);
+        old = std::move(executors_[static_cast<size_t>(backend)]);
+        executors_[static_cast<size_t>(backend)] = std::move(executor);
+    }
+    // 旧执行器在锁外析构，等待它已接收的任务执行完毕
+}
+
+void Dispatcher::synchronize(DispatchKey backend) const {
+    std::shared_ptr<Executor> executor;
+    {
+        std::lock_guard<std::mutex> lock(executor_mutex_);
+        executor = executors_[static_cast<size_t>(backend)];
+    }
+    // 从未提交过任务的backend没有执行器，无需等待
+    if (executor) {
+        executor->synchronize();
+    }
+}
+
+void Dispatcher::synchronize() const {
+    for (size_t i = 0; i < executors_.size(); ++i) {
+        synchronize(static_cast<DispatchKey>(i));
+    }
+}
+
+void Dispatcher::deregisterFallback(DispatchKey key) {
+    setFallback(key, KernelFunction());
+}
+
+bool Dispatcher::hasFallback(DispatchKey key) const {
+    std::lock_guard<std::mutex> lock(fallback_mutex_);
+    return fallbacks_[static_cast<size_t>(key)].isValid();
+}
+
+KernelFunctionTable Dispatcher::getFallbacks() const {
+    std::lock_guard<std::mutex> lock(fallback_mutex_);
+    return fallbacks_;
+}
+
+void Dispatcher::setFallback(DispatchKey key, KernelFunction fallback) {
+    {
+        std::lock_guard<std::mutex> lock(fallback_mutex_);
+        fallbacks_[static_cast<size_t>(key)] = std::move(fallback);
+    }
+    
+    // 重新发布所有操作符的dispatch table，发布时会读取最新的fallback；
+    // 与并发的内核注册交错时，后发布的一方总能看到最新的fallback
+    std::lock_guard<std::mutex> lock(registry_mutex_);
+    for (const auto& entry : operators_) {
+        entry.second->refreshFallbacks();
+    }
+}
+
 std::string Dispatcher::debugString() const {
     std::lock_guard<std::mutex> lock(registry_mutex_);
     
@@ -126,7 +560,11 @@ std::string Dispatcher::debugString() const {
     oss << "  Registered operators: " << operators_.size() << "\n";
     
     for (const auto& entry : operators_) {
-        oss << "  " << entry.first.fullName() << " {\n";
+        oss << "  " << entry.first.fullName();
+        if (const FunctionSchema* op_schema = entry.second->schema()) {
+            oss << op_schema->toString();
+        }
+        oss << " {\n";
         auto keys = entry.second->getRegisteredKeys();
         for (auto key : keys) {
             oss << "    " << toString(key) << "\n";
@@ -134,10 +572,20 @@ std::string Dispatcher::debugString() const {
         oss << "  }\n";
     }
     
-    if (profiling_enabled_) {
+    DispatchKeySet fallback_keys;
+    KernelFunctionTable fallbacks = getFallbacks();
+    for (size_t i = 0; i < fallbacks.size(); ++i) {
+        if (fallbacks[i].isValid()) {
+            fallback_keys.add(static_cast<DispatchKey>(i));
+        }
+    }
+    if (!fallback_keys.empty()) {
+        oss << "  Fallbacks: " << fallback_keys.toString() << "\n";
+    }
+    
+    if (isProfilingEnabled()) {
         oss << "\n  Call Statistics:\n";
-        std::lock_guard<std::mutex> stats_lock(stats_mutex_);
-        for (const auto& stat_entry : call_stats_) {
+        for (const auto& stat_entry : getCallStats()) {
             oss << "    " << stat_entry.first.fullName() 
                 << ": " << stat_entry.second.call_count << " calls\n";
             for (const auto& key_count : stat_entry.second.key_counts) {
@@ -147,6 +595,17 @@ std::string Dispatcher::debugString() const {
         }
     }
     
+    if (latencySamplingPeriod() != 0) {
+        oss << "\n  Latency (1/" << latencySamplingPeriod() << " sampled):\n";
+        for (const auto& latency_entry : getLatencyStats()) {
+            oss << "    " << latency_entry.first.fullName() << ":\n";
+            for (const auto& key_histogram : latency_entry.second.per_key) {
+                oss << "      " << toString(key_histogram.first)
+                    << ": " << key_histogram.second.toString() << "\n";
+            }
+        }
+    }
+    
     oss << "}";
     return oss.str();
 }
@@ -162,7 +621,39 @@ void Dispatcher::addRegistrationCallback(OperatorRegistrationCallback callback)
 
 void Dispatcher::resetCallStats() {
     std::lock_guard<std::mutex> lock(stats_mutex_);
-    call_stats_.clear();
+    for (const auto& shard : stats_shards_) {
+        shard->reset();
+    }
+}
+
+std::unordered_map<OperatorName, Dispatcher::CallStats> Dispatcher::getCallStats() const {
+    // 先在锁内把各分片合并到按ID索引的临时数组中
+    std::vector<CallStatsShard::Counters> merged;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (const auto& shard : stats_shards_) {
+            shard->mergeInto(merged);
+        }
+    }
+    
+    EpochManager::ReadGuard guard;
+    const RegistrySnapshot* snapshot = currentSnapshot();
+    
+    std::unordered_map<OperatorName, CallStats> result;
+    for (size_t id = 0; id < merged.size() && id < snapshot->names.size(); ++id) {
+        const auto& counters = merged[id];
+        if (counters.calls == 0) {
+            continue;
+        }
+        CallStats& stats = result[snapshot->names[id]];
+        stats.call_count = counters.calls;
+        for (size_t k = 0; k < kNumStatsKeys; ++k) {
+            if (counters.key_counts[k] != 0) {
+                stats.key_counts[static_cast<DispatchKey>(k)] = counters.key_counts[k];
+            }
+        }
+    }
+    return result;
 }
 
 void Dispatcher::notifyRegistrationCallbacks(const OperatorName& name, bool registered) {
@@ -176,12 +667,80 @@ void Dispatcher::notifyRegistrationCallbacks(const OperatorName& name, bool regi
     }
 }
 
-void Dispatcher::updateCallStats(const OperatorName& name, DispatchKey key) const {
-    std::lock_guard<std::mutex> lock(stats_mutex_);
+std::unordered_map<OperatorName, Dispatcher::LatencyStats> Dispatcher::getLatencyStats() const {
+    std::vector<std::array<LatencyHistogram, kNumStatsKeys>> merged;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (const auto& shard : stats_shards_) {
+            shard->mergeLatencyInto(merged);
+        }
+    }
+    
+    EpochManager::ReadGuard guard;
+    const RegistrySnapshot* snapshot = currentSnapshot();
+    
+    std::unordered_map<OperatorName, LatencyStats> result;
+    for (size_t id = 0; id < merged.size() && id < snapshot->names.size(); ++id) {
+        for (size_t k = 0; k < kNumStatsKeys; ++k) {
+            if (merged[id][k].count() != 0) {
+                result[snapshot->names[id]].per_key[static_cast<DispatchKey>(k)] = merged[id][k];
+            }
+        }
+    }
+    return result;
+}
+
+Dispatcher::CallStatsShard& Dispatcher::localStatsShard() const {
+    // 线程退出时把分片标记为空闲，计数保留并可被新线程继续累加
+    struct LocalShard {
+        CallStatsShard* shard = nullptr;
+        ~LocalShard() {
+            if (shard) {
+                shard->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local LocalShard local;
     
-    auto& stats = call_stats_[name];
-    stats.call_count++;
-    stats.key_counts[key]++;
+    if (!local.shard) {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        for (const auto& shard : stats_shards_) {
+            if (!shard->in_use.load(std::memory_order_acquire)) {
+                local.shard = shard.get();
+                break;
+            }
+        }
+        if (!local.shard) {
+            stats_shards_.push_back(std::make_unique<CallStatsShard>());
+            local.shard = stats_shards_.back().get();
+        }
+        local.shard->in_use.store(true, std::memory_order_release);
+    }
+    return *local.shard;
+}
+
+void Dispatcher::updateCallStats(OperatorId id, DispatchKey key, size_t count) const {
+    // 只有分片的所属线程会写入，relaxed即可；读取方在合并时容忍轻微滞后
+    CallStatsShard::AtomicCounters* counters = localStatsShard().countersFor(id);
+    if (!counters) {
+        return;
+    }
+    counters->calls.fetch_add(count, std::memory_order_relaxed);
+    counters->key_counts[static_cast<size_t>(key)].fetch_add(count, std::memory_order_relaxed);
+}
+
+void Dispatcher::recordLatency(OperatorId id, DispatchKey key, uint64_t nanos) const {
+    CallStatsShard::AtomicCounters* counters = localStatsShard().countersFor(id);
+    if (!counters) {
+        return;
+    }
+    auto& slot = counters->latency[static_cast<size_t>(key)];
+    AtomicLatencyHistogram* histogram = slot.load(std::memory_order_relaxed);
+    if (!histogram) {
+        histogram = new AtomicLatencyHistogram();
+        slot.store(histogram, std::memory_order_release);
+    }
+    histogram->record(nanos);
 }
 
 // 全局便捷函数实现
@@ -209,4 +768,28 @@ IValueList callOp(const std::string& name, const IValueList& args) {
     return Dispatcher::instance().call(name, args);
 }
 
+IValueList callOp(OperatorId id, const IValueList& args) {
+    return Dispatcher::instance().call(id, args);
+}
+
+IValueList callOp(const OperatorHandle& handle, const IValueList& args) {
+    return Dispatcher::instance().call(handle, args);
+}
+
+DispatchFuture callOpAsync(const OperatorName& name, IValueList args) {
+    return Dispatcher::instance().callAsync(name, std::move(args));
+}
+
+DispatchFuture callOpAsync(const std::string& name, IValueList args) {
+    return Dispatcher::instance().callAsync(OperatorName(name), std::move(args));
+}
+
+DispatchFuture callOpAsync(OperatorId id, IValueList args) {
+    return Dispatcher::instance().callAsync(id, std::move(args));
+}
+
+DispatchFuture callOpAsync(const OperatorHandle& handle, IValueList args) {
+    return Dispatcher::instance().callAsync(handle, std::move(args));
+}
+
 } // namespace dispatcher 
\ No newline at end of file
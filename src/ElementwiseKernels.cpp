@@ -0,0 +1,367 @@
+#include "ElementwiseKernels.h"
+#include "Parallel.h"
+#include "Allocator.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace dispatcher {
+
+namespace detail {
+// 各指令集实现文件中定义的函数表，只声明本次构建包含的指令集
+const ElementwiseKernelTable& elementwiseKernelsDefault();
+#if DISPATCHER_HAVE_AVX2_KERNELS
+const ElementwiseKernelTable& elementwiseKernelsAVX2();
+#endif
+#if DISPATCHER_HAVE_AVX512_KERNELS
+const ElementwiseKernelTable& elementwiseKernelsAVX512();
+#endif
+} // namespace detail
+
+// === 名称 ===
+
+const char* toString(BinaryOp op) {
+#define DISPATCHER_OP_NAME(name, expr) \
+    case BinaryOp::name:               \
+        return #name;
+    switch (op) {
+        DISPATCHER_FORALL_BINARY_OPS(DISPATCHER_OP_NAME)
+        default:
+            return "Unknown";
+    }
+#undef DISPATCHER_OP_NAME
+}
+
+const char* toString(UnaryOp op) {
+#define DISPATCHER_OP_NAME(name, expr) \
+    case UnaryOp::name:                \
+        return #name;
+    switch (op) {
+        DISPATCHER_FORALL_UNARY_OPS(DISPATCHER_OP_NAME)
+        default:
+            return "Unknown";
+    }
+#undef DISPATCHER_OP_NAME
+}
+
+const char* toString(CpuCapability capability) {
+    switch (capability) {
+        case CpuCapability::Default: return "Default";
+        case CpuCapability::NEON: return "NEON";
+        case CpuCapability::AVX2: return "AVX2";
+        case CpuCapability::AVX512: return "AVX512";
+        default: return "Unknown";
+    }
+}
+
+// === 指令集检测 ===
+
+// CPU和本次构建共同支持的最高指令集，不考虑环境变量
+static CpuCapability hardwareCapability() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+#if DISPATCHER_HAVE_AVX512_KERNELS
+    if (__builtin_cpu_supports("avx512f")) {
+        return CpuCapability::AVX512;
+    }
+#endif
+#if DISPATCHER_HAVE_AVX2_KERNELS
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return CpuCapability::AVX2;
+    }
+#endif
+    return CpuCapability::Default;
+#elif defined(__ARM_NEON)
+    return CpuCapability::NEON;
+#else
+    return CpuCapability::Default;
+#endif
+}
+
+static bool isSupported(CpuCapability capability) {
+    CpuCapability hardware = hardwareCapability();
+    if (capability == CpuCapability::NEON || hardware == CpuCapability::NEON) {
+        // NEON与x86的指令集不可比较：只有NEON平台支持NEON，NEON平台上只有Default与之共存
+        return capability == CpuCapability::Default || capability == hardware;
+    }
+    return static_cast<int>(capability) <= static_cast<int>(hardware);
+}
+
+CpuCapability detectCpuCapability() {
+    CpuCapability hardware = hardwareCapability();
+    const char* env = std::getenv("DISPATCHER_CPU_CAPABILITY");
+    if (!env) {
+        return hardware;
+    }
+    std::string requested(env);
+    for (char& c : requested) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    CpuCapability capability = hardware;
+    if (requested == "default") {
+        capability = CpuCapability::Default;
+    } else if (requested == "avx2") {
+        capability = CpuCapability::AVX2;
+    } else if (requested == "avx512") {
+        capability = CpuCapability::AVX512;
+    }
+    // 只能降低，不能超过硬件支持的级别
+    return isSupported(capability) ? capability : hardware;
+}
+
+static const ElementwiseKernelTable& tableFor(CpuCapability capability) {
+    switch (capability) {
+#if DISPATCHER_HAVE_AVX512_KERNELS
+        case CpuCapability::AVX512:
+            return detail::elementwiseKernelsAVX512();
+#endif
+#if DISPATCHER_HAVE_AVX2_KERNELS
+        case CpuCapability::AVX2:
+            return detail::elementwiseKernelsAVX2();
+#endif
+        default:
+            // NEON平台上Default实现文件本身就使用NEON
+            return detail::elementwiseKernelsDefault();
+    }
+}
+
+// 当前使用的函数表，第一次使用时按检测结果初始化
+static std::atomic<const ElementwiseKernelTable*>& currentTable() {
+    static std::atomic<const ElementwiseKernelTable*> table{&tableFor(detectCpuCapability())};
+    return table;
+}
+
+const ElementwiseKernelTable& elementwiseKernels() {
+    return *currentTable().load(std::memory_order_acquire);
+}
+
+CpuCapability cpuCapability() {
+    return elementwiseKernels().capability;
+}
+
+void setCpuCapability(CpuCapability capability) {
+    if (!isSupported(capability)) {
+        throw std::runtime_error(std::string("CPU capability ") + toString(capability) +
+                                 " is not supported on this machine or build");
+    }
+    currentTable().store(&tableFor(capability), std::memory_order_release);
+}
+
+// === Tensor级别的逐元素运算 ===
+
+// 按64字节块切分：分配器返回的数据按64字节对齐，每块的起点因此对所有指令集都是向量对齐的
+static constexpr int64_t kElementsPerBlock = static_cast<int64_t>(kAllocatorAlignment / TensorImpl::kElementSize);
+
+template<typename F>
+static void parallelForBlocks(int64_t numel, const F& fn) {
+    int64_t num_blocks = (numel + kElementsPerBlock - 1) / kElementsPerBlock;
+    int64_t grain = std::max<int64_t>(1, GlobalDispatchState::instance().parallelCutoff() / kElementsPerBlock);
+    parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        int64_t first = begin * kElementsPerBlock;
+        int64_t last = std::min(numel, end * kElementsPerBlock);
+        fn(first, last - first);
+    });
+}
+
+static void checkCpuTensor(const Tensor& tensor, const char* op_name) {
+    if (!tensor) {
+        throw std::runtime_error(std::string(op_name) + ": 输入tensor为空");
+    }
+    if (!tensor->is_cpu()) {
+        throw std::runtime_error(std::string(op_name) + ": 只支持CPU tensor，实际为 " + tensor->debugString());
+    }
+}
+
+// 内核按连续内存逐元素处理；视图（见TensorViews.h）先复制为连续tensor，连续的输入不复制
+static Tensor denseInput(const Tensor& tensor) {
+    return tensor->isContiguous() ? tensor : tensor->contiguous();
+}
+
+Tensor binary_op(BinaryOp op, const Tensor& a_in, const Tensor& b_in) {
+    checkCpuTensor(a_in, toString(op));
+    checkCpuTensor(b_in, toString(op));
+    Tensor a = denseInput(a_in);
+    Tensor b = denseInput(b_in);
+    if (a->numel() != b->numel()) {
+        throw std::runtime_error(std::string(toString(op)) + ": 元素数不匹配，" + a->debugString() +
+                                 " 与 " + b->debugString());
+    }
+    Tensor out = make_output_tensor(DispatchKey::CPU, a->sizes());
+    BinaryKernelFn kernel = elementwiseKernels().binary[static_cast<size_t>(op)];
+    float* out_data = out->data();
+    const float* a_data = a->data();
+    const float* b_data = b->data();
+    parallelForBlocks(out->numel(), [&](int64_t offset, int64_t n) {
+        kernel(out_data + offset, a_data + offset, b_data + offset, n);
+    });
+    return out;
+}
+
+Tensor binary_op(BinaryOp op, const Tensor& a_in, float scalar) {
+    checkCpuTensor(a_in, toString(op));
+    Tensor a = denseInput(a_in);
+    Tensor out = make_output_tensor(DispatchKey::CPU, a->sizes());
+    BinaryScalarKernelFn kernel = elementwiseKernels().binary_scalar[static_cast<size_t>(op)];
+    float* out_data = out->data();
+    const float* a_data = a->data();
+    parallelForBlocks(out->numel(), [&](int64_t offset, int64_t n) {
+        kernel(out_data + offset, a_data + offset, scalar, n);
+    });
+    return out;
+}
+
+Tensor unary_op(UnaryOp op, const Tensor& a_in) {
+    checkCpuTensor(a_in, toString(op));
+    Tensor a = denseInput(a_in);
+    Tensor out = make_output_tensor(DispatchKey::CPU, a->sizes());
+    UnaryKernelFn kernel = elementwiseKernels().unary[static_cast<size_t>(op)];
+    float* out_data = out->data();
+    const float* a_data = a->data();
+    parallelForBlocks(out->numel(), [&](int64_t offset, int64_t n) {
+        kernel(out_data + offset, a_data + offset, n);
+    });
+    return out;
+}
+
+// === 融合的逐元素表达式 ===
+
+static const char* infixSymbol(BinaryOp op) {
+    switch (op) {
+        case BinaryOp::Add: return "+";
+        case BinaryOp::Sub: return "-";
+        case BinaryOp::Mul: return "*";
+        case BinaryOp::Div: return "/";
+        default: return nullptr;
+    }
+}
+
+static std::string lowercase(const char* name) {
+    std::string result(name);
+    for (char& c : result) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return result;
+}
+
+std::string ElementwiseExpr::toString() const {
+    std::vector<std::string> registers;
+    for (size_t i = 0; i < num_inputs; ++i) {
+        registers.push_back("%" + std::to_string(i));
+    }
+    for (const ElementwiseInstruction& inst : instructions) {
+        std::ostringstream oss;
+        if (inst.kind == ElementwiseInstruction::Kind::Unary) {
+            if (inst.unary_op == UnaryOp::Neg) {
+                oss << "-" << registers[inst.lhs];
+            } else {
+                oss << lowercase(dispatcher::toString(inst.unary_op)) << "(" << registers[inst.lhs] << ")";
+            }
+        } else {
+            std::string rhs;
+            if (inst.kind == ElementwiseInstruction::Kind::Binary) {
+                rhs = registers[inst.rhs];
+            } else {
+                std::ostringstream scalar;
+                scalar << inst.scalar;
+                rhs = scalar.str();
+            }
+            if (const char* symbol = infixSymbol(inst.binary_op)) {
+                oss << "(" << registers[inst.lhs] << " " << symbol << " " << rhs << ")";
+            } else {
+                oss << lowercase(dispatcher::toString(inst.binary_op)) << "(" << registers[inst.lhs] << ", " << rhs << ")";
+            }
+        }
+        registers.push_back(oss.str());
+    }
+    return registers.empty() ? std::string() : registers.back();
+}
+
+// 每个小块的元素数：中间结果缓冲区合计几KB，计算过程中一直留在L1缓存里
+static constexpr int64_t kFusedTileElements = 512;
+
+Tensor fused_elementwise_op(const ElementwiseExpr& expr, const std::vector<Tensor>& inputs) {
+    if (expr.instructions.empty()) {
+        throw std::runtime_error("fused_elementwise_op: 表达式为空");
+    }
+    if (inputs.size() != expr.num_inputs) {
+        throw std::runtime_error("fused_elementwise_op: 期望 " + std::to_string(expr.num_inputs) +
+                                 " 个输入，实际得到 " + std::to_string(inputs.size()) + " 个");
+    }
+    // 每条指令只能读取输入和之前指令的结果
+    for (size_t i = 0; i < expr.instructions.size(); ++i) {
+        const ElementwiseInstruction& inst = expr.instructions[i];
+        size_t defined = expr.num_inputs + i;
+        if (inst.lhs >= defined || (inst.kind == ElementwiseInstruction::Kind::Binary && inst.rhs >= defined)) {
+            throw std::runtime_error("fused_elementwise_op: 第 " + std::to_string(i) + " 条指令引用了未定义的寄存器");
+        }
+    }
+    if (expr.shape_input >= expr.num_inputs) {
+        throw std::runtime_error("fused_elementwise_op: shape_input超出输入范围");
+    }
+    for (const Tensor& input : inputs) {
+        checkCpuTensor(input, "fused_elementwise_op");
+        if (input->numel() != inputs[expr.shape_input]->numel()) {
+            throw std::runtime_error("fused_elementwise_op: 元素数不匹配，" + input->debugString() + " 与 " +
+                                     inputs[expr.shape_input]->debugString());
+        }
+    }
+
+    Tensor out = make_output_tensor(DispatchKey::CPU, inputs[expr.shape_input]->sizes());
+    const ElementwiseKernelTable& kernels = elementwiseKernels();
+    std::vector<Tensor> dense_inputs;
+    std::vector<const float*> input_data;
+    dense_inputs.reserve(inputs.size());
+    input_data.reserve(inputs.size());
+    for (const Tensor& input : inputs) {
+        dense_inputs.push_back(denseInput(input));
+        input_data.push_back(dense_inputs.back()->data());
+    }
+    float* out_data = out->data();
+
+    const size_t num_temps = expr.instructions.size() - 1;
+    const size_t num_registers = expr.num_inputs + expr.instructions.size();
+    parallelForBlocks(out->numel(), [&](int64_t offset, int64_t n) {
+        // 每个并行块自己的中间结果缓冲区，来自缓存分配器，64字节对齐
+        Allocator* allocator = getAllocator(DispatchKey::CPU);
+        size_t scratch_bytes = num_temps * kFusedTileElements * TensorImpl::kElementSize;
+        float* scratch = scratch_bytes > 0 ? static_cast<float*>(allocator->allocate(scratch_bytes)) : nullptr;
+        std::vector<const float*> registers(num_registers);
+
+        for (int64_t tile = 0; tile < n; tile += kFusedTileElements) {
+            int64_t tile_n = std::min(kFusedTileElements, n - tile);
+            for (size_t i = 0; i < expr.num_inputs; ++i) {
+                registers[i] = input_data[i] + offset + tile;
+            }
+            for (size_t i = 0; i < expr.instructions.size(); ++i) {
+                const ElementwiseInstruction& inst = expr.instructions[i];
+                // 最后一条指令直接写入输出，其余写入中间缓冲区
+                float* dst = i == num_temps ? out_data + offset + tile : scratch + i * kFusedTileElements;
+                switch (inst.kind) {
+                    case ElementwiseInstruction::Kind::Binary:
+                        kernels.binary[static_cast<size_t>(inst.binary_op)](dst, registers[inst.lhs],
+                                                                            registers[inst.rhs], tile_n);
+                        break;
+                    case ElementwiseInstruction::Kind::BinaryScalar:
+                        kernels.binary_scalar[static_cast<size_t>(inst.binary_op)](dst, registers[inst.lhs],
+                                                                                   inst.scalar, tile_n);
+                        break;
+                    case ElementwiseInstruction::Kind::Unary:
+                        kernels.unary[static_cast<size_t>(inst.unary_op)](dst, registers[inst.lhs], tile_n);
+                        break;
+                }
+                registers[expr.num_inputs + i] = dst;
+            }
+        }
+
+        if (scratch) {
+            allocator->deallocate(scratch, scratch_bytes);
+        }
+    });
+    return out;
+}
+
+} // namespace dispatcher
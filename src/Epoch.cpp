@@ -0,0 +1,126 @@
+#include "Epoch.h"
+#include <algorithm>
+
+namespace dispatcher {
+
+// 每个线程的读侧状态：槽位和嵌套深度
+struct EpochThreadState {
+    EpochManager::Slot* slot = nullptr;
+    uint32_t depth = 0;
+    
+    ~EpochThreadState() {
+        if (slot) {
+            EpochManager::instance().releaseSlot(slot);
+        }
+    }
+};
+
+static thread_local EpochThreadState tls_epoch_state;
+
+EpochManager& EpochManager::instance() {
+    static EpochManager instance;
+    return instance;
+}
+
+EpochManager::~EpochManager() {
+    // 进程退出时已经没有读者，释放剩余的退休对象和槽位
+    for (const auto& entry : retired_) {
+        entry.deleter(entry.ptr);
+    }
+    Slot* slot = slots_head_.load();
+    while (slot) {
+        Slot* next = slot->next;
+        delete slot;
+        slot = next;
+    }
+}
+
+EpochManager::ReadGuard::ReadGuard() {
+    EpochThreadState& state = tls_epoch_state;
+    if (state.depth++ > 0) {
+        return;
+    }
+    if (!state.slot) {
+        state.slot = EpochManager::instance().acquireSlot();
+    }
+    // seq_cst保证：写者要么看到这个epoch，要么读者随后读到的是新快照
+    uint64_t epoch = EpochManager::instance().global_epoch_.load(std::memory_order_seq_cst);
+    state.slot->epoch.store(epoch, std::memory_order_seq_cst);
+}
+
+EpochManager::ReadGuard::~ReadGuard() {
+    EpochThreadState& state = tls_epoch_state;
+    if (--state.depth == 0) {
+        state.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+EpochManager::Slot* EpochManager::acquireSlot() {
+    // 优先复用已退出线程留下的槽位
+    for (Slot* slot = slots_head_.load(std::memory_order_acquire); slot; slot = slot->next) {
+        bool expected = false;
+        if (!slot->in_use.load(std::memory_order_relaxed) &&
+            slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return slot;
+        }
+    }
+    
+    Slot* slot = new Slot();
+    slot->in_use.store(true, std::memory_order_relaxed);
+    Slot* head = slots_head_.load(std::memory_order_relaxed);
+    do {
+        slot->next = head;
+    } while (!slots_head_.compare_exchange_weak(head, slot, std::memory_order_release, std::memory_order_relaxed));
+    return slot;
+}
+
+void EpochManager::releaseSlot(Slot* slot) {
+    slot->epoch.store(0, std::memory_order_release);
+    slot->in_use.store(false, std::memory_order_release);
+}
+
+void EpochManager::retire(const void* ptr, void (*deleter)(const void*)) {
+    std::vector<Retired> reclaimable;
+    {
+        std::lock_guard<std::mutex> lock(retire_mutex_);
+        // 之后进入临界区的读者拿到的epoch都大于这个值，不可能再看到ptr
+        uint64_t epoch = global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+        retired_.push_back({ptr, deleter, epoch});
+        reclaimable = takeReclaimableLocked();
+    }
+    // 在锁外执行deleter，允许被释放对象的析构函数再次退休其他对象
+    for (const auto& entry : reclaimable) {
+        entry.deleter(entry.ptr);
+    }
+}
+
+void EpochManager::collect() {
+    std::vector<Retired> reclaimable;
+    {
+        std::lock_guard<std::mutex> lock(retire_mutex_);
+        reclaimable = takeReclaimableLocked();
+    }
+    for (const auto& entry : reclaimable) {
+        entry.deleter(entry.ptr);
+    }
+}
+
+std::vector<EpochManager::Retired> EpochManager::takeReclaimableLocked() {
+    // 找出仍在临界区内的读者中最旧的epoch
+    uint64_t min_active = UINT64_MAX;
+    for (Slot* slot = slots_head_.load(std::memory_order_acquire); slot; slot = slot->next) {
+        uint64_t epoch = slot->epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0) {
+            min_active = std::min(min_active, epoch);
+        }
+    }
+    
+    // 退休epoch小于min_active的对象已经不可能被任何读者持有
+    auto it = std::partition(retired_.begin(), retired_.end(),
+                             [min_active](const Retired& entry) { return entry.epoch >= min_active; });
+    std::vector<Retired> reclaimable(it, retired_.end());
+    retired_.erase(it, retired_.end());
+    return reclaimable;
+}
+
+} // namespace dispatcher
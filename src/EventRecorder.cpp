@@ -0,0 +1,277 @@
+#include "EventRecorder.h"
+#include "Dispatcher.h"
+#include "Epoch.h"
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+
+namespace dispatcher {
+
+// 当前线程上正在执行的、已开始记录的内核数
+static thread_local uint8_t tls_event_depth = 0;
+
+EventRecorder& EventRecorder::instance() {
+    // 有意不析构：执行器的工作线程可能在静态对象析构之后才退出，退出时仍要归还缓冲区
+    static EventRecorder* instance = new EventRecorder();
+    return *instance;
+}
+
+EventRecorder::EventRecorder() : epoch_(std::chrono::steady_clock::now()) {}
+
+EventRecorder::Ring& EventRecorder::localRing() {
+    // 与调用统计的分片一样，线程退出时把缓冲区标记为空闲，未flush的事件保留
+    struct LocalRing {
+        Ring* ring = nullptr;
+        ~LocalRing() {
+            if (ring) {
+                ring->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local LocalRing local;
+
+    if (!local.ring) {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) {
+            bool expected = false;
+            if (ring->in_use.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                local.ring = ring.get();
+                break;
+            }
+        }
+        if (!local.ring) {
+            rings_.push_back(std::make_unique<Ring>());
+            local.ring = rings_.back().get();
+            local.ring->index = static_cast<uint32_t>(rings_.size() - 1);
+            local.ring->in_use.store(true, std::memory_order_release);
+        }
+    }
+    return *local.ring;
+}
+
+void EventRecorder::record(const DispatchEvent& event) {
+    Ring& ring = localRing();
+    uint64_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= kRingCapacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.events[head % kRingCapacity] = event;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+void EventRecorder::flush() {
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        rings.reserve(rings_.size());
+        for (const auto& ring : rings_) {
+            rings.push_back(ring.get());
+        }
+    }
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    for (Ring* ring : rings) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        for (uint64_t i = tail; i < head; ++i) {
+            appendLocked(RecordedEvent{ring->events[i % kRingCapacity], ring->index});
+        }
+        // 之后写者才可以覆盖这些位置
+        ring->tail.store(head, std::memory_order_release);
+    }
+    if (streaming_) {
+        stream_.flush();
+    }
+}
+
+void EventRecorder::startFlusher(std::chrono::milliseconds period) {
+    stopFlusher();
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        stop_flusher_ = false;
+    }
+    flusher_ = std::thread([this, period]() {
+        std::unique_lock<std::mutex> lock(flusher_mutex_);
+        while (!flusher_cv_.wait_for(lock, period, [this]() { return stop_flusher_; })) {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    });
+}
+
+void EventRecorder::stopFlusher() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mutex_);
+        stop_flusher_ = true;
+    }
+    flusher_cv_.notify_all();
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+}
+
+void EventRecorder::setMaxEvents(size_t max_events) {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    max_events_ = max_events;
+    while (flushed_.size() > max_events_) {
+        flushed_.pop_front();
+        ++evicted_;
+    }
+}
+
+size_t EventRecorder::maxEvents() const {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    return max_events_;
+}
+
+std::vector<RecordedEvent> EventRecorder::events() const {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    return std::vector<RecordedEvent>(flushed_.begin(), flushed_.end());
+}
+
+void EventRecorder::clear() {
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) {
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    flushed_.clear();
+    evicted_ = 0;
+    dropped_before_clear_ = dropped;
+}
+
+uint64_t EventRecorder::droppedEvents() const {
+    uint64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex_);
+        for (const auto& ring : rings_) {
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+    }
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    return dropped - dropped_before_clear_;
+}
+
+uint64_t EventRecorder::evictedEvents() const {
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    return evicted_;
+}
+
+// 操作符名称只需转义引号、反斜杠和控制字符
+static void writeJsonString(std::ostream& os, const std::string& value) {
+    os << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            os << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec
+               << std::setfill(' ');
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+static const char* const kChromeTraceHeader = "{\"traceEvents\":[";
+static const char* const kChromeTraceFooter = "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+// 写出一个"X"事件，first为false时先写分隔符；调用方需处于ReadGuard内
+static void writeChromeEvent(std::ostream& os, const RecordedEvent& recorded, bool first) {
+    const DispatchEvent& event = recorded.event;
+    const OperatorHandle* op = Dispatcher::instance().findOperator(static_cast<OperatorId>(event.op));
+    std::string name = op ? op->name() : "op#" + std::to_string(event.op);
+    os << (first ? "\n" : ",\n") << "{\"name\":";
+    writeJsonString(os, name);
+    os << ",\"cat\":\"" << toString(event.key) << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << recorded.thread
+       << std::fixed << std::setprecision(3) << ",\"ts\":" << event.start_ns / 1000.0
+       << ",\"dur\":" << (event.end_ns - event.start_ns) / 1000.0 << std::defaultfloat
+       << ",\"args\":{\"depth\":" << static_cast<int>(event.depth) << "}}";
+}
+
+void EventRecorder::appendLocked(const RecordedEvent& event) {
+    if (streaming_) {
+        EpochManager::ReadGuard guard;
+        writeChromeEvent(stream_, event, streamed_++ == 0);
+        return;
+    }
+    if (max_events_ == 0) {
+        ++evicted_;
+        return;
+    }
+    if (flushed_.size() >= max_events_) {
+        flushed_.pop_front();
+        ++evicted_;
+    }
+    flushed_.push_back(event);
+}
+
+void EventRecorder::writeChromeTrace(std::ostream& os) {
+    flush();
+    std::vector<RecordedEvent> recorded = events();
+
+    EpochManager::ReadGuard guard;
+    os << kChromeTraceHeader;
+    for (size_t i = 0; i < recorded.size(); ++i) {
+        writeChromeEvent(os, recorded[i], i == 0);
+    }
+    os << kChromeTraceFooter;
+}
+
+void EventRecorder::writeChromeTrace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        throw std::runtime_error("EventRecorder: 无法写入 " + path);
+    }
+    writeChromeTrace(file);
+}
+
+void EventRecorder::startStreaming(const std::string& path) {
+    stopStreaming();
+    // 开始之前的事件留在内存中，不写入新文件
+    flush();
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    stream_.open(path);
+    if (!stream_) {
+        stream_.clear();
+        throw std::runtime_error("EventRecorder: 无法写入 " + path);
+    }
+    stream_ << kChromeTraceHeader;
+    streaming_ = true;
+    streamed_ = 0;
+}
+
+void EventRecorder::stopStreaming() {
+    flush();
+    std::lock_guard<std::mutex> lock(flush_mutex_);
+    if (!streaming_) {
+        return;
+    }
+    stream_ << kChromeTraceFooter;
+    stream_.close();
+    streaming_ = false;
+}
+
+// === DispatchEventScope ===
+
+void DispatchEventScope::begin(uint32_t op, DispatchKey key) {
+    active_ = true;
+    event_.op = op;
+    event_.key = key;
+    event_.depth = tls_event_depth++;
+    event_.start_ns = EventRecorder::instance().nowNanos();
+}
+
+void DispatchEventScope::end() {
+    EventRecorder& recorder = EventRecorder::instance();
+    event_.end_ns = recorder.nowNanos();
+    --tls_event_depth;
+    recorder.record(event_);
+}
+
+} // namespace dispatcher
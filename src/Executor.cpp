@@ -0,0 +1,202 @@
+#include "Executor.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace dispatcher {
+
+// === Executor ===
+
+void Executor::submit(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        ++pending_;
+    }
+    enqueue(std::move(task));
+}
+
+void Executor::run(Task& task) {
+    task();
+    // 任务执行完毕后才减少计数，synchronize()返回时所有任务的副作用都已可见
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (--pending_ == 0) {
+        pending_cv_.notify_all();
+    }
+}
+
+void Executor::synchronize() {
+    std::unique_lock<std::mutex> lock(pending_mutex_);
+    pending_cv_.wait(lock, [this]() { return pending_ == 0; });
+}
+
+// === SerialQueue ===
+
+SerialQueue::SerialQueue(std::string name) : name_(std::move(name)) {
+    // 所有成员初始化完成后再启动工作线程
+    worker_ = std::thread(&SerialQueue::workerLoop, this);
+}
+
+SerialQueue::~SerialQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_one();
+    worker_.join();
+}
+
+void SerialQueue::enqueue(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+}
+
+void SerialQueue::workerLoop() {
+    for (;;) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            // 停止前先执行完队列中剩余的任务
+            if (tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        run(task);
+    }
+}
+
+// === ThreadPool ===
+
+namespace {
+
+// 当前线程所属的线程池和编号，用于让工作线程内部提交的任务进入自己的队列
+struct CurrentWorker {
+    const ThreadPool* pool = nullptr;
+    int index = -1;
+};
+
+thread_local CurrentWorker current_worker;
+
+} // namespace
+
+// 把当前线程绑定到指定CPU核心；平台不支持或核心不可用时保持不绑定
+static void pinCurrentThread(int core) {
+#if defined(__linux__)
+    if (core < 0 || core >= CPU_SETSIZE) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)core;
+#endif
+}
+
+ThreadPool::ThreadPool(size_t num_threads, std::vector<int> cpu_affinity)
+    : cpu_affinity_(std::move(cpu_affinity)) {
+    if (num_threads == 0) {
+        num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    // 先创建所有队列再启动线程，工作线程窃取时可以安全遍历workers_
+    workers_.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers_[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        stopping_ = true;
+    }
+    wake_cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+std::string ThreadPool::name() const {
+    return "ThreadPool(" + std::to_string(workers_.size()) + " threads)";
+}
+
+int ThreadPool::currentWorkerIndex() const {
+    return current_worker.pool == this ? current_worker.index : -1;
+}
+
+void ThreadPool::enqueue(Task task) {
+    int self = currentWorkerIndex();
+    size_t index = self >= 0 ? static_cast<size_t>(self)
+                             : next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+        queued_.fetch_add(1, std::memory_order_release);
+    }
+    // 经过wake_mutex_再通知：等待方在持锁时检查queued_，因此不会错过这次唤醒
+    { std::lock_guard<std::mutex> lock(wake_mutex_); }
+    wake_cv_.notify_one();
+}
+
+bool ThreadPool::tryPop(size_t index, Task& task) {
+    // 先从自己队列的尾部取（最近提交的任务）
+    {
+        Worker& own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    // 再从其他队列的头部窃取（最早提交的任务）
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    current_worker.pool = this;
+    current_worker.index = static_cast<int>(index);
+    if (!cpu_affinity_.empty()) {
+        pinCurrentThread(cpu_affinity_[index % cpu_affinity_.size()]);
+    }
+
+    for (;;) {
+        Task task;
+        if (tryPop(index, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this]() { return stopping_ || queued_.load(std::memory_order_acquire) > 0; });
+        // 停止前先执行完所有队列中剩余的任务
+        if (stopping_ && queued_.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+} // namespace dispatcher
@@ -0,0 +1,72 @@
+#include "FunctionSchema.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace dispatcher {
+
+static_assert(static_cast<size_t>(IValue::Tag::TensorList) < (size_t(1) << FunctionSchema::kTagBits),
+              "IValue tags must fit in FunctionSchema::kTagBits bits");
+
+FunctionSchema::FunctionSchema(std::vector<IValue::Tag> arguments, std::vector<IValue::Tag> returns)
+    : arguments(std::move(arguments)), returns(std::move(returns)) {
+    // 预先计算tensor参数位图和打包的tag，调用时只做整数比较
+    for (size_t i = 0; i < this->arguments.size(); ++i) {
+        IValue::Tag tag = this->arguments[i];
+        if (i < 64 && (tag == IValue::Tag::Tensor || tag == IValue::Tag::TensorList)) {
+            tensor_arguments |= uint64_t(1) << i;
+        }
+        if (i < kMaxPackedArguments) {
+            packed_argument_tags |= static_cast<uint64_t>(tag) << (i * kTagBits);
+        }
+    }
+}
+
+bool FunctionSchema::matchesSlow(const Stack& stack) const {
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (stack[i].tag() != arguments[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FunctionSchema::throwMismatch(const std::string& op_name, const Stack& stack) const {
+    // 错误路径：此时才拼接错误信息
+    if (stack.size() != arguments.size()) {
+        throw std::runtime_error("参数数量不匹配：期望 " + std::to_string(arguments.size()) +
+                               " 个参数，实际得到 " + std::to_string(stack.size()) + " 个");
+    }
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (stack[i].tag() != arguments[i]) {
+            throw std::runtime_error("Expected " + std::string(IValue::tagName(arguments[i])) +
+                                   " type for argument " + std::to_string(i) + " of " + op_name +
+                                   toString() + ", got " + IValue::tagName(stack[i].tag()));
+        }
+    }
+    throw std::runtime_error("Arguments do not match schema of " + op_name + toString());
+}
+
+std::string FunctionSchema::toString() const {
+    std::ostringstream oss;
+    oss << "(";
+    for (size_t i = 0; i < arguments.size(); ++i) {
+        if (i > 0) oss << ", ";
+        oss << IValue::tagName(arguments[i]);
+    }
+    oss << ") -> ";
+    if (returns.empty()) {
+        oss << "()";
+    } else if (returns.size() == 1) {
+        oss << IValue::tagName(returns[0]);
+    } else {
+        oss << "(";
+        for (size_t i = 0; i < returns.size(); ++i) {
+            if (i > 0) oss << ", ";
+            oss << IValue::tagName(returns[i]);
+        }
+        oss << ")";
+    }
+    return oss.str();
+}
+
+} // namespace dispatcher
@@ -0,0 +1,313 @@
+#include "Fusion.h"
+#include "Dispatcher.h"
+#include "Epoch.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace dispatcher {
+
+// === 注册表 ===
+
+namespace {
+
+struct FusionRegistry {
+    std::mutex mutex;
+    // 声明过逐元素语义的操作符
+    std::unordered_map<std::string, ElementwiseOpInfo> elementwise_ops;
+    // 表达式 -> 合成操作符名称，相同的表达式共用一个操作符
+    std::unordered_map<std::string, std::string> fused_names;
+    // 合成操作符名称 -> 表达式
+    std::unordered_map<std::string, std::shared_ptr<const ElementwiseExpr>> fused_exprs;
+    size_t next_id = 0;
+
+    static FusionRegistry& instance() {
+        static FusionRegistry registry;
+        return registry;
+    }
+};
+
+} // namespace
+
+void registerElementwiseOp(const std::string& op_name, ElementwiseOpInfo info) {
+    auto& registry = FusionRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.elementwise_ops[op_name] = info;
+}
+
+const ElementwiseOpInfo* findElementwiseOp(const std::string& op_name) {
+    auto& registry = FusionRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.elementwise_ops.find(op_name);
+    return it == registry.elementwise_ops.end() ? nullptr : &it->second;
+}
+
+std::shared_ptr<const ElementwiseExpr> findFusedExpression(const std::string& op_name) {
+    auto& registry = FusionRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.fused_exprs.find(op_name);
+    return it == registry.fused_exprs.end() ? nullptr : it->second;
+}
+
+// 获取（必要时注册）计算expr的合成操作符
+static const OperatorHandle& fusedOperator(const ElementwiseExpr& expr) {
+    auto& registry = FusionRegistry::instance();
+    auto& dispatcher = Dispatcher::instance();
+    std::string key = expr.toString() + " @" + std::to_string(expr.num_inputs) + ":" + std::to_string(expr.shape_input);
+
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.fused_names.find(key);
+    if (it != registry.fused_names.end()) {
+        if (const OperatorHandle* op = dispatcher.findOperator(OperatorName(it->second))) {
+            return *op;
+        }
+    }
+
+    std::string name;
+    do {
+        name = "fused_elementwise_" + std::to_string(registry.next_id++);
+    } while (dispatcher.hasOperator(OperatorName(name)));
+
+    auto shared_expr = std::make_shared<const ElementwiseExpr>(expr);
+    auto& op = registerOp(name);
+    REGISTER_KERNEL(op, CPU, BoxedKernelFunction([shared_expr](const OperatorHandle&, DispatchKeySet, Stack* stack) {
+        std::vector<Tensor> inputs;
+        inputs.reserve(stack->size());
+        for (const IValue& arg : *stack) {
+            inputs.push_back(arg.toTensorRef());
+        }
+        Tensor result = fused_elementwise_op(*shared_expr, inputs);
+        stack->clear();
+        stack->push_back(IValue(std::move(result)));
+    }));
+
+    registry.fused_names[key] = name;
+    registry.fused_exprs[name] = shared_expr;
+    return op;
+}
+
+// === 融合pass ===
+
+std::shared_ptr<const Graph> fuseElementwise(const Graph& graph) {
+    ArrayRef<GraphNode> nodes = graph.nodes();
+    const size_t num_values = graph.numValues();
+
+    // 每个值被节点参数和图输出引用的次数
+    std::vector<uint32_t> uses(num_values, 0);
+    for (const GraphNode& node : nodes) {
+        for (uint32_t id : graph.nodeInputs(node)) {
+            ++uses[id];
+        }
+    }
+    std::vector<bool> is_output(num_values, false);
+    for (uint32_t id : graph.outputs()) {
+        ++uses[id];
+        is_output[id] = true;
+    }
+
+    // 节点能否融合，以及它的逐元素语义
+    auto isTensorValue = [&](uint32_t id) { return graph.value(id).kind != GraphValueKind::Constant; };
+    auto isScalarConstant = [&](uint32_t id) {
+        const GraphValue& v = graph.value(id);
+        return v.kind == GraphValueKind::Constant &&
+               (graph.constants()[v.index].isDouble() || graph.constants()[v.index].isInt());
+    };
+    std::vector<const ElementwiseOpInfo*> infos(nodes.size(), nullptr);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        const GraphNode& node = nodes[i];
+        const ElementwiseOpInfo* info = findElementwiseOp(node.op->name());
+        if (!info || node.num_outputs != 1 || node.ks.highestPriorityKey() != DispatchKey::CPU) {
+            continue;
+        }
+        ArrayRef<uint32_t> args = graph.nodeInputs(node);
+        bool ok = false;
+        switch (info->kind) {
+            case ElementwiseInstruction::Kind::Binary:
+                ok = args.size() == 2 && isTensorValue(args[0]) && isTensorValue(args[1]);
+                break;
+            case ElementwiseInstruction::Kind::BinaryScalar:
+                ok = args.size() == 2 && isTensorValue(args[0]) && isScalarConstant(args[1]);
+                break;
+            case ElementwiseInstruction::Kind::Unary:
+                ok = args.size() == 1 && isTensorValue(args[0]);
+                break;
+        }
+        if (ok) {
+            infos[i] = info;
+        }
+    }
+
+    // 分组：可融合节点的参数如果由另一个可融合节点产生、且只在这里使用一次，两者并入同一组
+    // 组内只有最后一个节点（根）的结果会被外部使用，组在根的位置整体执行
+    std::vector<uint32_t> root_of(nodes.size());
+    std::vector<std::vector<uint32_t>> members(nodes.size());
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        root_of[i] = i;
+        if (!infos[i]) {
+            continue;
+        }
+        members[i].push_back(i);
+        for (uint32_t id : graph.nodeInputs(nodes[i])) {
+            const GraphValue& v = graph.value(id);
+            if (v.kind != GraphValueKind::NodeOutput || !infos[v.index] || uses[id] != 1 || is_output[id]) {
+                continue;
+            }
+            uint32_t producer = v.index;
+            for (uint32_t member : members[producer]) {
+                root_of[member] = i;
+            }
+            members[i].insert(members[i].end(), members[producer].begin(), members[producer].end());
+            members[producer].clear();
+        }
+        std::sort(members[i].begin(), members[i].end());
+    }
+    auto isFused = [&](uint32_t node) { return members[root_of[node]].size() > 1; };
+
+    // 重建图：保留的值按原顺序重新编号
+    auto fused = std::make_unique<Graph>();
+    std::vector<uint32_t> new_id(num_values, UINT32_MAX);
+    std::vector<uint32_t> new_node_index(nodes.size(), UINT32_MAX);
+    uint32_t num_kept_nodes = 0;
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        if (!isFused(i) || root_of[i] == i) {
+            new_node_index[i] = num_kept_nodes++;
+        }
+    }
+
+    // 常量只在仍被保留节点引用时保留；被融合的标量已经写入表达式
+    std::vector<bool> constant_used(num_values, false);
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        if (!isFused(i)) {
+            for (uint32_t id : graph.nodeInputs(nodes[i])) {
+                constant_used[id] = true;
+            }
+        }
+    }
+    for (uint32_t id : graph.outputs()) {
+        constant_used[id] = true;
+    }
+
+    // 保留的值连同tensor元信息一起复制，只改写序号
+    auto keep = [&](uint32_t id, uint32_t index) {
+        new_id[id] = static_cast<uint32_t>(fused->values_.size());
+        GraphValue value = graph.value(id);
+        value.index = index;
+        fused->values_.push_back(std::move(value));
+    };
+    for (uint32_t id = 0; id < num_values; ++id) {
+        const GraphValue& v = graph.value(id);
+        switch (v.kind) {
+            case GraphValueKind::Input:
+                keep(id, v.index);
+                fused->inputs_.push_back(new_id[id]);
+                break;
+            case GraphValueKind::Constant:
+                if (constant_used[id]) {
+                    keep(id, static_cast<uint32_t>(fused->constants_.size()));
+                    fused->constants_.push_back(graph.constants()[v.index]);
+                }
+                break;
+            case GraphValueKind::NodeOutput:
+                if (new_node_index[v.index] != UINT32_MAX) {
+                    keep(id, new_node_index[v.index]);
+                }
+                break;
+        }
+    }
+
+    std::vector<GraphNode> new_nodes;
+    std::vector<uint32_t> new_slots;
+    EpochManager::ReadGuard guard;  // findKernel返回的指针在复制完成前保持有效
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        const GraphNode& node = nodes[i];
+        if (new_node_index[i] == UINT32_MAX) {
+            continue;
+        }
+        uint32_t inputs_begin = static_cast<uint32_t>(new_slots.size());
+        if (!isFused(i)) {
+            for (uint32_t id : graph.nodeInputs(node)) {
+                new_slots.push_back(new_id[id]);
+            }
+            fused->kernels_.push_back(*node.kernel);
+            new_nodes.push_back(GraphNode{node.op, &fused->kernels_.back(), node.ks, inputs_begin,
+                                          node.num_inputs, new_id[node.first_output], node.num_outputs,
+                                          node.kernel_key});
+            continue;
+        }
+
+        // 把组内节点按执行顺序翻译成指令；组外的值成为表达式的输入
+        ElementwiseExpr expr;
+        std::unordered_map<uint32_t, uint32_t> register_of;  // 原值ID -> 寄存器
+        std::vector<uint32_t> leaves;
+        std::vector<uint32_t> shape_of;  // 寄存器的结果shape取自哪个输入
+        auto operand = [&](uint32_t id) -> uint32_t {
+            auto it = register_of.find(id);
+            if (it != register_of.end()) {
+                return it->second;
+            }
+            // 新的组外输入
+            uint32_t leaf = static_cast<uint32_t>(leaves.size());
+            leaves.push_back(id);
+            register_of[id] = leaf;
+            return leaf;
+        };
+        // 先收集所有组外输入，保证它们占用最低的寄存器编号
+        for (uint32_t member : members[i]) {
+            for (uint32_t id : graph.nodeInputs(nodes[member])) {
+                const GraphValue& v = graph.value(id);
+                bool internal = v.kind == GraphValueKind::NodeOutput && root_of[v.index] == i;
+                if (!internal && v.kind != GraphValueKind::Constant) {
+                    operand(id);
+                }
+            }
+        }
+        expr.num_inputs = leaves.size();
+        for (uint32_t leaf = 0; leaf < leaves.size(); ++leaf) {
+            shape_of.push_back(leaf);
+        }
+        for (uint32_t member : members[i]) {
+            const GraphNode& inner = nodes[member];
+            const ElementwiseOpInfo& info = *infos[member];
+            ArrayRef<uint32_t> args = graph.nodeInputs(inner);
+            ElementwiseInstruction inst;
+            inst.kind = info.kind;
+            inst.binary_op = info.binary_op;
+            inst.unary_op = info.unary_op;
+            inst.lhs = register_of.at(args[0]);
+            if (info.kind == ElementwiseInstruction::Kind::Binary) {
+                inst.rhs = register_of.at(args[1]);
+            } else if (info.kind == ElementwiseInstruction::Kind::BinaryScalar) {
+                const IValue& scalar = graph.constants()[graph.value(args[1]).index];
+                inst.scalar = static_cast<float>(scalar.isDouble() ? scalar.toDouble() : static_cast<double>(scalar.toInt()));
+            }
+            uint32_t result = static_cast<uint32_t>(expr.num_inputs + expr.instructions.size());
+            register_of[inner.first_output] = result;
+            shape_of.push_back(shape_of[inst.lhs]);
+            expr.instructions.push_back(inst);
+        }
+        expr.shape_input = shape_of.back();
+
+        const OperatorHandle& op = fusedOperator(expr);
+        DispatchKey kernel_key = DispatchKey::CPU;
+        const KernelFunction* kernel = op.findKernel(DispatchKeySet(DispatchKey::CPU), &kernel_key);
+        if (!kernel) {
+            throw std::runtime_error("fuseElementwise: 合成操作符 '" + op.name() + "' 没有CPU内核");
+        }
+        for (uint32_t leaf : leaves) {
+            new_slots.push_back(new_id[leaf]);
+        }
+        fused->kernels_.push_back(*kernel);
+        new_nodes.push_back(GraphNode{&op, &fused->kernels_.back(), DispatchKeySet(DispatchKey::CPU), inputs_begin,
+                                      static_cast<uint32_t>(leaves.size()), new_id[node.first_output], 1,
+                                      kernel_key});
+    }
+
+    for (uint32_t id : graph.outputs()) {
+        fused->outputs_.push_back(new_id[id]);
+    }
+    fused->setNodes(new_nodes, new_slots);
+    return std::shared_ptr<const Graph>(std::move(fused));
+}
+
+} // namespace dispatcher
@@ -0,0 +1,87 @@
+#include "Future.h"
+#include <stdexcept>
+
+namespace dispatcher {
+
+// === DispatchFuture ===
+
+bool DispatchFuture::isReady() const {
+    if (!state_) {
+        throw std::runtime_error("DispatchFuture has no associated state");
+    }
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->ready;
+}
+
+void DispatchFuture::wait() const {
+    if (!state_) {
+        throw std::runtime_error("DispatchFuture has no associated state");
+    }
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    state_->ready_cv.wait(lock, [this]() { return state_->ready; });
+}
+
+IValueList DispatchFuture::get() {
+    wait();
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    if (state_->retrieved) {
+        throw std::runtime_error("DispatchFuture result has already been retrieved");
+    }
+    state_->retrieved = true;
+    if (state_->exception) {
+        std::rethrow_exception(state_->exception);
+    }
+    return std::move(state_->value);
+}
+
+void DispatchFuture::then(std::function<void()> callback) {
+    if (!state_) {
+        throw std::runtime_error("DispatchFuture has no associated state");
+    }
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        if (!state_->ready) {
+            state_->callbacks.push_back(std::move(callback));
+            return;
+        }
+    }
+    // 已经就绪：在锁外直接调用，回调中可以安全地调用get()
+    callback();
+}
+
+// === DispatchPromise ===
+
+DispatchPromise::DispatchPromise() : state_(std::make_shared<detail::FutureState>()) {}
+
+void DispatchPromise::setValue(IValueList value) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    if (state_->ready) {
+        throw std::runtime_error("DispatchPromise is already satisfied");
+    }
+    state_->value = std::move(value);
+    complete(lock);
+}
+
+void DispatchPromise::setException(std::exception_ptr exception) {
+    std::unique_lock<std::mutex> lock(state_->mutex);
+    if (state_->ready) {
+        throw std::runtime_error("DispatchPromise is already satisfied");
+    }
+    state_->exception = std::move(exception);
+    complete(lock);
+}
+
+void DispatchPromise::complete(std::unique_lock<std::mutex>& lock) {
+    state_->ready = true;
+    std::vector<std::function<void()>> callbacks = std::move(state_->callbacks);
+    state_->callbacks.clear();
+    lock.unlock();
+
+    // 先唤醒阻塞等待者，再在锁外依次执行回调（回调可能恢复协程或调用get()）
+    state_->ready_cv.notify_all();
+    for (auto& callback : callbacks) {
+        callback();
+    }
+}
+
+} // namespace dispatcher
@@ -0,0 +1,419 @@
+#include "Graph.h"
+#include "Dispatcher.h"
+#include "MemoryPlanner.h"
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+namespace dispatcher {
+
+// 当前线程上正在进行的捕获，嵌套的GraphCapture形成一条链
+static thread_local GraphCapture* tls_current_capture = nullptr;
+
+// 没有注册Tracing fallback时，捕获期间临时安装GraphCapture::traceCall作为fallback
+// 所有线程上的捕获共享一个计数，最后一个捕获结束时移除自己安装的fallback；用户注册的fallback保持不变
+static std::mutex capture_fallback_mutex;
+static size_t active_captures = 0;
+static bool capture_installed_fallback = false;
+
+static void acquireTracingFallback() {
+    std::lock_guard<std::mutex> lock(capture_fallback_mutex);
+    if (active_captures++ == 0 && !Dispatcher::instance().hasFallback(DispatchKey::Tracing)) {
+        Dispatcher::instance().registerFallback(DispatchKey::Tracing, GraphCapture::traceCall);
+        capture_installed_fallback = true;
+    }
+}
+
+static void releaseTracingFallback() {
+    std::lock_guard<std::mutex> lock(capture_fallback_mutex);
+    if (--active_captures == 0 && capture_installed_fallback) {
+        Dispatcher::instance().deregisterFallback(DispatchKey::Tracing);
+        capture_installed_fallback = false;
+    }
+}
+
+// === Graph ===
+
+std::string Graph::toString() const {
+    std::ostringstream oss;
+    auto print_value = [&](uint32_t id) {
+        const GraphValue& v = values_[id];
+        if (v.kind == GraphValueKind::Constant) {
+            oss << constants_[v.index].debugString();
+        } else {
+            oss << "%" << id;
+        }
+    };
+
+    oss << "graph(";
+    for (size_t i = 0; i < inputs_.size(); ++i) {
+        if (i > 0) oss << ", ";
+        oss << "%" << inputs_[i];
+    }
+    oss << "):\n";
+
+    for (const GraphNode& node : nodes()) {
+        oss << "  ";
+        for (uint32_t i = 0; i < node.num_outputs; ++i) {
+            if (i > 0) oss << ", ";
+            oss << "%" << node.first_output + i;
+        }
+        oss << (node.num_outputs > 0 ? " = " : "") << node.op->name() << "(";
+        ArrayRef<uint32_t> args = nodeInputs(node);
+        for (size_t i = 0; i < args.size(); ++i) {
+            if (i > 0) oss << ", ";
+            print_value(args[i]);
+        }
+        oss << ")  " << node.ks.toString() << "\n";
+    }
+
+    oss << "  return (";
+    for (size_t i = 0; i < outputs_.size(); ++i) {
+        if (i > 0) oss << ", ";
+        print_value(outputs_[i]);
+    }
+    oss << ")";
+    return oss.str();
+}
+
+void Graph::setNodes(const std::vector<GraphNode>& nodes, const std::vector<uint32_t>& input_slots) {
+    // 节点和参数槽位连续地放入图的Arena，回放时顺序扫描
+    num_nodes_ = static_cast<uint32_t>(nodes.size());
+    nodes_ = arena_.allocateArray<GraphNode>(nodes.size());
+    std::copy(nodes.begin(), nodes.end(), nodes_);
+    input_slots_ = arena_.allocateArray<uint32_t>(input_slots.size());
+    std::copy(input_slots.begin(), input_slots.end(), input_slots_);
+}
+
+// === GraphCapture ===
+
+GraphCapture::GraphCapture()
+    : graph_(std::make_unique<Graph>()), previous_(tls_current_capture), saved_local_(localDispatchKeySet()) {
+    acquireTracingFallback();
+    tls_current_capture = this;
+    localDispatchKeySet().included.add(DispatchKey::Tracing);
+}
+
+GraphCapture::~GraphCapture() {
+    if (!finished_) {
+        localDispatchKeySet() = saved_local_;
+        tls_current_capture = previous_;
+        releaseTracingFallback();
+    }
+}
+
+bool GraphCapture::isCapturing() {
+    return tls_current_capture != nullptr;
+}
+
+uint32_t GraphCapture::newValue(GraphValueKind kind, uint32_t index) {
+    uint32_t id = static_cast<uint32_t>(graph_->values_.size());
+    graph_->values_.push_back(GraphValue{kind, index, DispatchKey::Undefined, {}});
+    return id;
+}
+
+void GraphCapture::setTensorInfo(uint32_t id, const Tensor& tensor) {
+    GraphValue& value = graph_->values_[id];
+    value.backend = tensor->backendKey();
+    value.sizes = tensor->sizes();
+}
+
+void GraphCapture::addInput(const Tensor& tensor) {
+    if (!tensor) {
+        throw std::runtime_error("GraphCapture::addInput: 输入tensor为空");
+    }
+    if (tensor_values_.count(tensor.get())) {
+        return;
+    }
+    uint32_t id = newValue(GraphValueKind::Input, static_cast<uint32_t>(graph_->inputs_.size()));
+    setTensorInfo(id, tensor);
+    graph_->inputs_.push_back(id);
+    tensor_values_[tensor.get()] = id;
+    retained_tensors_.push_back(tensor);
+}
+
+uint32_t GraphCapture::valueOf(const IValue& value) {
+    if (value.isTensor() && value.toTensorRef()) {
+        const Tensor& tensor = value.toTensorRef();
+        auto it = tensor_values_.find(tensor.get());
+        if (it != tensor_values_.end()) {
+            return it->second;
+        }
+        // 不是图中节点产生的tensor：成为图的输入
+        addInput(tensor);
+        return tensor_values_[tensor.get()];
+    }
+    if (value.isTensorList()) {
+        throw std::runtime_error("GraphCapture: 暂不支持捕获TensorList参数");
+    }
+    // 非tensor参数按捕获时的值固定为常量
+    uint32_t index = static_cast<uint32_t>(graph_->constants_.size());
+    graph_->constants_.push_back(value);
+    return newValue(GraphValueKind::Constant, index);
+}
+
+void GraphCapture::traceCall(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+    GraphCapture* capture = tls_current_capture;
+    if (!capture) {
+        op.redispatchBoxed(DispatchKey::Tracing, ks, stack);
+        return;
+    }
+    capture->record(op, ks, stack);
+}
+
+void GraphCapture::record(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+    DispatchKeySet next_ks = ks & DispatchKeySet::keysBelow(DispatchKey::Tracing);
+
+    // 解析与重新分发相同的内核，复制到图中；调用方处于ReadGuard内，指针在此期间有效
+    DispatchKey kernel_key = DispatchKey::Undefined;
+    const KernelFunction* kernel = op.findKernel(next_ks, &kernel_key);
+    if (!kernel) {
+        throw std::runtime_error("No kernel found for operator '" + op.name() +
+                                 "' with dispatch key set " + next_ks.toString());
+    }
+
+    // 记录参数；调用失败时撤销本次新增的输入、常量和槽位
+    size_t saved_slots = input_slots_.size();
+    size_t saved_values = graph_->values_.size();
+    size_t saved_inputs = graph_->inputs_.size();
+    size_t saved_constants = graph_->constants_.size();
+    size_t saved_retained = retained_tensors_.size();
+    auto rollback = [&]() {
+        for (size_t i = saved_retained; i < retained_tensors_.size(); ++i) {
+            tensor_values_.erase(retained_tensors_[i].get());
+        }
+        retained_tensors_.resize(saved_retained);
+        input_slots_.resize(saved_slots);
+        graph_->values_.resize(saved_values);
+        graph_->inputs_.resize(saved_inputs);
+        graph_->constants_.resize(saved_constants);
+    };
+
+    try {
+        for (const IValue& arg : *stack) {
+            input_slots_.push_back(valueOf(arg));
+        }
+        // 内核内部的嵌套调用属于该内核的实现，不再记录
+        ExcludeDispatchKeyGuard no_nested_capture(DispatchKey::Tracing);
+        op.redispatchBoxed(DispatchKey::Tracing, ks, stack);
+    } catch (...) {
+        rollback();
+        throw;
+    }
+
+    // 记录输出：输出的tensor之后被其他调用使用时引用这个节点
+    uint32_t node_index = static_cast<uint32_t>(nodes_.size());
+    uint32_t first_output = static_cast<uint32_t>(graph_->values_.size());
+    for (const IValue& result : *stack) {
+        uint32_t id = newValue(GraphValueKind::NodeOutput, node_index);
+        if (result.isTensor() && result.toTensorRef()) {
+            setTensorInfo(id, result.toTensorRef());
+            tensor_values_[result.toTensorRef().get()] = id;
+            retained_tensors_.push_back(result.toTensorRef());
+        }
+    }
+
+    graph_->kernels_.push_back(*kernel);
+    nodes_.push_back(GraphNode{&op, &graph_->kernels_.back(), next_ks, static_cast<uint32_t>(saved_slots),
+                                 static_cast<uint32_t>(input_slots_.size() - saved_slots), first_output,
+                                 static_cast<uint32_t>(stack->size()), kernel_key});
+}
+
+std::shared_ptr<const Graph> GraphCapture::finish(const IValueList& outputs) {
+    if (finished_) {
+        throw std::runtime_error("GraphCapture::finish called twice");
+    }
+    for (const IValue& output : outputs) {
+        graph_->outputs_.push_back(valueOf(output));
+    }
+
+    graph_->setNodes(nodes_, input_slots_);
+
+    // 结束捕获，恢复进入作用域前的线程状态
+    finished_ = true;
+    localDispatchKeySet() = saved_local_;
+    tls_current_capture = previous_;
+    releaseTracingFallback();
+    tensor_values_.clear();
+    retained_tensors_.clear();
+
+    return std::shared_ptr<const Graph>(std::move(graph_));
+}
+
+// === GraphExecutor ===
+
+// 捕获时记录的tensor元信息，用于输入不匹配时的错误信息
+static std::string describeValue(const GraphValue& value) {
+    std::ostringstream oss;
+    oss << toString(value.backend) << " tensor shape=[";
+    for (size_t i = 0; i < value.sizes.size(); ++i) {
+        if (i > 0) oss << ", ";
+        oss << value.sizes[i];
+    }
+    oss << "]";
+    return oss.str();
+}
+
+GraphExecutor::GraphExecutor(std::shared_ptr<const Graph> graph, bool plan_memory) : graph_(std::move(graph)) {
+    const Graph& g = *graph_;
+
+    // 常量在整个执行器的生命周期内不变，只填充一次
+    values_.resize(g.numValues());
+    for (uint32_t id = 0; id < g.numValues(); ++id) {
+        const GraphValue& value = g.value(id);
+        if (value.kind == GraphValueKind::Constant) {
+            values_[id] = g.constants()[value.index];
+        }
+    }
+
+    // 每个非常量、非输出的值在最后一个使用它的节点之后释放；从未被使用的节点输出在产生后立即释放
+    constexpr uint32_t kNoUse = UINT32_MAX;
+    std::vector<uint32_t> last_use(g.numValues(), kNoUse);
+    ArrayRef<GraphNode> nodes = g.nodes();
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        for (uint32_t id : g.nodeInputs(nodes[i])) {
+            last_use[id] = i;
+        }
+        for (uint32_t k = 0; k < nodes[i].num_outputs; ++k) {
+            if (last_use[nodes[i].first_output + k] == kNoUse) {
+                last_use[nodes[i].first_output + k] = i;
+            }
+        }
+    }
+    for (uint32_t id : g.outputs()) {
+        last_use[id] = kNoUse;
+    }
+    std::vector<std::vector<uint32_t>> releases(nodes.size());
+    for (uint32_t id = 0; id < g.numValues(); ++id) {
+        if (last_use[id] != kNoUse && g.value(id).kind != GraphValueKind::Constant) {
+            releases[last_use[id]].push_back(id);
+        }
+    }
+    for (const auto& release : releases) {
+        release_begin_.push_back(static_cast<uint32_t>(release_values_.size()));
+        release_values_.insert(release_values_.end(), release.begin(), release.end());
+    }
+    release_begin_.push_back(static_cast<uint32_t>(release_values_.size()));
+
+    if (plan_memory) {
+        plan_ = std::make_unique<MemoryPlan>(planMemory(g));
+        for (size_t backend = 0; backend < slabs_.size(); ++backend) {
+            // Meta tensor不占内存，它的规划只用于估算，不需要slab
+            if (plan_->planned_bytes[backend] > 0 && static_cast<DispatchKey>(backend) != DispatchKey::Meta) {
+                slabs_[backend] = std::make_unique<SlabAllocator>(static_cast<DispatchKey>(backend),
+                                                                  plan_->planned_bytes[backend]);
+            }
+        }
+        // 每个规划过的值在slab中的区域，没有规划（或该backend没有slab）的值为空区域
+        output_regions_.assign(g.numValues(), OutputRegion{DispatchKey::Undefined, nullptr, 0});
+        for (uint32_t id = 0; id < g.numValues(); ++id) {
+            const MemoryPlan::Assignment* assignment = plan_->find(id);
+            if (!assignment) {
+                continue;
+            }
+            if (const SlabAllocator* slab = slabs_[static_cast<size_t>(assignment->backend)].get()) {
+                output_regions_[id] = slab->region(assignment->offset, assignment->nbytes);
+            }
+        }
+    }
+}
+
+GraphExecutor::~GraphExecutor() = default;
+
+void GraphExecutor::countPlannedOutputs(const OutputRegion* regions, uint32_t num_outputs) {
+    for (uint32_t k = 0; k < num_outputs; ++k) {
+        const OutputRegion& region = regions[k];
+        const IValue& result = stack_[k];
+        if (region.data && result.isTensor() && result.toTensorRef() && result.toTensorRef()->storage() &&
+            result.toTensorRef()->storage()->data() == region.data) {
+            slabs_[static_cast<size_t>(region.backend)]->recordHit();
+        }
+    }
+}
+
+IValueList GraphExecutor::run(const IValueList& inputs) {
+    const Graph& graph = *graph_;
+    if (inputs.size() != graph.inputs().size()) {
+        throw std::runtime_error("GraphExecutor: 期望 " + std::to_string(graph.inputs().size()) +
+                                 " 个输入，实际得到 " + std::to_string(inputs.size()) + " 个");
+    }
+    // 回放不再计算key set、不再校验schema：输入必须与捕获时的tensor同backend、同形状，否则绑定的内核不适用
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const GraphValue& expected = graph.value(graph.inputs()[i]);
+        const IValue& input = inputs[i];
+        bool matches = input.isTensor() && input.toTensorRef();
+        if (matches && expected.isTensor()) {
+            const Tensor& tensor = input.toTensorRef();
+            matches = tensor->backendKey() == expected.backend && tensor->sizes() == expected.sizes;
+        }
+        if (!matches) {
+            throw std::runtime_error("GraphExecutor: 第 " + std::to_string(i) + " 个输入与捕获时不一致，期望 " +
+                                     describeValue(expected) + "，实际得到 " + input.debugString());
+        }
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        values_[graph.inputs()[i]] = inputs[i];
+    }
+
+    // 热循环：压栈、直接调用绑定的内核、取回结果
+    const Dispatcher& dispatcher = Dispatcher::instance();
+    const bool profiling = dispatcher.isProfilingEnabled();
+    ArrayRef<GraphNode> nodes = graph.nodes();
+    for (size_t index = 0; index < nodes.size(); ++index) {
+        const GraphNode& node = nodes[index];
+        stack_.clear();
+        for (uint32_t id : graph.nodeInputs(node)) {
+            stack_.push_back(values_[id]);
+        }
+        // 有规划时：内核通过make_output_tensor创建的第k个结果直接放进第k个输出在slab中的区域
+        const OutputRegion* regions = plan_ ? output_regions_.data() + node.first_output : nullptr;
+        OutputRegionGuard planned_outputs(regions, plan_ ? node.num_outputs : 0);
+        DispatchEventScope event;
+        if (DispatchEventScope::enabled()) {
+            event.begin(node.op->id(), node.kernel_key);
+        }
+        if (Dispatcher::shouldSampleLatency()) {
+            auto start = std::chrono::steady_clock::now();
+            node.kernel->callBoxed(*node.op, node.ks, &stack_);
+            auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            dispatcher.recordLatency(node.op->id(), node.kernel_key, static_cast<uint64_t>(nanos.count()));
+        } else {
+            node.kernel->callBoxed(*node.op, node.ks, &stack_);
+        }
+        if (profiling) {
+            dispatcher.recordCall(node.op->id(), node.ks.highestPriorityKey());
+        }
+        if (stack_.size() != node.num_outputs) {
+            throw std::runtime_error("GraphExecutor: operator '" + node.op->name() + "' returned " +
+                                     std::to_string(stack_.size()) + " values, expected " +
+                                     std::to_string(node.num_outputs));
+        }
+        if (plan_) {
+            countPlannedOutputs(regions, node.num_outputs);
+        }
+        for (uint32_t i = 0; i < node.num_outputs; ++i) {
+            values_[node.first_output + i] = std::move(stack_[i]);
+        }
+        for (uint32_t r = release_begin_[index]; r < release_begin_[index + 1]; ++r) {
+            values_[release_values_[r]] = IValue();
+        }
+    }
+
+    IValueList outputs;
+    outputs.reserve(graph.outputs().size());
+    for (uint32_t id : graph.outputs()) {
+        outputs.push_back(values_[id]);
+    }
+
+    // 释放本次运行的输入和中间结果，不把tensor留到下一次运行
+    for (uint32_t id = 0; id < values_.size(); ++id) {
+        if (graph.value(id).kind != GraphValueKind::Constant) {
+            values_[id] = IValue();
+        }
+    }
+    stack_.clear();
+    return outputs;
+}
+
+} // namespace dispatcher
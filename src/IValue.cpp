@@ -2,12 +2,13 @@
 #include "TensorImpl.h"
 #include <stdexcept>
 #include <sstream>
+#include <cstring>
 
 namespace dispatcher {
 
 // IValue构造函数实现
-IValue::IValue(std::shared_ptr<TensorImpl> tensor) : tag_(Tag::Tensor) {
-    payload_.tensor = new std::shared_ptr<TensorImpl>(std::move(tensor));
+IValue::IValue(Tensor tensor) : tag_(Tag::Tensor) {
+    new (&payload_.as_tensor) Tensor(std::move(tensor));
 }
 
 IValue::IValue(double value) : tag_(Tag::Double) {
@@ -22,109 +23,93 @@ IValue::IValue(bool value) : tag_(Tag::Bool) {
     payload_.as_bool = value;
 }
 
-IValue::IValue(std::string value) : tag_(Tag::String) {
-    payload_.as_string = new std::string(std::move(value));
+IValue::IValue(const std::string& value) : tag_(Tag::String) {
+    initString(value);
+}
+
+IValue::IValue(std::string&& value) : tag_(Tag::String) {
+    if (value.size() <= kInlineStringCapacity) {
+        initString(value);
+    } else {
+        payload_.as_string = new detail::SharedPayload<std::string>(std::move(value));
+    }
 }
 
 IValue::IValue(const char* value) : tag_(Tag::String) {
-    payload_.as_string = new std::string(value);
+    initString(value);
 }
 
-IValue::IValue(std::vector<int64_t> value) : tag_(Tag::IntList) {
-    payload_.as_int_list = new std::vector<int64_t>(std::move(value));
+IValue::IValue(const std::vector<int64_t>& value) : tag_(Tag::IntList) {
+    initIntList(value.data(), value.size());
+}
+
+IValue::IValue(std::vector<int64_t>&& value) : tag_(Tag::IntList) {
+    if (value.size() <= kInlineIntListCapacity) {
+        initIntList(value.data(), value.size());
+    } else {
+        payload_.as_int_list = new detail::SharedPayload<std::vector<int64_t>>(std::move(value));
+    }
+}
+
+IValue::IValue(IntArrayRef value) : tag_(Tag::IntList) {
+    initIntList(value.data(), value.size());
 }
 
 IValue::IValue(std::vector<double> value) : tag_(Tag::DoubleList) {
-    payload_.as_double_list = new std::vector<double>(std::move(value));
+    payload_.as_double_list = new detail::SharedPayload<std::vector<double>>(std::move(value));
 }
 
-IValue::IValue(std::vector<std::shared_ptr<TensorImpl>> value) : tag_(Tag::TensorList) {
-    payload_.as_tensor_list = new std::vector<std::shared_ptr<TensorImpl>>(std::move(value));
+IValue::IValue(std::vector<Tensor> value) : tag_(Tag::TensorList) {
+    payload_.as_tensor_list = new detail::SharedPayload<std::vector<Tensor>>(std::move(value));
 }
 
-// 拷贝构造函数
-IValue::IValue(const IValue& other) : tag_(other.tag_) {
-    switch (tag_) {
-        case Tag::None:
-            break;
-        case Tag::Tensor:
-            payload_.tensor = new std::shared_ptr<TensorImpl>(*other.payload_.tensor);
-            break;
-        case Tag::Double:
-            payload_.as_double = other.payload_.as_double;
-            break;
-        case Tag::Int:
-            payload_.as_int = other.payload_.as_int;
-            break;
-        case Tag::Bool:
-            payload_.as_bool = other.payload_.as_bool;
-            break;
-        case Tag::String:
-            payload_.as_string = new std::string(*other.payload_.as_string);
-            break;
-        case Tag::IntList:
-            payload_.as_int_list = new std::vector<int64_t>(*other.payload_.as_int_list);
-            break;
-        case Tag::DoubleList:
-            payload_.as_double_list = new std::vector<double>(*other.payload_.as_double_list);
-            break;
-        case Tag::TensorList:
-            payload_.as_tensor_list = new std::vector<std::shared_ptr<TensorImpl>>(*other.payload_.as_tensor_list);
-            break;
+void IValue::initString(std::string_view value) {
+    if (value.size() <= kInlineStringCapacity) {
+        is_inline_ = true;
+        inline_size_ = static_cast<uint8_t>(value.size());
+        std::memcpy(payload_.inline_chars, value.data(), value.size());
+        payload_.inline_chars[value.size()] = '\0';
+    } else {
+        payload_.as_string = new detail::SharedPayload<std::string>(value);
     }
 }
 
+void IValue::initIntList(const int64_t* data, size_t size) {
+    if (size <= kInlineIntListCapacity) {
+        is_inline_ = true;
+        inline_size_ = static_cast<uint8_t>(size);
+        std::copy(data, data + size, payload_.inline_ints);
+    } else {
+        payload_.as_int_list = new detail::SharedPayload<std::vector<int64_t>>(data, data + size);
+    }
+}
+
+// 拷贝构造函数
+IValue::IValue(const IValue& other) : tag_(Tag::None) {
+    copyFrom(other);
+}
+
 // 拷贝赋值运算符
 IValue& IValue::operator=(const IValue& other) {
     if (this != &other) {
-        destroy();  // 清理当前数据
-        tag_ = other.tag_;
-        
-        // 拷贝新数据（与拷贝构造函数相同的逻辑）
-        switch (tag_) {
-            case Tag::None:
-                break;
-            case Tag::Tensor:
-                payload_.tensor = new std::shared_ptr<TensorImpl>(*other.payload_.tensor);
-                break;
-            case Tag::Double:
-                payload_.as_double = other.payload_.as_double;
-                break;
-            case Tag::Int:
-                payload_.as_int = other.payload_.as_int;
-                break;
-            case Tag::Bool:
-                payload_.as_bool = other.payload_.as_bool;
-                break;
-            case Tag::String:
-                payload_.as_string = new std::string(*other.payload_.as_string);
-                break;
-            case Tag::IntList:
-                payload_.as_int_list = new std::vector<int64_t>(*other.payload_.as_int_list);
-                break;
-            case Tag::DoubleList:
-                payload_.as_double_list = new std::vector<double>(*other.payload_.as_double_list);
-                break;
-            case Tag::TensorList:
-                payload_.as_tensor_list = new std::vector<std::shared_ptr<TensorImpl>>(*other.payload_.as_tensor_list);
-                break;
-        }
+        // 先拷贝再释放，避免other是当前值的一部分时提前被释放
+        IValue copy(other);
+        destroy();
+        moveFrom(copy);
     }
     return *this;
 }
 
 // 移动构造函数
-IValue::IValue(IValue&& other) noexcept : tag_(other.tag_), payload_(other.payload_) {
-    other.tag_ = Tag::None;  // 重置other为None状态，避免析构时重复释放
+IValue::IValue(IValue&& other) noexcept : tag_(Tag::None) {
+    moveFrom(other);
 }
 
 // 移动赋值运算符
 IValue& IValue::operator=(IValue&& other) noexcept {
     if (this != &other) {
         destroy();  // 清理当前数据
-        tag_ = other.tag_;
-        payload_ = other.payload_;
-        other.tag_ = Tag::None;  // 重置other
+        moveFrom(other);
     }
     return *this;
 }
@@ -134,12 +119,63 @@ IValue::~IValue() {
     destroy();
 }
 
+void IValue::copyFrom(const IValue& other) {
+    tag_ = other.tag_;
+    is_inline_ = other.is_inline_;
+    inline_size_ = other.inline_size_;
+    
+    switch (tag_) {
+        case Tag::Tensor:
+            new (&payload_.as_tensor) Tensor(other.payload_.as_tensor);
+            break;
+        case Tag::String:
+        case Tag::IntList:
+        case Tag::DoubleList:
+        case Tag::TensorList:
+            copyPayloadBits(other);  // 按位拷贝内联缓冲区或共享存储指针
+            if (!is_inline_) {
+                // 共享存储只需增加引用计数
+                switch (tag_) {
+                    case Tag::String: payload_.as_string->retain(); break;
+                    case Tag::IntList: payload_.as_int_list->retain(); break;
+                    case Tag::DoubleList: payload_.as_double_list->retain(); break;
+                    default: payload_.as_tensor_list->retain(); break;
+                }
+            }
+            break;
+        default:
+            // 基本类型直接按位拷贝
+            copyPayloadBits(other);
+            break;
+    }
+}
+
+void IValue::moveFrom(IValue& other) noexcept {
+    tag_ = other.tag_;
+    is_inline_ = other.is_inline_;
+    inline_size_ = other.inline_size_;
+    
+    if (tag_ == Tag::Tensor) {
+        new (&payload_.as_tensor) Tensor(std::move(other.payload_.as_tensor));
+        other.payload_.as_tensor.~Tensor();
+    } else {
+        // 其他类型都可以按位转移所有权
+        copyPayloadBits(other);
+    }
+    other.tag_ = Tag::None;  // 重置other为None状态，避免析构时重复释放
+    other.is_inline_ = false;
+}
+
 // 类型转换函数实现
-std::shared_ptr<TensorImpl> IValue::toTensor() const {
+Tensor IValue::toTensor() const {
+    return toTensorRef();
+}
+
+const Tensor& IValue::toTensorRef() const {
     if (!isTensor()) {
         throw std::runtime_error("IValue is not a Tensor");
     }
-    return *payload_.tensor;
+    return payload_.as_tensor;
 }
 
 double IValue::toDouble() const {
@@ -164,31 +200,68 @@ bool IValue::toBool() const {
 }
 
 std::string IValue::toString() const {
+    return std::string(toStringView());
+}
+
+std::string_view IValue::toStringView() const {
     if (!isString()) {
         throw std::runtime_error("IValue is not a String");
     }
-    return *payload_.as_string;
+    if (is_inline_) {
+        return std::string_view(payload_.inline_chars, inline_size_);
+    }
+    return payload_.as_string->value;
 }
 
 std::vector<int64_t> IValue::toIntList() const {
+    return toIntListRef().vec();
+}
+
+IntArrayRef IValue::toIntListRef() const {
     if (!isIntList()) {
         throw std::runtime_error("IValue is not an IntList");
     }
-    return *payload_.as_int_list;
+    if (is_inline_) {
+        return IntArrayRef(payload_.inline_ints, inline_size_);
+    }
+    return IntArrayRef(payload_.as_int_list->value);
 }
 
 std::vector<double> IValue::toDoubleList() const {
+    return toDoubleListRef().vec();
+}
+
+ArrayRef<double> IValue::toDoubleListRef() const {
     if (!isDoubleList()) {
         throw std::runtime_error("IValue is not a DoubleList");
     }
-    return *payload_.as_double_list;
+    return ArrayRef<double>(payload_.as_double_list->value);
 }
 
-std::vector<std::shared_ptr<TensorImpl>> IValue::toTensorList() const {
+std::vector<Tensor> IValue::toTensorList() const {
+    return toTensorListRef().vec();
+}
+
+ArrayRef<Tensor> IValue::toTensorListRef() const {
     if (!isTensorList()) {
         throw std::runtime_error("IValue is not a TensorList");
     }
-    return *payload_.as_tensor_list;
+    return ArrayRef<Tensor>(payload_.as_tensor_list->value);
+}
+
+const char* IValue::tagName(Tag tag) {
+    switch (tag) {
+        case Tag::None: return "None";
+        case Tag::Tensor: return "Tensor";
+        case Tag::Double: return "Double";
+        case Tag::Int: return "Int";
+        case Tag::Bool: return "Bool";
+        case Tag::String: return "String";
+        case Tag::IntList: return "IntList";
+        case Tag::DoubleList: return "DoubleList";
+        case Tag::TensorList: return "TensorList";
+    }
+    return "Unknown";
 }
 
 // 调试字符串表示
@@ -196,10 +269,8 @@ std::string IValue::debugString() const {
     switch (tag_) {
         case Tag::None:
             return "None";
-        case Tag::Tensor: {
-            auto tensor = toTensor();
-            return "Tensor(" + tensor->debugString() + ")";
-        }
+        case Tag::Tensor:
+            return "Tensor(" + toTensorRef()->debugString() + ")";
         case Tag::Double:
             return "Double(" + std::to_string(toDouble()) + ")";
         case Tag::Int:
@@ -211,7 +282,7 @@ std::string IValue::debugString() const {
         case Tag::IntList: {
             std::ostringstream oss;
             oss << "IntList([";
-            auto list = toIntList();
+            auto list = toIntListRef();
             for (size_t i = 0; i < list.size(); ++i) {
                 if (i > 0) oss << ", ";
                 oss << list[i];
@@ -222,7 +293,7 @@ std::string IValue::debugString() const {
         case Tag::DoubleList: {
             std::ostringstream oss;
             oss << "DoubleList([";
-            auto list = toDoubleList();
+            auto list = toDoubleListRef();
             for (size_t i = 0; i < list.size(); ++i) {
                 if (i > 0) oss << ", ";
                 oss << list[i];
@@ -233,7 +304,7 @@ std::string IValue::debugString() const {
         case Tag::TensorList: {
             std::ostringstream oss;
             oss << "TensorList([";
-            auto list = toTensorList();
+            auto list = toTensorListRef();
             for (size_t i = 0; i < list.size(); ++i) {
                 if (i > 0) oss << ", ";
                 oss << list[i]->debugString();
@@ -250,24 +321,26 @@ std::string IValue::debugString() const {
 void IValue::destroy() {
     switch (tag_) {
         case Tag::Tensor:
-            delete payload_.tensor;
+            payload_.as_tensor.~Tensor();
             break;
         case Tag::String:
-            delete payload_.as_string;
+            if (!is_inline_) payload_.as_string->release();
             break;
         case Tag::IntList:
-            delete payload_.as_int_list;
+            if (!is_inline_) payload_.as_int_list->release();
             break;
         case Tag::DoubleList:
-            delete payload_.as_double_list;
+            payload_.as_double_list->release();
             break;
         case Tag::TensorList:
-            delete payload_.as_tensor_list;
+            payload_.as_tensor_list->release();
             break;
         default:
-            // 基本类型不需要释放内存
+            // 基本类型和内联值不需要释放内存
             break;
     }
+    tag_ = Tag::None;
+    is_inline_ = false;
 }
 
-} // namespace dispatcher 
\ No newline at end of file
+} // namespace dispatcher
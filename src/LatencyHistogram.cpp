@@ -0,0 +1,92 @@
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <sstream>
+
+namespace dispatcher {
+
+// 桶布局自检
+static_assert(LatencyBuckets::indexOf(7) == 7, "linear range");
+static_assert(LatencyBuckets::indexOf(8) == 8, "first log bucket");
+static_assert(LatencyBuckets::upperBoundOf(LatencyBuckets::indexOf(1000)) >= 1000, "upper bound must cover value");
+static_assert(LatencyBuckets::indexOf(uint64_t(1) << 50) == LatencyBuckets::kNumBuckets - 1, "overflow bucket");
+
+// LatencyHistogram实现
+void LatencyHistogram::record(uint64_t ns) {
+    buckets_[LatencyBuckets::indexOf(ns)]++;
+    count_++;
+    total_ns_ += ns;
+    max_ns_ = std::max(max_ns_, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    total_ns_ += other.total_ns_;
+    max_ns_ = std::max(max_ns_, other.max_ns_);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    q = std::min(std::max(q, 0.0), 1.0);
+    
+    // 找到累计计数第一次达到rank的桶
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * static_cast<double>(count_) + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            // 桶上界可能超过实际观测到的最大值
+            return std::min(LatencyBuckets::upperBoundOf(i), max_ns_);
+        }
+    }
+    return max_ns_;
+}
+
+std::string LatencyHistogram::toString() const {
+    std::ostringstream oss;
+    oss << "count=" << count_
+        << ", mean=" << static_cast<uint64_t>(meanNanos()) << "ns"
+        << ", p50=" << p50() << "ns"
+        << ", p99=" << p99() << "ns"
+        << ", p999=" << p999() << "ns"
+        << ", max=" << max_ns_ << "ns";
+    return oss.str();
+}
+
+// AtomicLatencyHistogram实现
+void AtomicLatencyHistogram::record(uint64_t ns) {
+    // 只有一个写线程，用load+store代替原子RMW；读取方可能看到略微滞后的值
+    auto bump = [](std::atomic<uint64_t>& value, uint64_t delta) {
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    };
+    bump(buckets_[LatencyBuckets::indexOf(ns)], 1);
+    bump(count_, 1);
+    bump(total_ns_, ns);
+    if (ns > max_ns_.load(std::memory_order_relaxed)) {
+        max_ns_.store(ns, std::memory_order_relaxed);
+    }
+}
+
+void AtomicLatencyHistogram::mergeInto(LatencyHistogram& snapshot) const {
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        snapshot.buckets_[i] += buckets_[i].load(std::memory_order_relaxed);
+    }
+    snapshot.count_ += count_.load(std::memory_order_relaxed);
+    snapshot.total_ns_ += total_ns_.load(std::memory_order_relaxed);
+    snapshot.max_ns_ = std::max(snapshot.max_ns_, max_ns_.load(std::memory_order_relaxed));
+}
+
+void AtomicLatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    total_ns_.store(0, std::memory_order_relaxed);
+    max_ns_.store(0, std::memory_order_relaxed);
+}
+
+} // namespace dispatcher
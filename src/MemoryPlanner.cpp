@@ -0,0 +1,230 @@
+#include "MemoryPlanner.h"
+#include "Fusion.h"
+#include "TensorViews.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace dispatcher {
+
+// === 规划 ===
+
+static size_t alignUp(size_t nbytes) {
+    return (nbytes + kAllocatorAlignment - 1) / kAllocatorAlignment * kAllocatorAlignment;
+}
+
+// 节点是否逐元素地读取输入、写入输出：同一位置的输出只依赖同一位置的输入，可以原地执行
+static bool isElementwiseNode(const GraphNode& node) {
+    return findElementwiseOp(node.op->name()) || findFusedExpression(node.op->name());
+}
+
+MemoryPlan planMemory(const Graph& graph) {
+    ArrayRef<GraphNode> nodes = graph.nodes();
+    const size_t num_values = graph.numValues();
+    MemoryPlan plan;
+    plan.by_value.assign(num_values, -1);
+
+    // 生命周期：[产生它的节点, 最后一个使用它的节点]
+    constexpr uint32_t kNoUse = UINT32_MAX;
+    std::vector<uint32_t> last_use(num_values, kNoUse);
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        for (uint32_t id : graph.nodeInputs(nodes[i])) {
+            last_use[id] = i;
+        }
+    }
+    std::vector<bool> is_output(num_values, false);
+    for (uint32_t id : graph.outputs()) {
+        is_output[id] = true;
+    }
+
+    // 视图操作符的输出与第一个输入共享Storage：被引用的值（别名的根）要活到所有别名的最后一次使用，
+    // 有别名是图输出时根也不能放进slab；视图本身不分配内存，不参与规划
+    std::vector<uint32_t> alias_root(num_values);
+    for (uint32_t id = 0; id < num_values; ++id) {
+        alias_root[id] = id;
+    }
+    std::vector<bool> has_alias(num_values, false);
+    std::vector<bool> is_view(num_values, false);
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        const GraphNode& node = nodes[i];
+        ArrayRef<uint32_t> inputs = graph.nodeInputs(node);
+        if (inputs.empty() || !isViewOperator(node.op->name())) {
+            continue;
+        }
+        uint32_t root = alias_root[inputs[0]];
+        for (uint32_t k = 0; k < node.num_outputs; ++k) {
+            uint32_t id = node.first_output + k;
+            alias_root[id] = root;
+            is_view[id] = true;
+            has_alias[root] = true;
+        }
+    }
+    for (uint32_t id = 0; id < num_values; ++id) {
+        uint32_t root = alias_root[id];
+        if (root == id) {
+            continue;
+        }
+        if (last_use[id] != kNoUse && (last_use[root] == kNoUse || last_use[id] > last_use[root])) {
+            last_use[root] = last_use[id];
+        }
+        if (is_output[id]) {
+            is_output[root] = true;
+        }
+    }
+
+    // 参与规划的值：节点产生的、捕获时是tensor、不是图输出的中间结果
+    // 一个节点只要有一个输出不能规划，整个节点都不规划（见SlabAllocator的限制）
+    std::vector<bool> plannable_node(nodes.size(), true);
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        const GraphNode& node = nodes[i];
+        plannable_node[i] = node.num_outputs > 0;
+        for (uint32_t k = 0; k < node.num_outputs; ++k) {
+            const GraphValue& v = graph.value(node.first_output + k);
+            if (is_output[node.first_output + k] || is_view[node.first_output + k] || !v.isTensor() ||
+                !isBackendKey(v.backend) || v.nbytes() == 0) {
+                plannable_node[i] = false;
+            }
+        }
+    }
+
+    // 缓冲区：一个或多个（原地执行时）值共用的一段内存
+    struct Buffer {
+        DispatchKey backend;
+        size_t nbytes;  // 对齐后的大小
+        uint32_t first;
+        uint32_t last;
+        size_t offset = 0;
+    };
+    std::vector<Buffer> buffers;
+    std::vector<int64_t> buffer_of(num_values, -1);
+    std::vector<bool> in_place(num_values, false);
+
+    for (uint32_t i = 0; i < nodes.size(); ++i) {
+        if (!plannable_node[i]) {
+            continue;
+        }
+        const GraphNode& node = nodes[i];
+        bool elementwise = node.num_outputs == 1 && isElementwiseNode(node);
+        for (uint32_t k = 0; k < node.num_outputs; ++k) {
+            uint32_t id = node.first_output + k;
+            const GraphValue& v = graph.value(id);
+            uint32_t last = last_use[id] == kNoUse ? i : last_use[id];
+
+            // 原地执行：某个已规划的输入在本节点死亡且大小、backend相同，直接延长它的缓冲区；
+            // 有别名的输入不原地执行，同一节点可能通过视图以不同的布局读取它
+            if (elementwise) {
+                for (uint32_t input : graph.nodeInputs(node)) {
+                    int64_t buffer = buffer_of[input];
+                    if (buffer >= 0 && !has_alias[input] && last_use[input] == i && buffers[buffer].last == i &&
+                        graph.value(input).backend == v.backend && graph.value(input).nbytes() == v.nbytes()) {
+                        buffers[buffer].last = last;
+                        buffer_of[id] = buffer;
+                        in_place[id] = true;
+                        ++plan.num_in_place;
+                        break;
+                    }
+                }
+            }
+            if (buffer_of[id] < 0) {
+                buffer_of[id] = static_cast<int64_t>(buffers.size());
+                buffers.push_back(Buffer{v.backend, alignUp(v.nbytes()), i, last});
+            }
+            plan.naive_bytes[static_cast<size_t>(v.backend)] += alignUp(v.nbytes());
+        }
+    }
+
+    // 贪心best-fit：按大小从大到小放置，在时间上重叠的已放置缓冲区之间找最小的足够大的空隙
+    std::vector<size_t> order(buffers.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return buffers[a].nbytes > buffers[b].nbytes; });
+
+    std::vector<size_t> placed;
+    std::vector<const Buffer*> overlapping;
+    for (size_t index : order) {
+        Buffer& buffer = buffers[index];
+        overlapping.clear();
+        for (size_t other : placed) {
+            const Buffer& b = buffers[other];
+            if (b.backend == buffer.backend && b.first <= buffer.last && buffer.first <= b.last) {
+                overlapping.push_back(&b);
+            }
+        }
+        std::sort(overlapping.begin(), overlapping.end(),
+                  [](const Buffer* a, const Buffer* b) { return a->offset < b->offset; });
+
+        size_t best_offset = 0;
+        size_t best_gap = SIZE_MAX;
+        size_t cursor = 0;
+        for (const Buffer* b : overlapping) {
+            if (b->offset >= cursor + buffer.nbytes && b->offset - cursor < best_gap) {
+                best_gap = b->offset - cursor;
+                best_offset = cursor;
+            }
+            cursor = std::max(cursor, b->offset + b->nbytes);
+        }
+        // 没有足够大的空隙时放在所有重叠缓冲区之后
+        buffer.offset = best_gap == SIZE_MAX ? cursor : best_offset;
+        placed.push_back(index);
+
+        size_t& planned = plan.planned_bytes[static_cast<size_t>(buffer.backend)];
+        planned = std::max(planned, buffer.offset + buffer.nbytes);
+    }
+
+    // 输出每个值的位置
+    for (uint32_t id = 0; id < num_values; ++id) {
+        if (buffer_of[id] >= 0) {
+            const Buffer& buffer = buffers[buffer_of[id]];
+            plan.by_value[id] = static_cast<int32_t>(plan.assignments.size());
+            plan.assignments.push_back(
+                MemoryPlan::Assignment{buffer.backend, buffer.offset, graph.value(id).nbytes(), in_place[id]});
+        }
+    }
+    return plan;
+}
+
+std::string MemoryPlan::toString() const {
+    std::ostringstream oss;
+    bool first = true;
+    for (size_t backend = 0; backend < kNumBackends; ++backend) {
+        if (naive_bytes[backend] == 0) {
+            continue;
+        }
+        size_t num_values = 0;
+        size_t num_backend_in_place = 0;
+        for (const Assignment& assignment : assignments) {
+            if (static_cast<size_t>(assignment.backend) == backend) {
+                ++num_values;
+                num_backend_in_place += assignment.in_place ? 1 : 0;
+            }
+        }
+        if (!first) oss << "\n";
+        first = false;
+        oss << dispatcher::toString(static_cast<DispatchKey>(backend)) << ": planned=" << planned_bytes[backend]
+            << "B, naive=" << naive_bytes[backend] << "B (" << num_values << " values, " << num_backend_in_place
+            << " in-place)";
+    }
+    return first ? "no intermediate tensors" : oss.str();
+}
+
+// === SlabAllocator ===
+
+SlabAllocator::SlabAllocator(DispatchKey backend, size_t nbytes)
+    : backend_(backend), allocator_(getAllocator(backend)), slab_bytes_(nbytes) {
+    slab_ = static_cast<char*>(allocator_->allocate(slab_bytes_));
+}
+
+SlabAllocator::~SlabAllocator() {
+    allocator_->deallocate(slab_, slab_bytes_);
+}
+
+OutputRegion SlabAllocator::region(size_t offset, size_t nbytes) const {
+    if (offset + nbytes > slab_bytes_) {
+        throw std::runtime_error("SlabAllocator: 区域 [" + std::to_string(offset) + ", " +
+                                 std::to_string(offset + nbytes) + ") 超出slab大小 " + std::to_string(slab_bytes_));
+    }
+    return OutputRegion{backend_, slab_ + offset, nbytes};
+}
+
+} // namespace dispatcher
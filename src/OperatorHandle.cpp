@@ -1,8 +1,13 @@
 #include "OperatorHandle.h"
 #include "TensorImpl.h"
+#include "Epoch.h"
+#include "Dispatcher.h"
+#include "StaticRegistration.h"
+#include "EventRecorder.h"
+#include <chrono>
+#include <exception>
 #include <stdexcept>
 #include <sstream>
-#include <algorithm>
 
 namespace dispatcher {
 
@@ -11,90 +16,312 @@ KernelFunction::KernelFunction(BoxedKernelFunction boxed_fn)
     : boxed_fn_(std::move(boxed_fn)) {
 }
 
-IValueList KernelFunction::callBoxed(const IValueList& args) const {
+void KernelFunction::callBoxed(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) const {
     if (!isValid()) {
         throw std::runtime_error("Attempting to call invalid KernelFunction");
     }
-    return boxed_fn_(args);
+    boxed_fn_(op, ks, stack);
+}
+
+void KernelFunction::callBatched(const OperatorHandle& op, DispatchKeySet ks, Stack* stacks, size_t count) const {
+    if (batched_fn_) {
+        batched_fn_(op, ks, stacks, count);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        callBoxed(op, ks, &stacks[i]);
+    }
+}
+
+// DispatchTable实现
+const KernelFunction* OperatorHandle::DispatchTable::resolveKernel(const DispatchKeySet& ks) const {
+    // 按优先级顺序查找第一个有对应内核的dispatch key，
+    // 操作符自己的内核优先，没有时使用该key的全局fallback
+    for (auto key : ks) {
+        size_t index = static_cast<size_t>(key);
+        if (kernels[index].isValid()) {
+            return &kernels[index];
+        }
+        if (fallbacks[index].isValid()) {
+            return &fallbacks[index];
+        }
+    }
+    
+    // 如果没有找到匹配的内核，尝试CatchAll内核作为fallback
+    size_t catch_all = static_cast<size_t>(DispatchKey::CatchAll);
+    if (kernels[catch_all].isValid()) {
+        return &kernels[catch_all];
+    }
+    if (fallbacks[catch_all].isValid()) {
+        return &fallbacks[catch_all];
+    }
+    
+    // 没有找到任何匹配的内核
+    return nullptr;
+}
+
+DispatchKey OperatorHandle::DispatchTable::keyOf(const KernelFunction* kernel) const {
+    if (kernel >= fallbacks.data() && kernel < fallbacks.data() + fallbacks.size()) {
+        return static_cast<DispatchKey>(kernel - fallbacks.data());
+    }
+    return static_cast<DispatchKey>(kernel - kernels.data());
+}
+
+void OperatorHandle::DispatchTable::rebuild() {
+    // 为每一种key set组合预先计算查找结果
+    for (size_t mask = 0; mask < kNumKeySetMasks; ++mask) {
+        resolved[mask] = resolveKernel(DispatchKeySet::fromRaw(mask));
+    }
+}
+
+// KernelTableUpdate实现
+OperatorHandle::KernelTableUpdate::KernelTableUpdate(OperatorHandle& handle)
+    : handle_(&handle), lock_(handle.write_mutex_), uncaught_exceptions_(std::uncaught_exceptions()) {
+    // 持有写锁后复制当前版本，resolved在发布前重建
+    const DispatchTable* current = handle.materializeTableLocked();
+    pending_ = std::make_unique<DispatchTable>();
+    pending_->kernels = current->kernels;
+    pending_->schema = current->schema;
+}
+
+OperatorHandle::KernelTableUpdate::~KernelTableUpdate() {
+    // 批量修改是原子的：中途失败的批量一项都不发布
+    if (!pending_ || std::uncaught_exceptions() > uncaught_exceptions_) {
+        return;
+    }
+    try {
+        publish();
+    } catch (...) {
+        // 析构函数不能抛出，发布失败时丢弃修改，当前版本保持不变
+    }
+}
+
+// 第一个unboxed内核确定操作符的schema，之后的unboxed内核必须与之一致
+static void mergeKernelSchema(const std::string& op_name, std::shared_ptr<const FunctionSchema>& schema,
+                              DispatchKey key, const KernelFunction& kernel) {
+    if (const auto& kernel_schema = kernel.schema()) {
+        if (!schema) {
+            schema = kernel_schema;
+        } else if (*schema != *kernel_schema) {
+            throw std::runtime_error("Kernel for operator '" + op_name + "' at dispatch key " +
+                                   toString(key) + " has schema " + kernel_schema->toString() +
+                                   ", expected " + schema->toString());
+        }
+    }
+}
+
+OperatorHandle::KernelTableUpdate& OperatorHandle::KernelTableUpdate::setKernel(DispatchKey key, KernelFunction kernel) {
+    mergeKernelSchema(handle_->name_, pending_->schema, key, kernel);
+    pending_->kernels[static_cast<size_t>(key)] = std::move(kernel);
+    return *this;
+}
+
+OperatorHandle::KernelTableUpdate& OperatorHandle::KernelTableUpdate::removeKernel(DispatchKey key) {
+    pending_->kernels[static_cast<size_t>(key)] = KernelFunction();
+    return *this;
+}
+
+void OperatorHandle::KernelTableUpdate::publish() {
+    if (!pending_) {
+        throw std::runtime_error("KernelTableUpdate for operator '" + handle_->name_ + "' was already published");
+    }
+    pending_->fallbacks = Dispatcher::instance().getFallbacks();
+    pending_->rebuild();
+    
+    // 原子替换，正在使用旧表的读者由EpochManager保证安全
+    const DispatchTable* old = handle_->table_.exchange(pending_.release(), std::memory_order_acq_rel);
+    Dispatcher::bumpDispatchVersion();
+    EpochManager::instance().retire(old);
+    lock_.unlock();
 }
 
 // OperatorHandle实现
-OperatorHandle::OperatorHandle(std::string name) : name_(std::move(name)) {
+OperatorHandle::OperatorHandle(std::string name, OperatorId id)
+    : name_(std::move(name)), id_(id) {
+    // 初始表没有任何内核，但已注册的全局fallback从一开始就生效
+    auto table = std::make_unique<DispatchTable>();
+    table->fallbacks = Dispatcher::instance().getFallbacks();
+    table->rebuild();
+    table_.store(table.release(), std::memory_order_release);
+}
+
+OperatorHandle::OperatorHandle(std::string name, OperatorId id, ArrayRef<StaticKernelEntry> static_kernels)
+    : name_(std::move(name)), id_(id), table_(nullptr), static_kernels_(static_kernels) {
+}
+
+const OperatorHandle::DispatchTable* OperatorHandle::materializeTable() const {
+    std::lock_guard<std::mutex> lock(write_mutex_);
+    return materializeTableLocked();
+}
+
+const OperatorHandle::DispatchTable* OperatorHandle::materializeTableLocked() const {
+    // 其他线程可能已经建立了表；建立之后table_不会再回到nullptr
+    if (const DispatchTable* table = table_.load(std::memory_order_acquire)) {
+        return table;
+    }
+    auto table = std::make_unique<DispatchTable>();
+    for (const StaticKernelEntry& entry : static_kernels_) {
+        KernelFunction kernel = entry.make_kernel();
+        mergeKernelSchema(name_, table->schema, entry.key, kernel);
+        table->kernels[static_cast<size_t>(entry.key)] = std::move(kernel);
+    }
+    table->fallbacks = Dispatcher::instance().getFallbacks();
+    table->rebuild();
+    const DispatchTable* result = table.release();
+    table_.store(result, std::memory_order_release);
+    return result;
+}
+
+void OperatorHandle::refreshFallbacks() {
+    {
+        std::lock_guard<std::mutex> lock(write_mutex_);
+        if (!table_.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+    updateKernels().publish();
+}
+
+OperatorHandle::~OperatorHandle() {
+    // 句柄本身只在没有读者之后才会被析构，可以直接释放当前表
+    delete table_.load();
 }
 
 void OperatorHandle::setKernel(DispatchKey key, KernelFunction kernel) {
     // 将内核函数注册到指定的dispatch key
-    dispatch_table_[key] = std::move(kernel);
+    updateKernels().setKernel(key, std::move(kernel));
 }
 
 void OperatorHandle::removeKernel(DispatchKey key) {
     // 从dispatch table中移除指定的内核
-    dispatch_table_.erase(key);
+    updateKernels().removeKernel(key);
+}
+
+OperatorHandle::KernelTableUpdate OperatorHandle::updateKernels() {
+    return KernelTableUpdate(*this);
 }
 
 bool OperatorHandle::hasKernel(DispatchKey key) const {
     // 检查是否存在指定dispatch key的内核
-    return dispatch_table_.find(key) != dispatch_table_.end();
+    EpochManager::ReadGuard guard;
+    return currentTable()->kernels[static_cast<size_t>(key)].isValid();
+}
+
+const FunctionSchema* OperatorHandle::schema() const {
+    EpochManager::ReadGuard guard;
+    return currentTable()->schema.get();
 }
 
 const KernelFunction* OperatorHandle::findKernel(const DispatchKeySet& ks) const {
-    // 这是dispatch的核心逻辑：按优先级顺序查找第一个可用的内核
-    
-    // 获取按优先级排序的dispatch key列表
-    auto keys = ks.toVector();
-    
-    // 按优先级顺序查找第一个有对应内核的dispatch key
-    for (auto key : keys) {
-        auto it = dispatch_table_.find(key);
-        if (it != dispatch_table_.end()) {
-            return &it->second;
-        }
+    // 这是dispatch的核心逻辑：所有key set组合的结果已经预先解析好
+    return currentTable()->resolved[ks.raw()];
+}
+
+const KernelFunction* OperatorHandle::findKernel(const DispatchKeySet& ks, DispatchKey* kernel_key) const {
+    const DispatchTable* table = currentTable();
+    const KernelFunction* kernel = table->resolved[ks.raw()];
+    if (kernel) {
+        *kernel_key = table->keyOf(kernel);
     }
+    return kernel;
+}
+
+void OperatorHandle::callBoxed(const DispatchKeySet& ks, Stack* stack) const {
+    EpochManager::ReadGuard guard;
     
-    // 如果没有找到匹配的内核，尝试CatchAll内核作为fallback
-    auto catch_all_it = dispatch_table_.find(DispatchKey::CatchAll);
-    if (catch_all_it != dispatch_table_.end()) {
-        return &catch_all_it->second;
+    // 入口处一次性校验参数，之后的内核（包括重新分发的各层）都走不检查的快速路径
+    const FunctionSchema* op_schema = currentTable()->schema.get();
+    if (op_schema && !op_schema->matches(*stack)) {
+        op_schema->throwMismatch(name_, *stack);
     }
     
-    // 没有找到任何匹配的内核
-    return nullptr;
+    callBoxedUnchecked(ks, stack);
 }
 
-IValueList OperatorHandle::call(const DispatchKeySet& ks, const IValueList& args) const {
+void OperatorHandle::callBoxedUnchecked(const DispatchKeySet& ks, Stack* stack) const {
+    // 内核执行期间保持在epoch临界区内，保证表不会被并发发布的新版本释放
+    EpochManager::ReadGuard guard;
+    
     // 查找匹配的内核函数
-    const KernelFunction* kernel = findKernel(ks);
+    const DispatchTable* table = currentTable();
+    const KernelFunction* kernel = table->resolved[ks.raw()];
     
     if (!kernel) {
         throw std::runtime_error("No kernel found for operator '" + name_ + 
                                "' with dispatch key set " + ks.toString());
     }
     
+    callKernel(*kernel, table->keyOf(kernel), ks, stack);
+}
+
+void OperatorHandle::callKernel(const KernelFunction& kernel, DispatchKey kernel_key, const DispatchKeySet& ks,
+                                Stack* stack) const {
+    // 开启事件记录时记录这一层的调用，redispatch到下一层时形成嵌套
+    DispatchEventScope event;
+    if (DispatchEventScope::enabled()) {
+        event.begin(id_, kernel_key);
+    }
+    
+    // 采样时记录实际执行的内核所属的dispatch key及其耗时
+    if (Dispatcher::shouldSampleLatency()) {
+        auto start = std::chrono::steady_clock::now();
+        kernel.callBoxed(*this, ks, stack);
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        Dispatcher::instance().recordLatency(id_, kernel_key, static_cast<uint64_t>(nanos.count()));
+        return;
+    }
+    
     // 调用找到的内核函数
-    return kernel->callBoxed(args);
+    kernel.callBoxed(*this, ks, stack);
+}
+
+void OperatorHandle::callKernelBatched(const KernelFunction& kernel, DispatchKey kernel_key, const DispatchKeySet& ks,
+                                       Stack* stacks, size_t count) const {
+    // 与callKernel相同的插桩：一组调用只进入内核一次，记录为一个事件；采样的耗时按组内的调用数平摊
+    DispatchEventScope event;
+    if (DispatchEventScope::enabled()) {
+        event.begin(id_, kernel_key);
+    }
+    
+    if (Dispatcher::shouldSampleLatency()) {
+        auto start = std::chrono::steady_clock::now();
+        kernel.callBatched(*this, ks, stacks, count);
+        auto nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        Dispatcher::instance().recordLatency(id_, kernel_key, static_cast<uint64_t>(nanos.count()) / count);
+        return;
+    }
+    
+    kernel.callBatched(*this, ks, stacks, count);
+}
+
+void OperatorHandle::callBoxed(Stack* stack) const {
+    // 从栈上的参数自动计算dispatch key set
+    callBoxed(computeDispatchKeySet(*stack), stack);
+}
+
+IValueList OperatorHandle::call(const DispatchKeySet& ks, const IValueList& args) const {
+    // 兼容层：参数栈在调用结束后就是结果列表，只有这一次分配
+    Stack stack(args);
+    callBoxed(ks, &stack);
+    return stack;
 }
 
 IValueList OperatorHandle::call(const IValueList& args) const {
     // 从参数自动计算dispatch key set
-    DispatchKeySet ks = computeDispatchKeySet(args);
-    return call(ks, args);
+    return call(computeDispatchKeySet(args), args);
 }
 
 std::vector<DispatchKey> OperatorHandle::getRegisteredKeys() const {
-    std::vector<DispatchKey> keys;
-    
-    // 收集所有已注册的dispatch key
-    for (const auto& entry : dispatch_table_) {
-        keys.push_back(entry.first);
+    // 收集所有已注册的dispatch key，DispatchKeySet的遍历顺序即优先级顺序
+    EpochManager::ReadGuard guard;
+    const DispatchTable* table = currentTable();
+    DispatchKeySet keys;
+    for (size_t i = 0; i < kNumDispatchKeys; ++i) {
+        if (table->kernels[i].isValid()) {
+            keys.add(static_cast<DispatchKey>(i));
+        }
     }
-    
-    // 按优先级排序
-    std::sort(keys.begin(), keys.end(),
-              [](DispatchKey a, DispatchKey b) {
-                  return dispatchKeyPriority(a) < dispatchKeyPriority(b);
-              });
-    
-    return keys;
+    return keys.toVector();
 }
 
 std::string OperatorHandle::debugString() const {
@@ -111,21 +338,113 @@ std::string OperatorHandle::debugString() const {
 }
 
 DispatchKeySet OperatorHandle::computeDispatchKeySet(const IValueList& args) const {
-    std::vector<std::shared_ptr<TensorImpl>> tensors;
-    
-    // 从参数中提取所有tensor
-    for (const auto& arg : args) {
-        if (arg.isTensor()) {
-            tensors.push_back(arg.toTensor());
-        } else if (arg.isTensorList()) {
-            // 如果参数是tensor列表，展开所有tensor
-            auto tensor_list = arg.toTensorList();
-            tensors.insert(tensors.end(), tensor_list.begin(), tensor_list.end());
+    EpochManager::ReadGuard guard;
+    return computeDispatchKeySet(currentTable()->schema.get(), args);
+}
+
+DispatchKeySet OperatorHandle::computeDispatchKeySet(const FunctionSchema* op_schema, const IValueList& args) {
+    DispatchKeySet ks;
+    bool has_tensor = false;
+    
+    // 直接从IValue内部存储读取tensor（包括TensorList中的元素），
+    // 只OR各tensor缓存的key位，不拷贝句柄也不分配内存
+    auto collect = [&](const Tensor& tensor) {
+        if (tensor) {
+            ks |= tensor->tensorKeySet();
+            has_tensor = true;
+        }
+    };
+    
+    if (op_schema && args.size() == op_schema->arguments.size() && args.size() <= 64) {
+        // schema已知时只访问tensor参数所在的槽位
+        for (uint64_t mask = op_schema->tensor_arguments; mask != 0; mask &= mask - 1) {
+            args[static_cast<size_t>(__builtin_ctzll(mask))].forEachTensor(collect);
+        }
+    } else {
+        for (const auto& arg : args) {
+            arg.forEachTensor(collect);
         }
     }
     
-    // 使用utility函数计算合并的dispatch key set
-    return dispatcher::computeDispatchKeySet(tensors);
+    return finalizeDispatchKeySet(ks, has_tensor);
+}
+
+std::vector<IValueList> OperatorHandle::callBatch(ArrayRef<IValueList> batch, DispatchKeySet hint) const {
+    // 每个调用的参数复制到自己的栈上，调用结束后这些栈就是返回值
+    std::vector<Stack> stacks(batch.begin(), batch.end());
+    if (stacks.empty()) {
+        return stacks;
+    }
+    
+    EpochManager::ReadGuard guard;
+    const DispatchTable* table = currentTable();
+    const FunctionSchema* op_schema = table->schema.get();
+    
+    // 与单次调用一样在入口处校验所有参数
+    if (op_schema) {
+        for (const Stack& stack : stacks) {
+            if (!op_schema->matches(stack)) {
+                op_schema->throwMismatch(name_, stack);
+            }
+        }
+    }
+    
+    // 每组只查找一次内核，经过与单次调用相同的事件记录和延迟采样
+    auto callGroup = [&](DispatchKeySet ks, Stack* group, size_t count) {
+        const KernelFunction* kernel = table->resolved[ks.raw()];
+        if (!kernel) {
+            throw std::runtime_error("No kernel found for operator '" + name_ +
+                                   "' with dispatch key set " + ks.toString());
+        }
+        callKernelBatched(*kernel, table->keyOf(kernel), ks, group, count);
+    };
+    
+    // 调用方给出key set时整批直接交给同一个内核；与计算出的key set一样应用当前线程的包含/排除集合，
+    // 例如backward()中排除了Autograd时，带Autograd的hint也不会再进入Autograd内核
+    if (!hint.empty()) {
+        callGroup(localDispatchKeySet().apply(hint), stacks.data(), stacks.size());
+        return stacks;
+    }
+    
+    // 计算每个调用的key set；常见情况下整批相同，只需一次内核调用
+    std::vector<DispatchKeySet> key_sets;
+    key_sets.reserve(stacks.size());
+    bool homogeneous = true;
+    for (const Stack& stack : stacks) {
+        key_sets.push_back(computeDispatchKeySet(op_schema, stack));
+        homogeneous = homogeneous && key_sets.back() == key_sets.front();
+    }
+    if (homogeneous) {
+        callGroup(key_sets.front(), stacks.data(), stacks.size());
+        return stacks;
+    }
+    
+    // 混合的批次：按key set分组，把同组的栈移动到连续的缓冲区中执行后再移回原位
+    std::array<bool, kNumKeySetMasks> done{};
+    std::vector<size_t> indices;
+    std::vector<Stack> group;
+    for (size_t first = 0; first < stacks.size(); ++first) {
+        DispatchKeySet ks = key_sets[first];
+        if (done[ks.raw()]) {
+            continue;
+        }
+        done[ks.raw()] = true;
+        
+        indices.clear();
+        group.clear();
+        for (size_t i = first; i < stacks.size(); ++i) {
+            if (key_sets[i] == ks) {
+                indices.push_back(i);
+                group.push_back(std::move(stacks[i]));
+            }
+        }
+        
+        callGroup(ks, group.data(), group.size());
+        for (size_t j = 0; j < indices.size(); ++j) {
+            stacks[indices[j]] = std::move(group[j]);
+        }
+    }
+    return stacks;
 }
 
 } // namespace dispatcher 
\ No newline at end of file
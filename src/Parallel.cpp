@@ -0,0 +1,121 @@
+#include "Parallel.h"
+#include "Executor.h"
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace dispatcher {
+
+namespace {
+
+// 标记当前线程正在执行分块，作用域结束时恢复
+class ParallelRegionGuard {
+public:
+    ParallelRegionGuard() : saved_(detail::tls_in_parallel_region) { detail::tls_in_parallel_region = true; }
+    ~ParallelRegionGuard() { detail::tls_in_parallel_region = saved_; }
+
+    ParallelRegionGuard(const ParallelRegionGuard&) = delete;
+    ParallelRegionGuard& operator=(const ParallelRegionGuard&) = delete;
+
+private:
+    bool saved_;
+};
+
+// intra-op线程池，配置版本变化时重建
+// 调用方线程也参与计算，因此线程池只有numThreads()-1个工作线程，单线程配置下没有线程池
+std::shared_ptr<ThreadPool> intraOpPool() {
+    struct Holder {
+        std::mutex mutex;
+        std::shared_ptr<ThreadPool> pool;
+        uint64_t version = ~uint64_t(0);
+    };
+    static Holder holder;
+
+    const GlobalDispatchState& state = GlobalDispatchState::instance();
+    uint64_t version = state.threadConfigVersion();
+
+    std::lock_guard<std::mutex> lock(holder.mutex);
+    if (holder.version != version) {
+        size_t num_threads = state.numThreads();
+        if (num_threads == 0) {
+            num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+        }
+        // 旧线程池在最后一个正在使用它的parallel_for结束后析构
+        holder.pool = num_threads > 1 ? std::make_shared<ThreadPool>(num_threads - 1, state.threadAffinity())
+                                      : nullptr;
+        holder.version = version;
+    }
+    return holder.pool;
+}
+
+} // namespace
+
+size_t getNumIntraOpThreads() {
+    std::shared_ptr<ThreadPool> pool = intraOpPool();
+    return pool ? pool->numThreads() + 1 : 1;
+}
+
+namespace detail {
+
+void parallelForImpl(int64_t begin, int64_t end, int64_t grain_size,
+                     const std::function<void(int64_t, int64_t)>& fn) {
+    std::shared_ptr<ThreadPool> pool = intraOpPool();
+    if (!pool) {
+        fn(begin, end);
+        return;
+    }
+
+    // 块数不超过线程数，也不让任何一块小于grain_size
+    int64_t range = end - begin;
+    int64_t grain = std::max<int64_t>(grain_size, 1);
+    int64_t max_chunks = static_cast<int64_t>(pool->numThreads() + 1);
+    int64_t num_chunks = std::min(max_chunks, (range + grain - 1) / grain);
+    int64_t chunk_size = (range + num_chunks - 1) / num_chunks;
+
+    // 等待所有分块完成的计数器；分块只引用调用方栈上的状态，调用方返回前必定等待它们结束
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    int64_t remaining = num_chunks - 1;
+    std::exception_ptr first_exception;
+
+    auto run_chunk = [&](int64_t chunk) {
+        int64_t chunk_begin = begin + chunk * chunk_size;
+        int64_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        if (chunk_begin >= chunk_end) {
+            return;
+        }
+        ParallelRegionGuard region;
+        try {
+            fn(chunk_begin, chunk_end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!first_exception) {
+                first_exception = std::current_exception();
+            }
+        }
+    };
+
+    for (int64_t chunk = 1; chunk < num_chunks; ++chunk) {
+        pool->submit([&, chunk]() {
+            run_chunk(chunk);
+            // 持锁通知：调用方被唤醒后会立即销毁done_cv
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--remaining == 0) {
+                done_cv.notify_one();
+            }
+        });
+    }
+    run_chunk(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&]() { return remaining == 0; });
+    if (first_exception) {
+        std::rethrow_exception(first_exception);
+    }
+}
+
+} // namespace detail
+
+} // namespace dispatcher
@@ -0,0 +1,49 @@
+#include "ShapeInference.h"
+#include "Dispatcher.h"
+#include <stdexcept>
+
+namespace dispatcher {
+
+void registerShapeFunction(const std::string& op_name, ShapeFunction shape_fn) {
+    if (!shape_fn) {
+        throw std::runtime_error("registerShapeFunction: 操作符 '" + op_name + "' 的形状函数为空");
+    }
+    auto& op = registerOp(op_name);
+    REGISTER_KERNEL(op, Meta, BoxedKernelFunction([shape_fn = std::move(shape_fn)](const OperatorHandle&, DispatchKeySet,
+                                                                                  Stack* stack) {
+        Tensor result = make_tensor_meta(shape_fn(*stack));
+        stack->clear();
+        stack->push_back(IValue(std::move(result)));
+    }));
+}
+
+std::vector<int64_t> elementwiseShape(const Stack& args) {
+    const Tensor* first = nullptr;
+    for (const IValue& arg : args) {
+        if (!arg.isTensor()) {
+            continue;
+        }
+        const Tensor& tensor = arg.toTensorRef();
+        if (!tensor) {
+            throw std::runtime_error("elementwiseShape: 输入tensor为空");
+        }
+        if (!first) {
+            first = &tensor;
+        } else if (tensor->numel() != (*first)->numel()) {
+            throw std::runtime_error("elementwiseShape: 元素数不匹配，" + (*first)->debugString() + " 与 " +
+                                     tensor->debugString());
+        }
+    }
+    if (!first) {
+        throw std::runtime_error("elementwiseShape: 没有tensor参数");
+    }
+    return (*first)->sizes();
+}
+
+void elementwise_meta_kernel(const OperatorHandle&, DispatchKeySet, Stack* stack) {
+    Tensor result = make_tensor_meta(elementwiseShape(*stack));
+    stack->clear();
+    stack->push_back(IValue(std::move(result)));
+}
+
+} // namespace dispatcher
@@ -0,0 +1,44 @@
+#include "StaticRegistration.h"
+#include <stdexcept>
+#include <vector>
+
+#if defined(__ELF__)
+// 链接器为段dispatcher_kernels自动生成的边界符号；没有任何静态条目时段不存在，弱引用解析为nullptr
+extern "C" {
+extern const dispatcher::StaticKernelEntry __start_dispatcher_kernels[] __attribute__((weak));
+extern const dispatcher::StaticKernelEntry __stop_dispatcher_kernels[] __attribute__((weak));
+}
+#endif
+
+namespace dispatcher {
+
+namespace detail {
+// 没有链接段支持时登记的条目；只在动态初始化阶段写入
+static std::vector<StaticKernelEntry>& registeredEntries() {
+    static std::vector<StaticKernelEntry> entries;
+    return entries;
+}
+
+StaticKernelRegistrar::StaticKernelRegistrar(const StaticKernelEntry& entry) {
+    registeredEntries().push_back(entry);
+}
+} // namespace detail
+
+ArrayRef<StaticKernelEntry> staticKernelEntries() {
+#if defined(__ELF__)
+    if (__start_dispatcher_kernels && __stop_dispatcher_kernels) {
+        const char* begin = reinterpret_cast<const char*>(__start_dispatcher_kernels);
+        const char* end = reinterpret_cast<const char*>(__stop_dispatcher_kernels);
+        if ((end - begin) % sizeof(StaticKernelEntry) != 0) {
+            throw std::runtime_error("dispatcher_kernels段的大小不是StaticKernelEntry的整数倍");
+        }
+        return ArrayRef<StaticKernelEntry>(__start_dispatcher_kernels,
+                                           static_cast<size_t>(__stop_dispatcher_kernels - __start_dispatcher_kernels));
+    }
+    return ArrayRef<StaticKernelEntry>();
+#else
+    return ArrayRef<StaticKernelEntry>(detail::registeredEntries());
+#endif
+}
+
+} // namespace dispatcher
@@ -2,12 +2,58 @@
 #include <numeric>
 #include <sstream>
 #include <algorithm>
+#include <cstring>
+#include <stdexcept>
 
 namespace dispatcher {
 
 // TensorImpl实现
+std::vector<int64_t> contiguousStrides(const std::vector<int64_t>& sizes) {
+    std::vector<int64_t> strides(sizes.size());
+    int64_t stride = 1;
+    for (size_t i = sizes.size(); i-- > 0;) {
+        strides[i] = stride;
+        stride *= std::max<int64_t>(sizes[i], 1);
+    }
+    return strides;
+}
+
+// 大小为1的维度的stride不影响元素位置，不参与判断
+static bool computeIsContiguous(const std::vector<int64_t>& sizes, const std::vector<int64_t>& strides) {
+    int64_t expected = 1;
+    for (size_t i = sizes.size(); i-- > 0;) {
+        if (sizes[i] == 0) {
+            return true;
+        }
+        if (sizes[i] != 1) {
+            if (strides[i] != expected) {
+                return false;
+            }
+            expected *= sizes[i];
+        }
+    }
+    return true;
+}
+
 TensorImpl::TensorImpl(std::vector<int64_t> sizes, DispatchKey backend_key)
-    : sizes_(std::move(sizes)), backend_key_(backend_key) {
+    : sizes_(std::move(sizes)), strides_(contiguousStrides(sizes_)), backend_key_(backend_key), key_set_(backend_key) {
+    if (backend_key_ != DispatchKey::Meta) {
+        storage_ = make_storage(nbytes(), backend_key_);
+    }
+}
+
+TensorImpl::TensorImpl(Storage storage, std::vector<int64_t> sizes, std::vector<int64_t> strides,
+                       int64_t storage_offset, DispatchKey backend_key)
+    : sizes_(std::move(sizes)),
+      strides_(std::move(strides)),
+      storage_offset_(storage_offset),
+      is_contiguous_(computeIsContiguous(sizes_, strides_)),
+      backend_key_(backend_key),
+      key_set_(backend_key),
+      storage_(std::move(storage)) {
+    if (strides_.size() != sizes_.size()) {
+        throw std::runtime_error("TensorImpl: strides与sizes的维度数不一致");
+    }
 }
 
 int64_t TensorImpl::numel() const {
@@ -18,21 +64,8 @@ int64_t TensorImpl::numel() const {
 }
 
 DispatchKeySet TensorImpl::keySet() const {
-    DispatchKeySet result;
-    
-    // 第一步：添加backend dispatch key
-    result.add(backend_key_);
-    
-    // 第二步：根据tensor属性添加功能性dispatch key
-    if (requires_grad_) {
-        result.add(DispatchKey::Autograd);
-    }
-    
-    // 第三步：添加全局状态的功能性dispatch key
-    auto global_keys = GlobalDispatchState::instance().computeFunctionalityKeys();
-    result |= global_keys;
-    
-    return result;
+    // 缓存的tensor自身key（backend + Autograd）加上全局状态的功能性key
+    return key_set_ | GlobalDispatchState::instance().computeFunctionalityKeys();
 }
 
 std::string TensorImpl::debugString() const {
@@ -42,51 +75,101 @@ std::string TensorImpl::debugString() const {
         if (i > 0) oss << ", ";
         oss << sizes_[i];
     }
-    oss << "], backend=" << toString(backend_key_);
+    oss << "]";
+    if (!is_contiguous_) {
+        oss << ", strides=[";
+        for (size_t i = 0; i < strides_.size(); ++i) {
+            if (i > 0) oss << ", ";
+            oss << strides_[i];
+        }
+        oss << "]";
+    }
+    if (storage_offset_ != 0) {
+        oss << ", offset=" << storage_offset_;
+    }
+    oss << ", backend=" << toString(backend_key_);
     if (requires_grad_) {
         oss << ", requires_grad=true";
     }
     return oss.str();
 }
 
-std::shared_ptr<TensorImpl> TensorImpl::clone() const {
-    auto cloned = std::make_shared<TensorImpl>(sizes_, backend_key_);
+Tensor TensorImpl::clone() const {
+    auto cloned = make_intrusive<TensorImpl>(sizes_, backend_key_);
+    int64_t n = is_meta() ? 0 : numel();
+    if (n > 0 && is_contiguous_) {
+        std::memcpy(cloned->data(), data(), nbytes());
+    } else if (n > 0) {
+        // 按行优先顺序逐个收集元素：index是当前元素的多维下标，src是它在storage中的位置
+        const float* base = static_cast<const float*>(storage_->data());
+        float* dst = cloned->data();
+        std::vector<int64_t> index(sizes_.size(), 0);
+        int64_t src = storage_offset_;
+        for (int64_t i = 0; i < n; ++i) {
+            dst[i] = base[src];
+            for (size_t d = sizes_.size(); d-- > 0;) {
+                if (++index[d] < sizes_[d]) {
+                    src += strides_[d];
+                    break;
+                }
+                src -= strides_[d] * (sizes_[d] - 1);
+                index[d] = 0;
+            }
+        }
+    }
     cloned->setRequiresGrad(requires_grad_);
     return cloned;
 }
 
-// 工厂函数实现
-std::shared_ptr<TensorImpl> make_tensor_cpu(std::vector<int64_t> sizes) {
-    return std::make_shared<TensorImpl>(std::move(sizes), DispatchKey::CPU);
+Tensor TensorImpl::contiguous() const {
+    if (is_contiguous_) {
+        return Tensor(const_cast<TensorImpl*>(this));
+    }
+    return clone();
+}
+
+// 工厂函数实现 - TensorImpl和引用计数在同一次分配中创建
+Tensor make_tensor_cpu(std::vector<int64_t> sizes) {
+    return make_intrusive<TensorImpl>(std::move(sizes), DispatchKey::CPU);
 }
 
-std::shared_ptr<TensorImpl> make_tensor_cuda(std::vector<int64_t> sizes) {
-    return std::make_shared<TensorImpl>(std::move(sizes), DispatchKey::CUDA);
+Tensor make_tensor_cuda(std::vector<int64_t> sizes) {
+    return make_intrusive<TensorImpl>(std::move(sizes), DispatchKey::CUDA);
+}
+
+Tensor make_tensor_meta(std::vector<int64_t> sizes) {
+    return make_intrusive<TensorImpl>(std::move(sizes), DispatchKey::Meta);
+}
+
+Tensor make_output_tensor(DispatchKey backend, std::vector<int64_t> sizes) {
+    if (backend == DispatchKey::Meta) {
+        return make_tensor_meta(std::move(sizes));
+    }
+    size_t numel = sizes.empty() ? 0 : 1;
+    for (int64_t size : sizes) {
+        numel *= static_cast<size_t>(size);
+    }
+    Storage storage = make_output_storage(numel * TensorImpl::kElementSize, backend);
+    std::vector<int64_t> strides = contiguousStrides(sizes);
+    return make_intrusive<TensorImpl>(std::move(storage), std::move(sizes), std::move(strides), 0, backend);
 }
 
 // 工具函数 - 计算多个tensor的合并dispatch key set
-DispatchKeySet computeDispatchKeySet(const std::vector<std::shared_ptr<TensorImpl>>& tensors) {
+DispatchKeySet computeDispatchKeySet(const std::vector<Tensor>& tensors) {
     DispatchKeySet combined_set;
+    bool has_tensor = false;
     
-    // 遍历所有tensor，合并它们的dispatch key set
+    // 遍历所有tensor，合并它们缓存的dispatch key set，全局状态最后统一合并一次
     for (const auto& tensor : tensors) {
         if (tensor) {  // 检查tensor是否为空
-            combined_set |= tensor->keySet();
-        }
-    }
-    
-    // 如果没有tensor，返回包含全局状态和默认CPU backend的dispatch key set
-    if (combined_set.empty()) {
-        combined_set = GlobalDispatchState::instance().computeFunctionalityKeys();
-        
-        // 如果仍然为空（没有全局功能性key），则添加默认的CPU backend key
-        // 这确保了标量操作等不涉及tensor的操作能够正确分发
-        if (combined_set.empty()) {
-            combined_set.add(DispatchKey::CPU);
+            combined_set |= tensor->tensorKeySet();
+            has_tensor = true;
         }
     }
     
-    return combined_set;
+    // 没有tensor时使用默认的CPU backend key
+    // 这确保了标量操作等不涉及tensor的操作能够正确分发
+    return finalizeDispatchKeySet(combined_set, has_tensor);
 }
 
 // GlobalDispatchState实现
@@ -95,23 +178,22 @@ GlobalDispatchState& GlobalDispatchState::instance() {
     return instance;
 }
 
-DispatchKeySet GlobalDispatchState::computeFunctionalityKeys() const {
-    DispatchKeySet result;
-    
-    // 根据全局状态添加对应的dispatch key
-    if (autograd_enabled_) {
-        result.add(DispatchKey::Autograd);
-    }
-    
-    if (tracing_enabled_) {
-        result.add(DispatchKey::Tracing);
-    }
-    
-    if (profiling_enabled_) {
-        result.add(DispatchKey::Profiling);
+void GlobalDispatchState::setNumThreads(size_t num_threads) {
+    num_threads_.store(num_threads, std::memory_order_relaxed);
+    thread_config_version_.fetch_add(1, std::memory_order_release);
+}
+
+void GlobalDispatchState::setThreadAffinity(std::vector<int> cores) {
+    {
+        std::lock_guard<std::mutex> lock(affinity_mutex_);
+        thread_affinity_ = std::move(cores);
     }
-    
-    return result;
+    thread_config_version_.fetch_add(1, std::memory_order_release);
+}
+
+std::vector<int> GlobalDispatchState::threadAffinity() const {
+    std::lock_guard<std::mutex> lock(affinity_mutex_);
+    return thread_affinity_;
 }
 
 } // namespace dispatcher 
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "TensorViews.h"
+#include "Autograd.h"
+#include "Dispatcher.h"
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace dispatcher {
+
+static void checkTensor(const Tensor& self, const char* op_name) {
+    if (!self) {
+        throw std::runtime_error(std::string(op_name) + ": 输入tensor为空");
+    }
+}
+
+// 把可能为负的维度编号转换为[0, dim)
+static size_t wrapDim(int64_t dim, int64_t ndim, const char* op_name) {
+    int64_t wrapped = dim < 0 ? dim + ndim : dim;
+    if (wrapped < 0 || wrapped >= ndim) {
+        throw std::runtime_error(std::string(op_name) + ": 维度 " + std::to_string(dim) + " 超出范围 [" +
+                                 std::to_string(-ndim) + ", " + std::to_string(ndim - 1) + "]");
+    }
+    return static_cast<size_t>(wrapped);
+}
+
+// 视图不继承requires_grad：梯度只能经由Autograd内核记录的反向节点回到原tensor（见下面的Autograd一节）
+static Tensor makeView(const Tensor& self, std::vector<int64_t> sizes, std::vector<int64_t> strides,
+                       int64_t storage_offset) {
+    return make_intrusive<TensorImpl>(self->storage(), std::move(sizes), std::move(strides), storage_offset,
+                                      self->backendKey());
+}
+
+Tensor slice(const Tensor& self, int64_t dim, int64_t start, int64_t end, int64_t step) {
+    checkTensor(self, "slice");
+    if (step <= 0) {
+        throw std::runtime_error("slice: step必须为正数，实际为 " + std::to_string(step));
+    }
+    size_t d = wrapDim(dim, self->dim(), "slice");
+    int64_t size = self->sizes()[d];
+    auto clamp = [size](int64_t index) {
+        if (index < 0) {
+            index += size;
+        }
+        return std::min(std::max<int64_t>(index, 0), size);
+    };
+    start = clamp(start);
+    end = std::max(clamp(end), start);
+
+    std::vector<int64_t> sizes = self->sizes();
+    std::vector<int64_t> strides = self->strides();
+    sizes[d] = (end - start + step - 1) / step;
+    strides[d] *= step;
+    return makeView(self, std::move(sizes), std::move(strides), self->storageOffset() + start * self->strides()[d]);
+}
+
+Tensor transpose(const Tensor& self, int64_t dim0, int64_t dim1) {
+    checkTensor(self, "transpose");
+    size_t d0 = wrapDim(dim0, self->dim(), "transpose");
+    size_t d1 = wrapDim(dim1, self->dim(), "transpose");
+    std::vector<int64_t> sizes = self->sizes();
+    std::vector<int64_t> strides = self->strides();
+    std::swap(sizes[d0], sizes[d1]);
+    std::swap(strides[d0], strides[d1]);
+    return makeView(self, std::move(sizes), std::move(strides), self->storageOffset());
+}
+
+// 推断-1对应的大小，并检查元素数一致
+static std::vector<int64_t> inferSizes(std::vector<int64_t> sizes, int64_t numel, const char* op_name) {
+    int64_t known = 1;
+    size_t infer_dim = sizes.size();
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (sizes[i] == -1) {
+            if (infer_dim != sizes.size()) {
+                throw std::runtime_error(std::string(op_name) + ": 最多只能有一个-1");
+            }
+            infer_dim = i;
+        } else if (sizes[i] < 0) {
+            throw std::runtime_error(std::string(op_name) + ": 非法的大小 " + std::to_string(sizes[i]));
+        } else {
+            known *= sizes[i];
+        }
+    }
+    if (infer_dim != sizes.size() && known != 0 && numel % known == 0) {
+        sizes[infer_dim] = numel / known;
+        known = numel;
+    }
+    // 与TensorImpl::numel()一致：空的sizes表示0个元素
+    int64_t total = sizes.empty() ? 0 : known;
+    if (infer_dim != sizes.size() && sizes[infer_dim] == -1) {
+        total = -1;
+    }
+    if (total != numel) {
+        throw std::runtime_error(std::string(op_name) + ": 形状与元素数 " + std::to_string(numel) + " 不匹配");
+    }
+    return sizes;
+}
+
+Tensor view(const Tensor& self, std::vector<int64_t> sizes) {
+    checkTensor(self, "view");
+    if (!self->isContiguous()) {
+        throw std::runtime_error("view: 输入tensor不连续（" + self->debugString() + "），请使用reshape");
+    }
+    sizes = inferSizes(std::move(sizes), self->numel(), "view");
+    std::vector<int64_t> strides = contiguousStrides(sizes);
+    return makeView(self, std::move(sizes), std::move(strides), self->storageOffset());
+}
+
+Tensor reshape(const Tensor& self, std::vector<int64_t> sizes) {
+    checkTensor(self, "reshape");
+    return view(self->contiguous(), std::move(sizes));
+}
+
+Tensor expand(const Tensor& self, std::vector<int64_t> sizes) {
+    checkTensor(self, "expand");
+    const size_t ndim = static_cast<size_t>(self->dim());
+    if (sizes.size() < ndim) {
+        throw std::runtime_error("expand: 目标维度数 " + std::to_string(sizes.size()) + " 小于输入的维度数 " +
+                                 std::to_string(ndim));
+    }
+    // 从最后一维对齐；新增的前导维度stride为0
+    const size_t leading = sizes.size() - ndim;
+    std::vector<int64_t> strides(sizes.size(), 0);
+    for (size_t i = 0; i < sizes.size(); ++i) {
+        if (i < leading) {
+            if (sizes[i] < 0) {
+                throw std::runtime_error("expand: 新增的维度不能为-1");
+            }
+            continue;
+        }
+        int64_t size = self->sizes()[i - leading];
+        int64_t stride = self->strides()[i - leading];
+        if (sizes[i] == -1) {
+            sizes[i] = size;
+        }
+        if (sizes[i] == size) {
+            strides[i] = stride;
+        } else if (size == 1) {
+            strides[i] = 0;
+        } else {
+            throw std::runtime_error("expand: 第 " + std::to_string(i) + " 维大小为 " + std::to_string(size) +
+                                     "，不能扩展到 " + std::to_string(sizes[i]));
+        }
+    }
+    return makeView(self, std::move(sizes), std::move(strides), self->storageOffset());
+}
+
+// === Autograd ===
+// Autograd内核重新分发得到视图后记录一个反向节点，它唯一的边指向原tensor的grad_fn或叶子
+// 反向时新建与原tensor同形状的零梯度，对它施加同样的视图操作，再把输出梯度逐元素累加到这个视图上，
+// 梯度因此按视图的几何写回原tensor的对应位置；expand的多个位置指向同一个元素，累加自然得到求和
+// 节点的args依次是原tensor的维度数、原tensor的sizes和视图操作自身的参数
+
+// 在零梯度上重做视图操作，view_args是args中视图操作自身的参数
+using ApplyViewFunction = Tensor (*)(const Tensor& grad_self, IntArrayRef view_args);
+
+static Tensor makeZeros(DispatchKey backend, std::vector<int64_t> sizes) {
+    switch (backend) {
+        case DispatchKey::CUDA: return make_tensor_cuda(std::move(sizes));
+        case DispatchKey::Meta: return make_tensor_meta(std::move(sizes));
+        default: break;
+    }
+    Tensor zeros = make_tensor_cpu(std::move(sizes));
+    if (float* data = zeros->data()) {
+        std::fill(data, data + zeros->numel(), 0.0f);
+    }
+    return zeros;
+}
+
+// dst += src：两者形状相同，dst可以是不连续的视图，stride为0的维度上同一元素被多次累加
+static void accumulateInto(const Tensor& dst, const Tensor& src) {
+    int64_t n = dst->numel();
+    if (n == 0) {
+        return;
+    }
+    Tensor contiguous_src = src->contiguous();
+    const float* in = contiguous_src->data();
+    float* out = static_cast<float*>(dst->storage()->data());
+    const std::vector<int64_t>& sizes = dst->sizes();
+    const std::vector<int64_t>& strides = dst->strides();
+    // 与TensorImpl::clone相同的行优先遍历：pos是当前元素在dst的storage中的位置
+    std::vector<int64_t> index(sizes.size(), 0);
+    int64_t pos = dst->storageOffset();
+    for (int64_t i = 0; i < n; ++i) {
+        out[pos] += in[i];
+        for (size_t d = sizes.size(); d-- > 0;) {
+            if (++index[d] < sizes[d]) {
+                pos += strides[d];
+                break;
+            }
+            pos -= strides[d] * (sizes[d] - 1);
+            index[d] = 0;
+        }
+    }
+}
+
+template<ApplyViewFunction apply>
+static void view_backward(const AutogradNode& node, ArrayRef<Tensor>, const Tensor& grad_output, Tensor* grad_inputs) {
+    const size_t ndim = static_cast<size_t>(node.args[0]);
+    std::vector<int64_t> self_sizes(node.args + 1, node.args + 1 + ndim);
+    IntArrayRef view_args(node.args + 1 + ndim, node.num_args - 1 - ndim);
+    Tensor grad_self = makeZeros(grad_output->backendKey(), std::move(self_sizes));
+    // 模拟的CUDA与Meta没有计算内核，与梯度累加一样只产生同形状的结果
+    if (grad_self->is_cpu()) {
+        accumulateInto(apply(grad_self, view_args), grad_output);
+    }
+    grad_inputs[0] = std::move(grad_self);
+}
+
+static Tensor applySlice(const Tensor& grad_self, IntArrayRef view_args) {
+    return slice(grad_self, view_args[0], view_args[1], view_args[2], view_args[3]);
+}
+
+static Tensor applyTranspose(const Tensor& grad_self, IntArrayRef view_args) {
+    return transpose(grad_self, view_args[0], view_args[1]);
+}
+
+// view和reshape：零梯度是连续的，两者都可以用view重做
+static Tensor applyView(const Tensor& grad_self, IntArrayRef view_args) {
+    return view(grad_self, view_args.vec());
+}
+
+static Tensor applyExpand(const Tensor& grad_self, IntArrayRef view_args) {
+    return expand(grad_self, view_args.vec());
+}
+
+static void recordView(const char* name, BackwardFunction backward, const Tensor& self, const Tensor& result,
+                       IntArrayRef view_args) {
+    if (!self->requiresGrad()) {
+        return;
+    }
+    std::vector<int64_t> args;
+    args.reserve(1 + self->sizes().size() + view_args.size());
+    args.push_back(self->dim());
+    args.insert(args.end(), self->sizes().begin(), self->sizes().end());
+    args.insert(args.end(), view_args.begin(), view_args.end());
+    const Tensor inputs[] = {self};
+    AutogradTape::instance().record(name, backward, inputs, result, {}, args);
+}
+
+static Tensor slice_autograd(const OperatorHandle& op, DispatchKeySet ks, const Tensor& self, int64_t dim,
+                             int64_t start, int64_t end, int64_t step) {
+    Tensor result = op.typed<Tensor(const Tensor&, int64_t, int64_t, int64_t, int64_t)>().redispatch(
+        DispatchKey::Autograd, ks, self, dim, start, end, step);
+    const int64_t view_args[] = {dim, start, end, step};
+    recordView("slice", view_backward<applySlice>, self, result, view_args);
+    return result;
+}
+
+static Tensor transpose_autograd(const OperatorHandle& op, DispatchKeySet ks, const Tensor& self, int64_t dim0,
+                                 int64_t dim1) {
+    Tensor result =
+        op.typed<Tensor(const Tensor&, int64_t, int64_t)>().redispatch(DispatchKey::Autograd, ks, self, dim0, dim1);
+    const int64_t view_args[] = {dim0, dim1};
+    recordView("transpose", view_backward<applyTranspose>, self, result, view_args);
+    return result;
+}
+
+// view/reshape/expand记录结果的实际形状，-1已经被推断
+static Tensor view_autograd(const OperatorHandle& op, DispatchKeySet ks, const Tensor& self,
+                            std::vector<int64_t> sizes) {
+    Tensor result = op.typed<Tensor(const Tensor&, std::vector<int64_t>)>().redispatch(DispatchKey::Autograd, ks,
+                                                                                      self, std::move(sizes));
+    recordView("view", view_backward<applyView>, self, result, result->sizes());
+    return result;
+}
+
+static Tensor reshape_autograd(const OperatorHandle& op, DispatchKeySet ks, const Tensor& self,
+                               std::vector<int64_t> sizes) {
+    Tensor result = op.typed<Tensor(const Tensor&, std::vector<int64_t>)>().redispatch(DispatchKey::Autograd, ks,
+                                                                                      self, std::move(sizes));
+    recordView("reshape", view_backward<applyView>, self, result, result->sizes());
+    return result;
+}
+
+static Tensor expand_autograd(const OperatorHandle& op, DispatchKeySet ks, const Tensor& self,
+                              std::vector<int64_t> sizes) {
+    Tensor result = op.typed<Tensor(const Tensor&, std::vector<int64_t>)>().redispatch(DispatchKey::Autograd, ks,
+                                                                                      self, std::move(sizes));
+    recordView("expand", view_backward<applyExpand>, self, result, result->sizes());
+    return result;
+}
+
+// === 注册 ===
+
+static std::mutex view_ops_mutex;
+static std::unordered_set<std::string> view_ops;  // 仅在持有view_ops_mutex时访问
+
+// 函数指针不能带默认参数，操作符层面的slice总是传入全部5个参数
+static Tensor slice_kernel(const Tensor& self, int64_t dim, int64_t start, int64_t end, int64_t step) {
+    return slice(self, dim, start, end, step);
+}
+
+template<typename Func, typename AutogradFunc>
+static void registerViewOperator(const std::string& name, Func func, AutogradFunc autograd_func) {
+    {
+        auto kernels = registerOp(name).updateKernels();
+        REGISTER_KERNEL(kernels, CPU, func);
+        REGISTER_KERNEL(kernels, CUDA, func);
+        REGISTER_KERNEL(kernels, Meta, func);  // 视图只改变元数据，Meta tensor上同样适用
+        REGISTER_KERNEL(kernels, Autograd, autograd_func);
+    }
+    std::lock_guard<std::mutex> lock(view_ops_mutex);
+    view_ops.insert(name);
+}
+
+void registerViewOperators() {
+    registerViewOperator("slice", slice_kernel, slice_autograd);
+    registerViewOperator("transpose", transpose, transpose_autograd);
+    registerViewOperator("view", view, view_autograd);
+    registerViewOperator("reshape", reshape, reshape_autograd);
+    registerViewOperator("expand", expand, expand_autograd);
+}
+
+bool isViewOperator(const std::string& op_name) {
+    std::lock_guard<std::mutex> lock(view_ops_mutex);
+    return view_ops.count(op_name) > 0;
+}
+
+} // namespace dispatcher
@@ -0,0 +1,4 @@
+// AVX2逐元素内核，只在x86-64上构建，并以-mavx2 -mfma单独编译
+#define DISPATCHER_CPU_CAPABILITY AVX2
+#define DISPATCHER_CPU_CAPABILITY_AVX2 1
+#include "VectorizedImpl.h"
@@ -0,0 +1,4 @@
+// AVX-512逐元素内核，只在x86-64上构建，并以-mavx512f单独编译
+#define DISPATCHER_CPU_CAPABILITY AVX512
+#define DISPATCHER_CPU_CAPABILITY_AVX512 1
+#include "VectorizedImpl.h"
@@ -0,0 +1,4 @@
+// 不依赖扩展指令集的逐元素内核（aarch64上使用NEON），始终参与构建
+#define DISPATCHER_CPU_CAPABILITY Default
+#define DISPATCHER_CPU_CAPABILITY_DEFAULT 1
+#include "VectorizedImpl.h"
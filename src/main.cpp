@@ -1,8 +1,23 @@
 #include "Dispatcher.h"
 #include "TensorImpl.h"
+#include "Parallel.h"
+#include "ElementwiseKernels.h"
+#include "Graph.h"
+#include "Fusion.h"
+#include "MemoryPlanner.h"
+#include "TensorViews.h"
+#include "ShapeInference.h"
+#include "StaticRegistration.h"
+#include "EventRecorder.h"
+#include "Autograd.h"
+#include "CallSite.h"
+#include <atomic>
 #include <iostream>
 #include <cassert>
 #include <chrono>
+#include <filesystem>
+#include <sstream>
+#include <thread>
 
 using namespace dispatcher;
 
@@ -16,8 +31,8 @@ Tensor add_cpu_unboxed(const Tensor& a, const Tensor& b) {
     std::cout << "    输入1: " << a->debugString() << std::endl;
     std::cout << "    输入2: " << b->debugString() << std::endl;
     
-    // 创建结果tensor（使用第一个tensor的形状）
-    auto result = make_tensor_cpu(a->sizes());
+    // 向量化的逐元素加法，按元素数切分到多个核心上；小tensor低于阈值时直接在当前线程计算
+    auto result = binary_op(BinaryOp::Add, a, b);
     std::cout << "    输出: " << result->debugString() << std::endl;
     
     return result;
@@ -48,7 +63,7 @@ Tensor add_tensor_scalar_unboxed(const Tensor& tensor, double scalar) {
     std::cout << "    Tensor: " << tensor->debugString() << std::endl;
     std::cout << "    Scalar: " << scalar << std::endl;
     
-    auto result = make_tensor_cpu(tensor->sizes());
+    auto result = binary_op(BinaryOp::Add, tensor, static_cast<float>(scalar));
     std::cout << "    输出: " << result->debugString() << std::endl;
     
     return result;
@@ -84,13 +99,32 @@ IValueList add_cpu_kernel(const IValueList& args) {
     std::cout << "    输入1: " << tensor1->debugString() << std::endl;
     std::cout << "    输入2: " << tensor2->debugString() << std::endl;
     
-    // 创建结果tensor（简化实现：使用第一个tensor的形状）
-    auto result = make_tensor_cpu(tensor1->sizes());
+    auto result = binary_op(BinaryOp::Add, tensor1, tensor2);
     std::cout << "    输出: " << result->debugString() << std::endl;
     
     return {IValue(result)};
 }
 
+// CPU加法的批量实现 - 同一批调用只进入内核一次
+void add_cpu_batched_kernel(const OperatorHandle&, DispatchKeySet, Stack* stacks, size_t count) {
+    std::cout << "  [CPU Batched] 一次执行 " << count << " 个加法操作" << std::endl;
+    
+    // 批次中的调用互不依赖，按调用切分到多个核心上；每个调用内部的parallel_for在分块内顺序执行
+    parallel_for(0, static_cast<int64_t>(count), 1, [stacks](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            Stack& stack = stacks[i];
+            if (stack.size() != 2 || !stack[0].isTensor() || !stack[1].isTensor()) {
+                throw std::runtime_error("add_cpu_batched_kernel: 需要两个tensor参数");
+            }
+            
+            // 参数原地替换为结果
+            auto result = binary_op(BinaryOp::Add, stack[0].toTensorRef(), stack[1].toTensorRef());
+            stack.clear();
+            push(stack, std::move(result));
+        }
+    });
+}
+
 // CUDA加法实现
 IValueList add_cuda_kernel(const IValueList& args) {
     std::cout << "  [CUDA Boxed] 执行加法操作" << std::endl;
@@ -106,7 +140,7 @@ IValueList add_cuda_kernel(const IValueList& args) {
     std::cout << "    输入2: " << tensor2->debugString() << std::endl;
     
     // 创建结果tensor
-    auto result = make_tensor_cuda(tensor1->sizes());
+    auto result = make_output_tensor(DispatchKey::CUDA, tensor1->sizes());
     std::cout << "    输出: " << result->debugString() << std::endl;
     
     return {IValue(result)};
@@ -114,130 +148,121 @@ IValueList add_cuda_kernel(const IValueList& args) {
 
 // === 功能性包装器（保持原有代码） ===
 
+// 功能性包装器接收当前操作符句柄和本次分发的key set，
+// 通过redispatch直接跳转到句柄表中的下一个内核，不再按名称查找操作符
+
 // Autograd包装器
-IValueList add_autograd_kernel(const IValueList& args) {
+IValueList add_autograd_kernel(const OperatorHandle& op, DispatchKeySet ks, const IValueList& args) {
     std::cout << "  [Autograd] 包装器：记录梯度信息" << std::endl;
     
-    // 在实际实现中，这里会设置梯度计算的forward和backward钩子
-    // 为了演示，我们移除autograd key并重新dispatch到backend实现
-    
-    // 计算当前的dispatch key set
-    std::vector<std::shared_ptr<TensorImpl>> tensors;
-    for (const auto& arg : args) {
-        if (arg.isTensor()) {
-            tensors.push_back(arg.toTensor());
-        }
-    }
-    
-    auto ks = computeDispatchKeySet(tensors);
-    ks.remove(DispatchKey::Autograd);  // 移除autograd key避免无限递归
-    
-    std::cout << "    重新分发到: " << ks.toString() << std::endl;
+    // 屏蔽autograd及更高优先级的key，重新dispatch到下一层实现完成前向计算
+    std::cout << "    重新分发到: " << (ks & DispatchKeySet::keysBelow(DispatchKey::Autograd)).toString() << std::endl;
     
-    // 重新调用dispatcher
-    auto result = callOp(OperatorName("add"), ks, args);
+    auto result = op.redispatch(DispatchKey::Autograd, ks, args);
     
-    std::cout << "    [Autograd] 设置梯度追踪" << std::endl;
+    // 记录反向节点，输出通过grad_fn与之关联
+    const Tensor inputs[] = {args[0].toTensorRef(), args[1].toTensorRef()};
+    if (AutogradTape::instance().record("add", add_backward, inputs, result[0].toTensorRef())) {
+        std::cout << "    [Autograd] 记录反向节点 AddBackward" << std::endl;
+    }
     
     return result;
 }
 
-// Tracing包装器
-IValueList add_tracing_kernel(const IValueList& args) {
-    std::cout << "  [Tracing] 包装器：记录操作用于JIT编译" << std::endl;
-    
-    // 移除tracing key并重新dispatch
-    std::vector<std::shared_ptr<TensorImpl>> tensors;
-    for (const auto& arg : args) {
-        if (arg.isTensor()) {
-            tensors.push_back(arg.toTensor());
-        }
-    }
-    
-    auto ks = computeDispatchKeySet(tensors);
-    ks.remove(DispatchKey::Tracing);
-    
-    std::cout << "    重新分发到: " << ks.toString() << std::endl;
+// === 通用fallback ===
+// Tracing和Profiling与具体操作符无关，注册为全局fallback后覆盖所有没有自己内核的操作符
+
+// Tracing fallback - 基于栈的调用约定：参数留在栈上原地交给下一层，结果也原地返回
+void tracing_fallback(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+    std::cout << "  [Tracing] fallback：记录 " << op.name() << " 用于JIT编译" << std::endl;
     
-    auto result = callOp(OperatorName("add"), ks, args);
+    std::cout << "    重新分发到: " << (ks & DispatchKeySet::keysBelow(DispatchKey::Tracing)).toString() << std::endl;
     
-    std::cout << "    [Tracing] 记录操作到计算图" << std::endl;
+    // 处于GraphCapture作用域时记录到计算图，否则只重新分发
+    GraphCapture::traceCall(op, ks, stack);
     
-    return result;
+    if (GraphCapture::isCapturing()) {
+        std::cout << "    [Tracing] 记录 " << op.name() << " 到计算图" << std::endl;
+    }
 }
 
-// Profiling包装器
-IValueList add_profiling_kernel(const IValueList& args) {
-    std::cout << "  [Profiling] 包装器：性能监控开始" << std::endl;
+// Profiling fallback
+void profiling_fallback(const OperatorHandle& op, DispatchKeySet ks, Stack* stack) {
+    std::cout << "  [Profiling] fallback：" << op.name() << " 性能监控开始" << std::endl;
     
     auto start_time = std::chrono::high_resolution_clock::now();
     
-    // 移除profiling key并重新dispatch
-    std::vector<std::shared_ptr<TensorImpl>> tensors;
-    for (const auto& arg : args) {
-        if (arg.isTensor()) {
-            tensors.push_back(arg.toTensor());
-        }
-    }
-    
-    auto ks = computeDispatchKeySet(tensors);
-    ks.remove(DispatchKey::Profiling);
-    
-    auto result = callOp(OperatorName("add"), ks, args);
+    op.redispatchBoxed(DispatchKey::Profiling, ks, stack);
     
     auto end_time = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
     
-    std::cout << "    [Profiling] 操作耗时: " << duration.count() << " 微秒" << std::endl;
-    
+    std::cout << "    [Profiling] " << op.name() << " 耗时: " << duration.count() << " 微秒" << std::endl;
+}
+
+// Autograd包装器的 unboxed 版本 - 通过类型化句柄重新分发，全程不构造IValueList
+Tensor add_autograd_unboxed(const OperatorHandle& op, DispatchKeySet ks, const Tensor& a, const Tensor& b) {
+    std::cout << "  [Autograd Unboxed] 包装器：重新分发到 "
+              << (ks & DispatchKeySet::keysBelow(DispatchKey::Autograd)).toString() << std::endl;
+    Tensor result = op.typed<Tensor(const Tensor&, const Tensor&)>().redispatch(DispatchKey::Autograd, ks, a, b);
+    const Tensor inputs[] = {a, b};
+    AutogradTape::instance().record("add_unboxed", add_backward, inputs, result);
     return result;
 }
 
 // === 操作符注册函数 ===
 
+// 静态注册示例操作符的内核：条目在编译期生成，启动时不执行注册代码
+// add的CPU内核同时提供批量入口，需要通过工厂函数配置
+KernelFunction make_add_cpu_kernel() {
+    KernelFunction kernel(add_cpu_kernel);
+    kernel.setBatched(add_cpu_batched_kernel);
+    return kernel;
+}
+
+// add 操作符 - boxed 函数
+STATIC_REGISTER_KERNEL_FACTORY("add", CPU, make_add_cpu_kernel);
+STATIC_REGISTER_KERNEL("add", CUDA, add_cuda_kernel);
+STATIC_REGISTER_KERNEL("add", Autograd, add_autograd_kernel);
+STATIC_REGISTER_KERNEL("add", Meta, elementwise_meta_kernel);
+
+// add_unboxed 操作符 - unboxed 函数，KernelFunction 会自动进行 boxing
+STATIC_REGISTER_KERNEL("add_unboxed", CPU, add_cpu_unboxed);
+STATIC_REGISTER_KERNEL("add_unboxed", CUDA, add_cuda_unboxed);
+STATIC_REGISTER_KERNEL("add_unboxed", Autograd, add_autograd_unboxed);
+STATIC_REGISTER_KERNEL("add_unboxed", Meta, elementwise_meta_kernel);
+
+// 标量加法操作符与混合类型操作符
+STATIC_REGISTER_KERNEL("add_scalar", CPU, add_scalar_unboxed);
+STATIC_REGISTER_KERNEL("add_tensor_scalar", CPU, add_tensor_scalar_unboxed);
+STATIC_REGISTER_KERNEL("add_tensor_scalar", Meta, elementwise_meta_kernel);
+
+// void 返回类型的操作符
+STATIC_REGISTER_KERNEL("print_tensor_info", CPU, print_tensor_info_unboxed);
+STATIC_REGISTER_KERNEL("print_tensor_info", CUDA, print_tensor_info_unboxed);
+
 // 注册示例操作符
 void registerOperators() {
     std::cout << "=== 注册操作符和内核 ===" << std::endl;
     
-    // 注册 add 操作符 - 使用 boxed 函数
-    auto& add_op = REGISTER_OP("add");
-    
-    // 注册各个dispatch key的内核实现（boxed版本）
-    REGISTER_KERNEL(add_op, CPU, add_cpu_kernel);
-    REGISTER_KERNEL(add_op, CUDA, add_cuda_kernel);
-    REGISTER_KERNEL(add_op, Autograd, add_autograd_kernel);
-    REGISTER_KERNEL(add_op, Tracing, add_tracing_kernel);
-    REGISTER_KERNEL(add_op, Profiling, add_profiling_kernel);
-    
-    std::cout << "add 操作符（boxed版本）注册完成" << std::endl;
-    
-    // 注册 add_unboxed 操作符 - 使用 unboxed 函数
-    auto& add_unboxed_op = REGISTER_OP("add_unboxed");
-    
-    // 注册 unboxed 函数 - KernelFunction 会自动进行 boxing
-    REGISTER_KERNEL(add_unboxed_op, CPU, add_cpu_unboxed);
-    REGISTER_KERNEL(add_unboxed_op, CUDA, add_cuda_unboxed);
+    // add、add_unboxed等示例操作符在文件作用域静态注册，启动时已经在注册表中
+    std::cout << "静态注册: " << staticKernelEntries().size() << " 个内核，dispatch table在第一次调用时建立" << std::endl;
     
-    std::cout << "add_unboxed 操作符（unboxed版本）注册完成" << std::endl;
+    // 注册零拷贝的视图操作符
+    registerViewOperators();
     
-    // 注册标量加法操作符
-    auto& add_scalar_op = REGISTER_OP("add_scalar");
-    REGISTER_KERNEL(add_scalar_op, CPU, add_scalar_unboxed);
+    std::cout << "slice/transpose/view/reshape/expand 操作符注册完成" << std::endl;
     
-    std::cout << "add_scalar 操作符注册完成" << std::endl;
+    // 声明CPU内核的逐元素语义，供计算图的融合pass使用
+    registerElementwiseOp("add", ElementwiseOpInfo::binary(BinaryOp::Add));
+    registerElementwiseOp("add_unboxed", ElementwiseOpInfo::binary(BinaryOp::Add));
+    registerElementwiseOp("add_tensor_scalar", ElementwiseOpInfo::binaryScalar(BinaryOp::Add));
     
-    // 注册混合类型操作符
-    auto& add_tensor_scalar_op = REGISTER_OP("add_tensor_scalar");
-    REGISTER_KERNEL(add_tensor_scalar_op, CPU, add_tensor_scalar_unboxed);
+    // 注册通用的Tracing/Profiling fallback，对所有操作符生效
+    Dispatcher::instance().registerFallback(DispatchKey::Tracing, tracing_fallback);
+    Dispatcher::instance().registerFallback(DispatchKey::Profiling, profiling_fallback);
     
-    std::cout << "add_tensor_scalar 操作符注册完成" << std::endl;
-    
-    // 注册 void 返回类型的操作符
-    auto& print_info_op = REGISTER_OP("print_tensor_info");
-    REGISTER_KERNEL(print_info_op, CPU, print_tensor_info_unboxed);
-    REGISTER_KERNEL(print_info_op, CUDA, print_tensor_info_unboxed);
-    
-    std::cout << "print_tensor_info 操作符注册完成" << std::endl;
+    std::cout << "Tracing/Profiling fallback 注册完成" << std::endl;
     
     std::cout << "\n所有操作符注册完成！" << std::endl;
 }
@@ -305,6 +330,573 @@ void testBoxingUnboxing() {
     auto print_result = callOp("print_tensor_info", print_args);
     
     std::cout << "    返回结果为空（符合void返回类型）: " << (print_result.empty() ? "是" : "否") << std::endl;
+    
+    // 基于栈的调用：结果原地留在栈上，直接作为下一次调用的参数
+    std::cout << "\n6. 基于栈的链式调用 (1 + 2) + 3:" << std::endl;
+    const OperatorHandle& add_scalar_op = *Dispatcher::instance().findOperator(OperatorName("add_scalar"));
+    PooledStack stack;
+    push(*stack, 1.0, 2.0);
+    Dispatcher::instance().callBoxed(add_scalar_op, stack.get());
+    push(*stack, 3.0);
+    Dispatcher::instance().callBoxed(add_scalar_op, stack.get());
+    std::cout << "    结果: " << pop(*stack).toDouble() << std::endl;
+}
+
+// 测试类型化的直接调用
+void testTypedCall() {
+    std::cout << "\n=== 测试类型化直接调用（跳过Boxing） ===" << std::endl;
+    
+    auto tensor1 = make_tensor_cpu({2, 2});
+    auto tensor2 = make_tensor_cpu({2, 2});
+    
+    // unboxed内核：直接跳转到类型化入口，不构造IValueList
+    std::cout << "\n1. 类型化调用unboxed内核:" << std::endl;
+    auto add_unboxed = Dispatcher::instance().findOperator(OperatorName("add_unboxed"))
+                           ->typed<Tensor(const Tensor&, const Tensor&)>();
+    auto result = add_unboxed.call(tensor1, tensor2);
+    std::cout << "    结果: " << result->debugString() << std::endl;
+    
+    std::cout << "\n2. 类型化调用标量内核:" << std::endl;
+    auto add_scalar = Dispatcher::instance().findOperator(OperatorName("add_scalar"))->typed<double(double, double)>();
+    double scalar_result = add_scalar.call(1.5, 2.5);
+    std::cout << "    结果: " << scalar_result << std::endl;
+    
+    // boxed内核：自动退化为boxing调用
+    std::cout << "\n3. 类型化调用boxed内核（回退到boxing）:" << std::endl;
+    auto add = Dispatcher::instance().findOperator(OperatorName("add"))->typed<Tensor(const Tensor&, const Tensor&)>();
+    add.call(tensor1, tensor2);
+    
+    // 带dispatch上下文的unboxed内核：Autograd层通过句柄直接重新分发到CPU内核
+    std::cout << "\n4. 类型化重新分发（Autograd -> CPU）:" << std::endl;
+    auto grad_tensor = make_tensor_cpu({2, 2});
+    grad_tensor->setRequiresGrad(true);
+    auto grad_result = add_unboxed.call(grad_tensor, tensor2);
+    std::cout << "    结果: " << grad_result->debugString() << std::endl;
+}
+
+// 测试批量调用
+void testBatchedCall() {
+    std::cout << "\n=== 测试批量调用 ===" << std::endl;
+    
+    const OperatorHandle& add = *Dispatcher::instance().findOperator(OperatorName("add"));
+    
+    // 相同key set的调用整批进入CPU的批量入口
+    std::cout << "\n1. 同构批次（4个CPU调用）:" << std::endl;
+    std::vector<IValueList> batch;
+    for (int64_t i = 1; i <= 4; ++i) {
+        batch.push_back({IValue(make_tensor_cpu({i, i})), IValue(make_tensor_cpu({i, i}))});
+    }
+    auto results = Dispatcher::instance().callBatch(add, batch);
+    for (const auto& result : results) {
+        std::cout << "    结果: " << result[0].toTensorRef()->debugString() << std::endl;
+    }
+    
+    // 混合批次按key set分组：CPU组走批量入口，CUDA组逐个调用普通内核
+    std::cout << "\n2. 混合批次（2个CPU + 1个CUDA）:" << std::endl;
+    std::vector<IValueList> mixed_batch = {
+        {IValue(make_tensor_cpu({2})), IValue(make_tensor_cpu({2}))},
+        {IValue(make_tensor_cuda({3})), IValue(make_tensor_cuda({3}))},
+        {IValue(make_tensor_cpu({4})), IValue(make_tensor_cpu({4}))},
+    };
+    auto mixed_results = Dispatcher::instance().callBatch(add, mixed_batch);
+    for (const auto& result : mixed_results) {
+        std::cout << "    结果: " << result[0].toTensorRef()->debugString() << std::endl;
+    }
+    
+    // hint同样应用当前线程的排除集合：排除Autograd时不会进入Autograd包装器
+    std::cout << "\n3. 排除Autograd时的hint（Autograd + CPU）:" << std::endl;
+    {
+        ExcludeDispatchKeyGuard no_grad(DispatchKey::Autograd);
+        std::vector<IValueList> hinted_batch = {{IValue(make_tensor_cpu({2})), IValue(make_tensor_cpu({2}))}};
+        Dispatcher::instance().callBatch(add, hinted_batch, DispatchKeySet({DispatchKey::Autograd, DispatchKey::CPU}));
+    }
+}
+
+// 测试异步调用
+void testAsyncCall() {
+    std::cout << "\n=== 测试异步调用 ===" << std::endl;
+    
+    const OperatorHandle& add = *Dispatcher::instance().findOperator(OperatorName("add"));
+    
+    // CUDA调用提交到同一个stream，按提交顺序执行；主线程提交后立即返回
+    std::cout << "\n1. 连续提交3个CUDA调用（stream内保持顺序）:" << std::endl;
+    std::vector<DispatchFuture> futures;
+    for (int64_t i = 1; i <= 3; ++i) {
+        futures.push_back(callOpAsync(add, {IValue(make_tensor_cuda({i})), IValue(make_tensor_cuda({i}))}));
+    }
+    Dispatcher::instance().synchronize(DispatchKey::CUDA);
+    for (auto& future : futures) {
+        std::cout << "    结果: " << future.get()[0].toTensorRef()->debugString() << std::endl;
+    }
+    
+    // CPU调用由工作窃取线程池执行
+    std::cout << "\n2. CPU异步调用 + then回调:" << std::endl;
+    auto cpu_future = callOpAsync(add, {IValue(make_tensor_cpu({2, 2})), IValue(make_tensor_cpu({2, 2}))});
+    cpu_future.wait();
+    cpu_future.then([]() { std::cout << "    then回调: 结果已就绪" << std::endl; });
+    std::cout << "    结果: " << cpu_future.get()[0].toTensorRef()->debugString() << std::endl;
+    
+    // 内核中的异常保存在future中，get()时重新抛出
+    std::cout << "\n3. 异步调用的错误在get()时抛出:" << std::endl;
+    auto bad_future = callOpAsync(add, {IValue(make_tensor_cpu({2}))});
+    try {
+        bad_future.get();
+    } catch (const std::exception& e) {
+        std::cout << "    捕获异常: " << e.what() << std::endl;
+    }
+}
+
+// 测试intra-op并行
+void testParallelFor() {
+    std::cout << "\n=== 测试intra-op并行 ===" << std::endl;
+    
+    auto& state = GlobalDispatchState::instance();
+    
+    // 大区间被切成多块并行计算，结果与顺序计算一致
+    std::cout << "\n1. 并行求和 [0, 1000000):" << std::endl;
+    std::atomic<int64_t> sum{0};
+    parallel_for(0, 1000000, 10000, [&](int64_t begin, int64_t end) {
+        int64_t local = 0;
+        for (int64_t i = begin; i < end; ++i) {
+            local += i;
+        }
+        sum.fetch_add(local, std::memory_order_relaxed);
+    });
+    std::cout << "    结果: " << sum.load() << (sum.load() == int64_t(999999) * 1000000 / 2 ? " (正确)" : " (错误)")
+              << std::endl;
+    
+    // 分块内的嵌套调用直接顺序执行，不会等待线程池
+    std::cout << "\n2. 嵌套parallel_for:" << std::endl;
+    std::atomic<int64_t> nested_count{0};
+    parallel_for(0, 64, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; ++i) {
+            parallel_for(0, 1000, 1, [&](int64_t b, int64_t e) {
+                nested_count.fetch_add(e - b, std::memory_order_relaxed);
+            });
+        }
+    });
+    std::cout << "    完成 " << nested_count.load() << " 次内层迭代" << std::endl;
+    
+    // 小tensor低于顺序执行阈值，在调用方线程上计算
+    std::cout << "\n3. 顺序执行阈值: " << state.parallelCutoff() << " 个元素" << std::endl;
+    auto small = make_tensor_cpu({8, 8});
+    bool ran_inline = false;
+    std::thread::id caller = std::this_thread::get_id();
+    parallel_for(*small, [&](int64_t, int64_t) { ran_inline = std::this_thread::get_id() == caller; });
+    std::cout << "    " << small->debugString() << (ran_inline ? " 在调用方线程上计算" : " 被并行计算") << std::endl;
+    
+    // 通过GlobalDispatchState调整线程数，下一次parallel_for按新配置重建线程池
+    std::cout << "\n4. 配置线程数:" << std::endl;
+    state.setNumThreads(2);
+    std::cout << "    setNumThreads(2) 后的线程数: " << getNumIntraOpThreads() << std::endl;
+    state.setNumThreads(1);
+    std::cout << "    setNumThreads(1) 后的线程数: " << getNumIntraOpThreads() << std::endl;
+    state.setNumThreads(0);
+}
+
+// 打印一个backend分配器的统计
+void printAllocatorStats(DispatchKey backend) {
+    Allocator* allocator = getAllocator(backend);
+    AllocatorStats stats = allocator->stats();
+    std::cout << "    " << allocator->name() << ": allocated=" << stats.allocated_bytes
+              << "B, peak=" << stats.peak_bytes << "B, cached=" << stats.cached_bytes
+              << "B, allocs=" << stats.num_allocs << ", cache_hits=" << stats.num_cache_hits << std::endl;
+}
+
+// 测试tensor存储与缓存分配器
+void testMemoryStats() {
+    std::cout << "\n=== 测试Tensor存储与缓存分配器 ===" << std::endl;
+    
+    Allocator* cpu_allocator = getAllocator(DispatchKey::CPU);
+    cpu_allocator->emptyCache();
+    cpu_allocator->resetPeakStats();
+    AllocatorStats before = cpu_allocator->stats();
+    
+    // 释放的块进入缓存，相同大小级别的下一次分配直接复用
+    std::cout << "\n1. 分配、释放、再分配同样大小的tensor:" << std::endl;
+    const void* first_data = nullptr;
+    {
+        auto tensor = make_tensor_cpu({256, 256});
+        first_data = tensor->data();
+        std::cout << "    " << tensor->debugString() << ", nbytes=" << tensor->nbytes() << std::endl;
+    }
+    auto reused = make_tensor_cpu({256, 256});
+    std::cout << "    复用同一块内存: " << (reused->data() == first_data ? "是" : "否") << std::endl;
+    AllocatorStats after = cpu_allocator->stats();
+    std::cout << "    本次新增缓存命中: " << after.num_cache_hits - before.num_cache_hits << std::endl;
+    
+    std::cout << "\n2. 数据按" << kAllocatorAlignment << "字节对齐: "
+              << (reinterpret_cast<uintptr_t>(reused->data()) % kAllocatorAlignment == 0 ? "是" : "否") << std::endl;
+    
+    // clone深拷贝数据到新的Storage
+    std::cout << "\n3. clone深拷贝数据:" << std::endl;
+    reused->data()[0] = 42.0f;
+    auto cloned = reused->clone();
+    std::cout << "    独立的Storage: " << (cloned->storage() != reused->storage() ? "是" : "否")
+              << ", cloned[0]=" << cloned->data()[0] << std::endl;
+    
+    std::cout << "\n4. 各backend的内存统计:" << std::endl;
+    auto cuda_tensor = make_tensor_cuda({1024});
+    printAllocatorStats(DispatchKey::CPU);
+    printAllocatorStats(DispatchKey::CUDA);
+}
+
+// 测试向量化逐元素内核
+void testVectorizedKernels() {
+    std::cout << "\n=== 测试向量化逐元素内核 ===" << std::endl;
+    
+    CpuCapability detected = cpuCapability();
+    std::cout << "\n1. 当前指令集: " << toString(detected)
+              << "（每条向量指令处理 " << elementwiseKernels().vector_width << " 个float）" << std::endl;
+    
+    // 元素数不是向量宽度的整数倍，同时覆盖向量主循环和尾部
+    const int64_t n = 1003;
+    auto a = make_tensor_cpu({n});
+    auto b = make_tensor_cpu({n});
+    for (int64_t i = 0; i < n; ++i) {
+        a->data()[i] = static_cast<float>(i % 17) - 8.0f;
+        b->data()[i] = static_cast<float>(i % 5) + 1.0f;
+    }
+    
+    // 每个可用指令集的结果都应与逐元素的标量计算一致
+    std::cout << "\n2. 各指令集结果与标量计算对比:" << std::endl;
+    for (CpuCapability capability : {CpuCapability::Default, CpuCapability::AVX2, CpuCapability::AVX512}) {
+        try {
+            setCpuCapability(capability);
+        } catch (const std::exception&) {
+            std::cout << "    " << toString(capability) << ": 不支持，跳过" << std::endl;
+            continue;
+        }
+        auto sum = binary_op(BinaryOp::Add, a, b);
+        auto scaled = binary_op(BinaryOp::Mul, a, 0.5f);
+        auto relu = unary_op(UnaryOp::Relu, a);
+        bool ok = true;
+        for (int64_t i = 0; i < n; ++i) {
+            float x = a->data()[i];
+            ok = ok && sum->data()[i] == x + b->data()[i];
+            ok = ok && scaled->data()[i] == x * 0.5f;
+            ok = ok && relu->data()[i] == (x > 0.0f ? x : 0.0f);
+        }
+        std::cout << "    " << toString(capability) << ": " << (ok ? "一致" : "不一致") << std::endl;
+    }
+    setCpuCapability(detected);
+    
+    // add的CPU内核使用同一套向量化运算
+    std::cout << "\n3. 通过dispatcher调用add:" << std::endl;
+    auto result = callOp("add", {IValue(a), IValue(b)})[0].toTensor();
+    std::cout << "    result[0..3] = " << result->data()[0] << ", " << result->data()[1] << ", "
+              << result->data()[2] << ", " << result->data()[3] << std::endl;
+}
+
+// 测试计算图捕获与回放
+void testGraphCapture() {
+    std::cout << "\n=== 测试计算图捕获与回放 ===" << std::endl;
+    
+    auto a = make_tensor_cpu({4});
+    auto b = make_tensor_cpu({4});
+    for (int64_t i = 0; i < 4; ++i) {
+        a->data()[i] = static_cast<float>(i);
+        b->data()[i] = 10.0f;
+    }
+    
+    // 作用域内的调用经过Tracing层时被记录，同时照常执行
+    std::cout << "\n1. 捕获 add -> add_tensor_scalar -> add:" << std::endl;
+    std::shared_ptr<const Graph> graph;
+    {
+        GraphCapture capture;
+        auto y = callOp("add_unboxed", {IValue(a), IValue(b)})[0].toTensor();
+        auto z = callOp("add_tensor_scalar", {IValue(y), IValue(1.0)})[0].toTensor();
+        auto out = callOp("add_unboxed", {IValue(z), IValue(a)})[0].toTensor();
+        graph = capture.finish({IValue(out)});
+    }
+    std::cout << "\n2. 捕获的计算图:" << std::endl;
+    std::cout << graph->toString() << std::endl;
+    
+    // 回放时直接调用捕获时绑定的内核，不再经过Tracing层和内核解析
+    std::cout << "\n3. 用新的输入回放:" << std::endl;
+    GraphExecutor executor(graph);
+    auto c = make_tensor_cpu({4});
+    auto d = make_tensor_cpu({4});
+    for (int64_t i = 0; i < 4; ++i) {
+        c->data()[i] = static_cast<float>(i) * 2.0f;
+        d->data()[i] = -1.0f;
+    }
+    auto replayed = executor.run({IValue(c), IValue(d)})[0].toTensor();
+    bool ok = true;
+    for (int64_t i = 0; i < 4; ++i) {
+        float expected = (c->data()[i] + d->data()[i] + 1.0f) + c->data()[i];
+        ok = ok && replayed->data()[i] == expected;
+    }
+    std::cout << "    回放结果与逐个调用" << (ok ? "一致" : "不一致") << "，result[0..3] = " << replayed->data()[0]
+              << ", " << replayed->data()[1] << ", " << replayed->data()[2] << ", " << replayed->data()[3] << std::endl;
+    
+    // 输入个数与捕获时不一致
+    try {
+        std::cout << "\n4. 输入个数不匹配:" << std::endl;
+        executor.run({IValue(c)});
+    } catch (const std::exception& e) {
+        std::cout << "    捕获到预期错误: " << e.what() << std::endl;
+    }
+    
+    // 输入形状与捕获时不一致：绑定的内核不适用，回放前拒绝
+    try {
+        std::cout << "\n5. 输入形状不匹配:" << std::endl;
+        executor.run({IValue(c), IValue(make_tensor_cpu({8}))});
+    } catch (const std::exception& e) {
+        std::cout << "    捕获到预期错误: " << e.what() << std::endl;
+    }
+    
+    // 没有Tracing fallback时，GraphCapture在捕获期间安装自己的fallback，结束后移除
+    std::cout << "\n6. 未注册Tracing fallback时捕获:" << std::endl;
+    Dispatcher::instance().deregisterFallback(DispatchKey::Tracing);
+    {
+        GraphCapture capture;
+        auto y = callOp("add_unboxed", {IValue(a), IValue(b)})[0].toTensor();
+        auto captured = capture.finish({IValue(y)});
+        std::cout << "    捕获到 " << captured->nodes().size() << " 个节点，捕获结束后Tracing fallback"
+                  << (Dispatcher::instance().hasFallback(DispatchKey::Tracing) ? "仍然存在" : "已移除") << std::endl;
+    }
+    Dispatcher::instance().registerFallback(DispatchKey::Tracing, tracing_fallback);
+}
+
+// 测试逐元素融合
+void testElementwiseFusion() {
+    std::cout << "\n=== 测试逐元素融合 ===" << std::endl;
+    
+    const int64_t n = 1003;
+    auto a = make_tensor_cpu({n});
+    auto b = make_tensor_cpu({n});
+    for (int64_t i = 0; i < n; ++i) {
+        a->data()[i] = static_cast<float>(i % 7);
+        b->data()[i] = static_cast<float>(i % 3) - 1.0f;
+    }
+    
+    std::cout << "\n1. 捕获 add -> add_tensor_scalar -> add:" << std::endl;
+    std::shared_ptr<const Graph> graph;
+    Tensor eager;
+    {
+        GraphCapture capture;
+        auto y = callOp("add", {IValue(a), IValue(b)});
+        auto z = callOp("add_tensor_scalar", {y[0], IValue(2.0)});
+        auto out = callOp("add", {z[0], IValue(a)});
+        eager = out[0].toTensor();
+        graph = capture.finish(out);
+    }
+    std::cout << "\n    捕获的计算图:" << std::endl;
+    std::cout << graph->toString() << std::endl;
+    
+    // 三个节点合并为一个合成操作符，中间结果不再分配tensor
+    std::cout << "\n2. 融合后的计算图:" << std::endl;
+    auto fused = fuseElementwise(*graph);
+    std::cout << fused->toString() << std::endl;
+    for (const GraphNode& node : fused->nodes()) {
+        if (auto expr = findFusedExpression(node.op->name())) {
+            std::cout << "    " << node.op->name() << " = " << expr->toString() << std::endl;
+        }
+    }
+    
+    // 融合内核与逐个调用的结果逐元素一致
+    std::cout << "\n3. 回放融合后的计算图:" << std::endl;
+    Dispatcher::instance().resetCallStats();
+    Dispatcher::instance().enableProfiling(true);
+    GraphExecutor executor(fused);
+    auto result = executor.run({IValue(a), IValue(b)})[0].toTensor();
+    Dispatcher::instance().enableProfiling(false);
+    bool ok = result->sizes() == eager->sizes();
+    for (int64_t i = 0; ok && i < n; ++i) {
+        ok = result->data()[i] == eager->data()[i];
+    }
+    std::cout << "    结果与逐个调用" << (ok ? "一致" : "不一致") << std::endl;
+    
+    // 合成操作符和普通操作符一样出现在统计中
+    for (const auto& [name, stats] : Dispatcher::instance().getCallStats()) {
+        if (findFusedExpression(name.fullName())) {
+            std::cout << "    统计: " << name.fullName() << " 调用 " << stats.call_count << " 次" << std::endl;
+        }
+    }
+    Dispatcher::instance().resetCallStats();
+}
+
+// 测试计算图的静态内存规划
+void testMemoryPlanning() {
+    std::cout << "\n=== 测试计算图的静态内存规划 ===" << std::endl;
+    
+    const int64_t n = 4096;
+    auto a = make_tensor_cpu({n});
+    auto b = make_tensor_cpu({n});
+    for (int64_t i = 0; i < n; ++i) {
+        a->data()[i] = static_cast<float>(i % 11);
+        b->data()[i] = 0.5f;
+    }
+    
+    // t1在t3处最后一次使用，t2、t3、t4都在下一个节点死亡
+    std::cout << "\n1. 捕获五个节点的计算图:" << std::endl;
+    std::shared_ptr<const Graph> graph;
+    {
+        GraphCapture capture;
+        auto t1 = callOp("add", {IValue(a), IValue(b)})[0];
+        auto t2 = callOp("add_tensor_scalar", {t1, IValue(1.0)})[0];
+        auto t3 = callOp("add", {t2, t1})[0];
+        auto t4 = callOp("add_tensor_scalar", {t3, IValue(2.0)})[0];
+        auto out = callOp("add", {t4, IValue(a)})[0];
+        graph = capture.finish({out});
+    }
+    std::cout << graph->toString() << std::endl;
+    
+    std::cout << "\n2. 规划结果（planned为规划后的峰值，naive为逐个分配的总量）:" << std::endl;
+    MemoryPlan plan = planMemory(*graph);
+    for (uint32_t id = 0; id < graph->numValues(); ++id) {
+        if (const MemoryPlan::Assignment* assignment = plan.find(id)) {
+            std::cout << "    %" << id << ": offset=" << assignment->offset << ", nbytes=" << assignment->nbytes
+                      << (assignment->in_place ? "（原地执行）" : "") << std::endl;
+        }
+    }
+    std::cout << "    " << plan.toString() << std::endl;
+    
+    // 有规划时每次运行只有图的输出经过分配器
+    std::cout << "\n3. 对比每次运行的分配器调用次数:" << std::endl;
+    Allocator* cpu_allocator = getAllocator(DispatchKey::CPU);
+    GraphExecutor plain(graph);
+    GraphExecutor planned(graph, /*plan_memory=*/true);
+    size_t before = cpu_allocator->stats().num_allocs;
+    auto expected = plain.run({IValue(a), IValue(b)})[0].toTensor();
+    size_t plain_allocs = cpu_allocator->stats().num_allocs - before;
+    before = cpu_allocator->stats().num_allocs;
+    auto result = planned.run({IValue(a), IValue(b)})[0].toTensor();
+    size_t planned_allocs = cpu_allocator->stats().num_allocs - before;
+    
+    bool ok = true;
+    for (int64_t i = 0; i < n; ++i) {
+        ok = ok && result->data()[i] == expected->data()[i];
+    }
+    std::cout << "    不规划: " << plain_allocs << " 次，规划: " << planned_allocs << " 次（slab "
+              << planned.slab(DispatchKey::CPU)->slabBytes() << "B，命中 "
+              << planned.slab(DispatchKey::CPU)->numHits() << " 次）" << std::endl;
+    std::cout << "    结果" << (ok ? "一致" : "不一致") << std::endl;
+}
+
+// 测试零拷贝的tensor视图
+void testTensorViews() {
+    std::cout << "\n=== 测试Tensor视图 ===" << std::endl;
+    
+    // 按sizes/strides/storage_offset读取二维tensor的元素
+    auto at = [](const Tensor& t, int64_t i, int64_t j) {
+        return t->data()[i * t->strides()[0] + j * t->strides()[1]];
+    };
+    auto m = make_tensor_cpu({2, 3});
+    for (int64_t i = 0; i < 6; ++i) {
+        m->data()[i] = static_cast<float>(i);
+    }
+    
+    std::cout << "\n1. transpose与原tensor共享Storage:" << std::endl;
+    auto t = callOp("transpose", {IValue(m), IValue(int64_t(0)), IValue(int64_t(1))})[0].toTensor();
+    std::cout << "    " << t->debugString() << "，连续: " << (t->isContiguous() ? "是" : "否") << std::endl;
+    std::cout << "    共享Storage: " << (t->storage()->data() == m->storage()->data() ? "是" : "否") << std::endl;
+    m->data()[1] = 100.0f;
+    std::cout << "    修改m[0][1]后 t[1][0] = " << at(t, 1, 0) << std::endl;
+    m->data()[1] = 1.0f;
+    
+    std::cout << "\n2. slice和expand:" << std::endl;
+    auto s = callOp("slice", {IValue(m), IValue(int64_t(1)), IValue(int64_t(1)), IValue(int64_t(3)), IValue(int64_t(1))})[0].toTensor();
+    std::cout << "    m[:, 1:3] = " << s->debugString() << "，s[1][0] = " << at(s, 1, 0) << std::endl;
+    auto row = make_tensor_cpu({1, 3});
+    auto e = callOp("expand", {IValue(row), IValue(std::vector<int64_t>{4, -1})})[0].toTensor();
+    std::cout << "    expand([1, 3] -> [4, 3]) = " << e->debugString() << std::endl;
+    
+    std::cout << "\n3. view要求输入连续，reshape在不连续时复制:" << std::endl;
+    auto v = callOp("view", {IValue(m), IValue(std::vector<int64_t>{3, -1})})[0].toTensor();
+    std::cout << "    view(m, [3, -1]) = " << v->debugString() << std::endl;
+    try {
+        callOp("view", {IValue(t), IValue(std::vector<int64_t>{6})});
+    } catch (const std::exception& ex) {
+        std::cout << "    view(t, [6]) 失败: " << ex.what() << std::endl;
+    }
+    auto r = callOp("reshape", {IValue(t), IValue(std::vector<int64_t>{6})})[0].toTensor();
+    std::cout << "    reshape(t, [6]) = " << r->debugString() << "，共享Storage: "
+              << (r->storage()->data() == m->storage()->data() ? "是" : "否") << std::endl;
+    
+    // 逐元素内核遇到不连续的输入时先复制为连续tensor
+    std::cout << "\n4. 在不连续的输入上调用add:" << std::endl;
+    auto sum = callOp("add", {IValue(t), IValue(t)})[0].toTensor();
+    bool ok = true;
+    for (int64_t i = 0; i < 3; ++i) {
+        for (int64_t j = 0; j < 2; ++j) {
+            ok = ok && sum->data()[i * 2 + j] == 2.0f * at(t, i, j);
+        }
+    }
+    std::cout << "    " << sum->debugString() << "，结果" << (ok ? "正确" : "错误") << std::endl;
+    
+    // %2只被transpose直接使用，但它的视图一直用到倒数第二个节点，不能与%7共用内存
+    std::cout << "\n5. 含视图的计算图的内存规划:" << std::endl;
+    auto b = make_tensor_cpu({2, 3});
+    std::shared_ptr<const Graph> graph;
+    {
+        GraphCapture capture;
+        auto t1 = callOp("add", {IValue(m), IValue(b)})[0];
+        auto t2 = callOp("transpose", {t1, IValue(int64_t(0)), IValue(int64_t(1))})[0];
+        auto t3 = callOp("add_tensor_scalar", {IValue(m), IValue(1.0)})[0];
+        auto t4 = callOp("add", {t2, t2})[0];
+        auto t5 = callOp("transpose", {t3, IValue(int64_t(0)), IValue(int64_t(1))})[0];
+        graph = capture.finish({callOp("add", {t4, t5})[0]});
+    }
+    std::cout << graph->toString() << std::endl;
+    std::cout << "    " << planMemory(*graph).toString() << std::endl;
+    GraphExecutor plain(graph);
+    GraphExecutor planned(graph, /*plan_memory=*/true);
+    auto expected = plain.run({IValue(m), IValue(b)})[0].toTensor();
+    auto result = planned.run({IValue(m), IValue(b)})[0].toTensor();
+    ok = result->numel() == expected->numel();
+    for (int64_t i = 0; ok && i < result->numel(); ++i) {
+        ok = result->data()[i] == expected->data()[i];
+    }
+    std::cout << "    规划前后结果" << (ok ? "一致" : "不一致") << std::endl;
+}
+
+// 测试Meta tensor上的形状推断与内存规划
+void testMetaTensors() {
+    std::cout << "\n=== 测试Meta tensor ===" << std::endl;
+    
+    Allocator* cpu_allocator = getAllocator(DispatchKey::CPU);
+    size_t before = cpu_allocator->stats().num_allocs;
+    
+    std::cout << "\n1. 在Meta tensor上调用操作符:" << std::endl;
+    auto a = make_tensor_meta({1024, 1024});
+    auto b = make_tensor_meta({1024, 1024});
+    auto sum = callOp("add", {IValue(a), IValue(b)})[0].toTensor();
+    auto t = callOp("transpose", {IValue(sum), IValue(int64_t(0)), IValue(int64_t(1))})[0].toTensor();
+    auto r = callOp("reshape", {IValue(t), IValue(std::vector<int64_t>{-1})})[0].toTensor();
+    std::cout << "    add: " << sum->debugString() << std::endl;
+    std::cout << "    transpose + reshape: " << r->debugString() << "，数据指针: "
+              << (r->data() ? "非空" : "空") << std::endl;
+    std::cout << "    CPU分配器调用次数变化: " << cpu_allocator->stats().num_allocs - before << std::endl;
+    
+    std::cout << "\n2. 形状错误在Meta内核中报告:" << std::endl;
+    try {
+        callOp("add", {IValue(make_tensor_meta({2, 3})), IValue(make_tensor_meta({4}))});
+    } catch (const std::exception& e) {
+        std::cout << "    " << e.what() << std::endl;
+    }
+    
+    // 与testMemoryPlanning相同的计算图，不分配内存即可得到相同的规划
+    std::cout << "\n3. 在Meta tensor上捕获计算图并规划内存:" << std::endl;
+    const int64_t n = 4096;
+    auto x = make_tensor_meta({n});
+    auto y = make_tensor_meta({n});
+    std::shared_ptr<const Graph> graph;
+    {
+        GraphCapture capture;
+        auto t1 = callOp("add", {IValue(x), IValue(y)})[0];
+        auto t2 = callOp("add_tensor_scalar", {t1, IValue(1.0)})[0];
+        auto t3 = callOp("add", {t2, t1})[0];
+        auto t4 = callOp("add_tensor_scalar", {t3, IValue(2.0)})[0];
+        graph = capture.finish({callOp("add", {t4, IValue(x)})[0]});
+    }
+    std::cout << graph->toString() << std::endl;
+    std::cout << "    " << planMemory(*graph).toString() << std::endl;
+    
+    GraphExecutor executor(graph, /*plan_memory=*/true);
+    auto out = executor.run({IValue(x), IValue(y)})[0].toTensor();
+    std::cout << "    回放结果: " << out->debugString() << std::endl;
 }
 
 // 测试错误处理
@@ -326,6 +918,18 @@ void testErrorHandling() {
     } catch (const std::exception& e) {
         std::cout << "    捕获到预期错误: " << e.what() << std::endl;
     }
+    
+    // 批量修改中途抛出时整批丢弃，之前设置的内核也不会发布
+    OperatorHandle& probe = registerOp("batch_update_probe");
+    try {
+        std::cout << "\n3. 测试批量修改中途失败:" << std::endl;
+        auto kernels = probe.updateKernels();
+        kernels.setKernel(DispatchKey::CPU, KernelFunction(add_cpu_unboxed));
+        kernels.setKernel(DispatchKey::CUDA, KernelFunction(add_scalar_unboxed));  // schema与CPU内核不一致
+    } catch (const std::exception& e) {
+        std::cout << "    捕获到预期错误: " << e.what() << std::endl;
+    }
+    std::cout << "    CPU内核是否已发布: " << (probe.hasKernel(DispatchKey::CPU) ? "是" : "否") << "（期望 否）" << std::endl;
 }
 
 // 测试功能性dispatch key
@@ -363,7 +967,25 @@ void testFunctionalityKeys() {
     IValueList profiling_args = {IValue(tensor5), IValue(tensor6)};
     auto profiling_result = callOp("add", profiling_args);
     
+    // 没有注册Profiling内核的操作符同样经过全局fallback
+    auto scalar_result = callOp("add_scalar", {IValue(1.0), IValue(2.0)});
+    
     GlobalDispatchState::instance().setProfilingEnabled(false);  // 关闭profiling
+    
+    // 测试线程局部的tracing模式：只影响当前线程，不修改全局状态
+    std::cout << "\n4. 线程局部Tracing模式:" << std::endl;
+    {
+        IncludeDispatchKeyGuard tracing_mode(DispatchKey::Tracing);
+        
+        std::thread other([&] {
+            std::cout << "  其他线程的key set: "
+                      << Dispatcher::instance().findOperator(OperatorName("add"))
+                             ->computeDispatchKeySet(tracing_args).toString() << std::endl;
+        });
+        other.join();
+        
+        auto local_result = callOp("add", tracing_args);
+    }
 }
 
 // 测试组合dispatch keys
@@ -410,6 +1032,7 @@ void testProfiling() {
     std::cout << "\n=== 测试性能统计功能 ===" << std::endl;
     
     Dispatcher::instance().enableProfiling(true);
+    Dispatcher::instance().setLatencySamplingPeriod(1);  // 每次内核调用都记录延迟
     
     // 进行多次调用
     for (int i = 0; i < 3; ++i) {
@@ -426,9 +1049,209 @@ void testProfiling() {
     std::cout << "\n=== 性能统计报告 ===" << std::endl;
     Dispatcher::instance().printDebugInfo();
     
+    Dispatcher::instance().setLatencySamplingPeriod(0);
     Dispatcher::instance().enableProfiling(false);
 }
 
+// 测试分发事件记录
+void testEventRecording() {
+    std::cout << "\n=== 测试分发事件记录 ===" << std::endl;
+    
+    EventRecorder& recorder = EventRecorder::instance();
+    recorder.clear();
+    recorder.startFlusher(std::chrono::milliseconds(1));
+    GlobalDispatchState::instance().setEventRecordingEnabled(true);
+    
+    // Autograd包装器redispatch到CPU内核，形成两层嵌套；异步调用在执行器线程上记录
+    auto a = make_tensor_cpu({2, 2});
+    auto b = make_tensor_cpu({2, 2});
+    a->setRequiresGrad(true);
+    std::cout << "\n1. 记录期间的调用:" << std::endl;
+    callOp("add", {IValue(a), IValue(b)});
+    Dispatcher::instance().findOperator(OperatorName("add_unboxed"))->typed<Tensor(const Tensor&, const Tensor&)>().call(a, b);
+    callOpAsync("add_unboxed", {IValue(make_tensor_cpu({2})), IValue(make_tensor_cpu({2}))}).get();
+    // 批量调用的一组只进入内核一次，记录为一个事件
+    std::vector<IValueList> batch = {
+        {IValue(make_tensor_cpu({2})), IValue(make_tensor_cpu({2}))},
+        {IValue(make_tensor_cpu({3})), IValue(make_tensor_cpu({3}))},
+    };
+    Dispatcher::instance().callBatch(*Dispatcher::instance().findOperator(OperatorName("add")), batch);
+
+    GlobalDispatchState::instance().setEventRecordingEnabled(false);
+    callOp("add", {IValue(a), IValue(b)});  // 关闭后不再记录
+    recorder.stopFlusher();
+    recorder.flush();
+    
+    std::cout << "\n2. 记录到的事件（按结束顺序，缩进表示嵌套）:" << std::endl;
+    std::vector<RecordedEvent> events = recorder.events();
+    for (const RecordedEvent& recorded : events) {
+        const DispatchEvent& event = recorded.event;
+        std::cout << "    " << std::string(event.depth * 2, ' ')
+                  << Dispatcher::instance().findOperator(static_cast<OperatorId>(event.op))->name() << " ["
+                  << toString(event.key) << "]" << (recorded.thread == events.front().thread ? "" : "（其他线程）")
+                  << std::endl;
+    }
+    
+    std::ostringstream trace;
+    recorder.writeChromeTrace(trace);
+    std::cout << "\n3. Chrome trace JSON: " << trace.str().size() << " 字节，丢弃 " << recorder.droppedEvents()
+              << " 个事件" << std::endl;
+    recorder.clear();
+    
+    // 内存中的历史有上限，超过时淘汰最旧的事件
+    std::cout << "\n4. 内存中最多保留2个事件:" << std::endl;
+    recorder.setMaxEvents(2);
+    GlobalDispatchState::instance().setEventRecordingEnabled(true);
+    callOp("add", {IValue(a), IValue(b)});
+    callOp("add", {IValue(a), IValue(b)});
+    GlobalDispatchState::instance().setEventRecordingEnabled(false);
+    recorder.flush();
+    std::cout << "    保留 " << recorder.events().size() << " 个事件，淘汰 " << recorder.evictedEvents() << " 个"
+              << std::endl;
+    recorder.setMaxEvents(EventRecorder::kDefaultMaxEvents);
+    recorder.clear();
+    
+    // 流式输出：flush直接把事件追加写入trace文件，内存中不保留
+    std::cout << "\n5. 流式写入trace文件:" << std::endl;
+    std::string path = (std::filesystem::temp_directory_path() / "dispatcher_demo_trace.json").string();
+    recorder.startStreaming(path);
+    GlobalDispatchState::instance().setEventRecordingEnabled(true);
+    callOp("add", {IValue(a), IValue(b)});
+    GlobalDispatchState::instance().setEventRecordingEnabled(false);
+    recorder.stopStreaming();
+    std::cout << "    内存中的事件: " << recorder.events().size() << "，文件大小: "
+              << std::filesystem::file_size(path) << " 字节" << std::endl;
+    std::filesystem::remove(path);
+}
+
+// 测试autograd反向传播
+void testAutograd() {
+    std::cout << "\n=== 测试Autograd反向传播 ===" << std::endl;
+    
+    // 之前的测试记录的图随其输出一起释放，不参与本次反向
+    size_t nodes_before = AutogradTape::instance().numNodes();
+    
+    auto fill = [](const Tensor& tensor, float value) {
+        std::fill(tensor->data(), tensor->data() + tensor->numel(), value);
+    };
+    auto a = make_tensor_cpu({2, 2});
+    auto b = make_tensor_cpu({2, 2});
+    fill(a, 1.0f);
+    fill(b, 2.0f);
+    a->setRequiresGrad(true);
+    b->setRequiresGrad(true);
+    
+    // x1 = a + b 与 x2 = a + a 互不依赖，反向时可以并行执行；y = x1 + x2
+    std::cout << "\n1. 前向计算（记录反向节点）:" << std::endl;
+    auto add = Dispatcher::instance().findOperator(OperatorName("add_unboxed"))->typed<Tensor(const Tensor&, const Tensor&)>();
+    Tensor x1 = add.call(a, b);
+    Tensor x2 = add.call(a, a);
+    Tensor y = add.call(x1, x2);
+    std::cout << "  新记录的节点数: " << AutogradTape::instance().numNodes() - nodes_before
+              << ", y是否有grad_fn: " << (y->gradFn() ? "是" : "否") << std::endl;
+    
+    // 另一个互不相关的图：对y反向传播不影响它
+    Tensor z = add.call(b, b);
+    
+    std::cout << "\n2. 反向传播:" << std::endl;
+    // 反向执行不持有记录锁：线程池上同时进行的异步调用照常记录节点
+    auto pending = callOpAsync("add_unboxed", {IValue(a), IValue(b)});
+    backward(y);
+    pending.get();
+    std::cout << "  a.grad[0] = " << a->grad()->data()[0] << "（期望 3）" << std::endl;
+    std::cout << "  b.grad[0] = " << b->grad()->data()[0] << "（期望 1）" << std::endl;
+    std::cout << "  反向结束后y是否有grad_fn: " << (y->gradFn() ? "是" : "否")
+              << ", z是否有grad_fn: " << (z->gradFn() ? "是" : "否") << std::endl;
+    
+    // x1、x2仍然持有y所在的图；输出全部释放后图中的节点随之释放
+    std::cout << "\n3. 释放输出:" << std::endl;
+    x1 = Tensor();
+    x2 = Tensor();
+    y = Tensor();
+    z = Tensor();
+    std::cout << "  剩余的新节点数: " << AutogradTape::instance().numNodes() - nodes_before << std::endl;
+    
+    // 反向函数抛出的异常在所有节点结束后由backward()重新抛出
+    std::cout << "\n4. 反向函数出错:" << std::endl;
+    Tensor c = make_tensor_cpu({2, 2});
+    fill(c, 1.0f);
+    c->setRequiresGrad(true);
+    Tensor d = make_tensor_cpu({2, 2});
+    AutogradTape::instance().record(
+        "failing",
+        [](const AutogradNode& node, ArrayRef<Tensor>, const Tensor&, Tensor*) {
+            throw std::runtime_error(std::string(node.name) + " 的反向函数出错");
+        },
+        ArrayRef<Tensor>(&c, 1), d);
+    try {
+        backward(d);
+    } catch (const std::exception& e) {
+        std::cout << "  捕获到预期错误: " << e.what() << std::endl;
+    }
+
+    // 视图的Autograd内核记录反向节点，梯度按视图的几何写回原tensor，而不是停留在视图上
+    std::cout << "\n5. 经过视图的反向传播:" << std::endl;
+    Tensor p = make_tensor_cpu({2, 3});
+    fill(p, 1.0f);
+    p->setRequiresGrad(true);
+    Tensor s = callOp("slice", {IValue(p), IValue(int64_t(1)), IValue(int64_t(0)), IValue(int64_t(2)), IValue(int64_t(1))})[0].toTensor();
+    Tensor st = callOp("transpose", {IValue(s), IValue(int64_t(0)), IValue(int64_t(1))})[0].toTensor();
+    backward(add.call(s, st));
+    // p的第0行经expand广播为两行，梯度在广播的维度上求和后累加到p.grad
+    Tensor row = callOp("slice", {IValue(p), IValue(int64_t(0)), IValue(int64_t(0)), IValue(int64_t(1)), IValue(int64_t(1))})[0].toTensor();
+    Tensor e = callOp("expand", {IValue(row), IValue(std::vector<int64_t>{2, 3})})[0].toTensor();
+    backward(add.call(e, e));
+    const float* p_grad = p->grad()->data();
+    std::cout << "  p.grad = [[" << p_grad[0] << ", " << p_grad[1] << ", " << p_grad[2] << "], [" << p_grad[3] << ", "
+              << p_grad[4] << ", " << p_grad[5] << "]]（期望 [[6, 6, 4], [2, 2, 0]]）" << std::endl;
+    std::cout << "  视图是否有grad: " << (s->grad() || row->grad() ? "是" : "否") << std::endl;
+
+    // 两个线程各自对共享同一叶子的图反向传播，叶子上的梯度累加不会相互覆盖
+    std::cout << "\n6. 并发反向传播到同一个叶子:" << std::endl;
+    Tensor w = make_tensor_cpu({2, 2});
+    w->setRequiresGrad(true);
+    auto train = [&w]() {
+        for (int i = 0; i < 100; ++i) {
+            Tensor loss = make_tensor_cpu({2, 2});
+            const Tensor inputs[] = {w, w};
+            AutogradTape::instance().record("add", add_backward, inputs, loss);
+            backward(loss);
+        }
+    };
+    std::thread worker(train);
+    train();
+    worker.join();
+    std::cout << "  w.grad[0] = " << w->grad()->data()[0] << "（期望 400）" << std::endl;
+}
+
+// 测试调用点缓存
+void testCallSiteCache() {
+    std::cout << "\n=== 测试调用点缓存 ===" << std::endl;
+    
+    OperatorCallSite site(OperatorName("add_scalar"));
+    std::cout << "\n1. 重复调用同一操作符:" << std::endl;
+    double sum = 0.0;
+    for (int i = 0; i < 4; ++i) {
+        sum += site.call({IValue(1.0), IValue(static_cast<double>(i))})[0].toDouble();
+    }
+    std::cout << "  结果之和: " << sum << "，命中 " << site.hits() << " 次，未命中 " << site.misses() << " 次" << std::endl;
+    
+    // 任何注册变化都会递增分发版本号，调用点在下一次调用时重新解析
+    std::cout << "\n2. 注册变化后重新解析:" << std::endl;
+    uint64_t version = Dispatcher::dispatchVersion();
+    registerOp("call_site_probe").setKernel(DispatchKey::CPU, KernelFunction(add_scalar_unboxed));
+    site.call({IValue(1.0), IValue(2.0)});
+    std::cout << "  分发版本号: " << version << " -> " << Dispatcher::dispatchVersion()
+              << "，命中 " << site.hits() << " 次，未命中 " << site.misses() << " 次" << std::endl;
+    Dispatcher::instance().deregisterOperator(OperatorName("call_site_probe"));
+    
+    std::cout << "\n3. CALL_OP_CACHED:" << std::endl;
+    for (int i = 0; i < 2; ++i) {
+        auto result = CALL_OP_CACHED("add_scalar", {IValue(2.0), IValue(3.0)});
+        std::cout << "  第" << i + 1 << "次调用结果: " << result[0].toDouble() << std::endl;
+    }
+}
+
 int main() {
     try {
         std::cout << "PyTorch风格Dispatcher演示程序" << std::endl;
@@ -443,6 +1266,39 @@ int main() {
         // 测试Boxing/Unboxing机制
         testBoxingUnboxing();
         
+        // 测试类型化直接调用
+        testTypedCall();
+        
+        // 测试批量调用
+        testBatchedCall();
+        
+        // 测试异步调用
+        testAsyncCall();
+        
+        // 测试intra-op并行
+        testParallelFor();
+        
+        // 测试tensor存储与缓存分配器
+        testMemoryStats();
+        
+        // 测试向量化逐元素内核
+        testVectorizedKernels();
+        
+        // 测试计算图捕获与回放
+        testGraphCapture();
+        
+        // 测试逐元素融合
+        testElementwiseFusion();
+        
+        // 测试计算图的静态内存规划
+        testMemoryPlanning();
+        
+        // 测试零拷贝的tensor视图
+        testTensorViews();
+        
+        // 测试Meta tensor上的形状推断
+        testMetaTensors();
+        
         // 测试错误处理
         testErrorHandling();
         
@@ -452,9 +1308,18 @@ int main() {
         // 测试组合keys
         testCombinedKeys();
         
+        // 测试autograd反向传播
+        testAutograd();
+        
+        // 测试调用点缓存
+        testCallSiteCache();
+        
         // 测试性能统计
         testProfiling();
         
+        // 测试分发事件记录
+        testEventRecording();
+        
         std::cout << "\n=== 最终Dispatcher状态 ===" << std::endl;
         Dispatcher::instance().printDebugInfo();
         